@@ -24,8 +24,35 @@
 #include <fcntl.h>
 #include <pwd.h>
 #include <errno.h>
+#include <stdint.h>
+#include <sys/time.h>      //->gettimeofday
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
 #include <libssh/libssh.h>
 #include <libssh/sftp.h>
+#include "comp_load.h"
+
+#define SCP_CHUNK_SIZE      32768   // default size of one read request
+#define SCP_CHUNK_SIZE_MAX  65536   // largest read request servers accept
+#define SCP_WINDOW          16      // default outstanding read requests
+#define SCP_WINDOW_MAX      256     // maximum outstanding read requests
+#define SCP_ENV_WINDOW      "SYSLOAD_SCP_WINDOW"  // overrides SCP_WINDOW
+#define SCP_ENV_CHUNK       "SYSLOAD_SCP_CHUNK"   // overrides chunk, in KiB
+#define SCP_MSG_SIZE        512     // size of message buffers
+#define SCP_URI_SIZE        4096    // maximum length of URI
+#define SCP_BROKER_SOCKET   CL_SCP_BROKER_SOCKET // session broker socket
+#define SCP_BROKER_IDLE     30      // broker exits after idle seconds if
+                                    // sysload does not stop it
+#define SCP_MAX_SESSIONS    8       // sessions kept by the broker
+
+struct read_req {
+    uint32_t id;        // request id returned by sftp_async_read_begin()
+    uint64_t offset;    // offset within remote file
+    uint32_t len;       // number of bytes requested
+};
 
 struct ssh_param {
     char *user;
@@ -35,6 +62,38 @@ struct ssh_param {
     char *path;
 };
 
+// request sent to the session broker, the destination file descriptor
+// is passed along with it
+struct broker_request {
+    int window;                 // outstanding read requests
+    int chunk;                  // size of one read request
+    char uri[SCP_URI_SIZE];     // source URI
+};
+
+// reply of the session broker
+struct broker_reply {
+    int status;                 // exit code of the transfer
+    char info[SCP_MSG_SIZE];    // informational message
+    char error[SCP_MSG_SIZE];   // error message
+};
+
+// authenticated SFTP session kept by the session broker
+struct session {
+    char *user;                 // login name
+    char *pw;                   // password or NULL for public key
+    char *host;                 // server name
+    char *port;                 // server port
+    SFTP_SESSION *sftp;         // SFTP session or NULL
+    pthread_mutex_t lock;       // serializes use of the session
+};
+
+static struct session sessions[SCP_MAX_SESSIONS];
+static int session_count = 0;
+static pthread_mutex_t session_lock = PTHREAD_MUTEX_INITIALIZER;
+static int broker_active = 0;   // transfers in progress
+static int broker_quit = -1;    // client which asked the broker to stop
+static pthread_mutex_t broker_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * decode command-line parameters (e.g. UID, PW, HOST, ...
  *
@@ -107,11 +166,12 @@ struct ssh_param* decode_parameters(char * input)
 /**
  * establish connection to remote SSH server
  *
- * \param[in] ssh_p        pointer to ssh_param structure
- * \return    sftp_session session handle
+ * \param[in]  ssh_p        pointer to ssh_param structure
+ * \param[out] unreachable  set to 1 if the server cannot be contacted
+ * \return     sftp_session session handle
 */
 
-SFTP_SESSION * connect_ssh(struct ssh_param *ssh_p)
+SFTP_SESSION * connect_ssh(struct ssh_param *ssh_p, int *unreachable)
 {
     SSH_OPTIONS *options;
     SSH_SESSION *session;
@@ -130,7 +190,8 @@ SFTP_SESSION * connect_ssh(struct ssh_param *ssh_p)
 
     if((session = ssh_connect(options)) == NULL)
     {
-        syslog(LOG_ERR, ssh_get_error(session));
+        syslog(LOG_ERR,"%s",ssh_get_error(session));
+        *unreachable = 1;
         return NULL;
     }
 
@@ -152,7 +213,7 @@ SFTP_SESSION * connect_ssh(struct ssh_param *ssh_p)
 
     if((sftp_session = sftp_new(session)) == NULL)
     {
-        syslog(LOG_ERR,ssh_get_error(session));
+        syslog(LOG_ERR,"%s",ssh_get_error(session));
         return NULL;
     }
     else
@@ -160,7 +221,7 @@ SFTP_SESSION * connect_ssh(struct ssh_param *ssh_p)
 
     if(sftp_init(sftp_session))
     {
-        syslog(LOG_ERR,ssh_get_error(session));
+        syslog(LOG_ERR,"%s",ssh_get_error(session));
         return NULL;
     }
     else
@@ -181,7 +242,7 @@ int open_local(char * name)
 
     if((fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) == -1)
     {
-        syslog(LOG_ERR,strerror(errno));
+        syslog(LOG_ERR,"%s",strerror(errno));
         return -1;
     }
     else
@@ -202,7 +263,7 @@ SFTP_FILE * open_remote(char * name, SFTP_SESSION *sftp)
 
     if((fd = sftp_open(sftp, name, O_RDONLY, NULL)) == NULL)
     {
-        syslog(LOG_ERR,ssh_get_error(sftp->session));
+        syslog(LOG_ERR,"%s",ssh_get_error(sftp->session));
         return NULL;
     }
     else
@@ -210,16 +271,608 @@ SFTP_FILE * open_remote(char * name, SFTP_SESSION *sftp)
     return fd;
 }
 
+/**
+ * read an integer setting from the environment
+ *
+ * \param[in] name  name of the environment variable
+ * \param[in] def   default value
+ * \param[in] min   smallest accepted value
+ * \param[in] max   largest accepted value
+ * \return    value of the variable or default
+*/
+int env_setting(const char *name, int def, int min, int max)
+{
+    char *value = getenv(name);
+    int result;
+
+    if(value == NULL || *value == 0)
+        return def;
+
+    result = atoi(value);
+    if(result < min || result > max)
+    {
+        syslog(LOG_WARNING,"Ignoring invalid %s=%s.", name, value);
+        return def;
+    }
+    return result;
+}
+
+/**
+ * issue an asynchronous read request for a part of the remote file
+ *
+ * \param[in]  file    remote file
+ * \param[out] req     request slot to be filled
+ * \param[in]  offset  offset within remote file
+ * \param[in]  len     number of bytes to request
+ * \return     0 on success otherwise -1
+*/
+int request_chunk(SFTP_FILE *file, struct read_req *req, uint64_t offset,
+                  uint32_t len)
+{
+    int id;
+
+    sftp_seek64(file, offset);
+    if((id = sftp_async_read_begin(file, len)) < 0)
+        return -1;
+
+    req->id = id;
+    req->offset = offset;
+    req->len = len;
+    return 0;
+}
+
+/**
+ * copy the remote file to the local file. Up to window read requests are
+ * outstanding at any time, so the transfer is not limited by the round
+ * trip time. Data is written at its offset as requests complete; a short
+ * read is completed by a new request for the missing part.
+ *
+ * \param[in] file      remote file
+ * \param[in] sftp      SFTP session of remote file
+ * \param[in] local_fd  destination file descriptor
+ * \param[in] window    maximum number of outstanding requests
+ * \param[in] chunk     size of one read request
+ * \param[out] msg      buffer of size SCP_MSG_SIZE for error message
+ * \return    number of bytes transferred on success otherwise -1
+*/
+long long transfer(SFTP_FILE *file, SFTP_SESSION *sftp, int local_fd,
+                   int window, uint32_t chunk, char *msg)
+{
+    SFTP_ATTRIBUTES *attr;
+    struct read_req *queue, *req;
+    long long total = 0;
+    long long size = -1;
+    uint64_t next = 0;
+    ssize_t written;
+    char *buffer;
+    int head = 0;
+    int count = 0;
+    int eof = 0;
+    int rcvd, done;
+    uint32_t len;
+
+    if((attr = sftp_fstat(file)) != NULL)
+    {
+        if(attr->flags & SSH_FILEXFER_ATTR_SIZE)
+            size = attr->size;
+        sftp_attributes_free(attr);
+    }
+
+    queue = malloc(window * sizeof(*queue));
+    buffer = malloc(chunk);
+    if(queue == NULL || buffer == NULL)
+    {
+        snprintf(msg, SCP_MSG_SIZE, "Out of memory.");
+        goto error;
+    }
+
+    while(1)
+    {
+        // keep the window filled until the end of the file is known
+        while(!eof && count < window && (size < 0 || next < size))
+        {
+            len = chunk;
+            if(size >= 0 && size - next < len)
+                len = size - next;
+            if(request_chunk(file, &queue[(head + count) % window],
+                             next, len))
+                goto sftp_error;
+            next += len;
+            count++;
+        }
+        if(count == 0)
+            break;
+
+        req = &queue[head];
+        rcvd = sftp_async_read(file, buffer, req->len, req->id);
+        if(rcvd < 0)
+            goto sftp_error;
+        head = (head + 1) % window;
+        count--;
+
+        if(rcvd == 0)   // request beyond end of file
+        {
+            eof = 1;
+            continue;
+        }
+        for(done = 0; done < rcvd; done += written)
+        {
+            written = pwrite(local_fd, buffer + done, rcvd - done,
+                             req->offset + done);
+            if(written < 0 && errno != EINTR)
+            {
+                snprintf(msg, SCP_MSG_SIZE,
+                         "Cannot write destination - %s.", strerror(errno));
+                goto error;
+            }
+            if(written < 0)
+                written = 0;
+        }
+        total += rcvd;
+
+        // servers may return less than requested, ask for the rest
+        if(rcvd < req->len)
+        {
+            if(request_chunk(file, &queue[(head + count) % window],
+                             req->offset + rcvd, req->len - rcvd))
+                goto sftp_error;
+            count++;
+        }
+    }
+
+    if(size >= 0 && total != size)
+    {
+        snprintf(msg, SCP_MSG_SIZE, "Remote file changed during transfer.");
+        goto error;
+    }
+
+    free(queue);
+    free(buffer);
+    return total;
+
+ sftp_error:
+    snprintf(msg, SCP_MSG_SIZE, "%s", ssh_get_error(sftp->session));
+    syslog(LOG_ERR,"%s",ssh_get_error(sftp->session));
+ error:
+    // outstanding replies are discarded when the file is closed
+    free(queue);
+    free(buffer);
+    return -1;
+}
+
+/**
+ * close a SFTP session and the underlying SSH connection
+ *
+ * \param[in] sftp SFTP session to be closed
+*/
+void disconnect_ssh(SFTP_SESSION *sftp)
+{
+    SSH_SESSION *session = sftp->session;
+
+    sftp_free(sftp);
+    ssh_disconnect(session);
+}
+
+/**
+ * compare two strings which may be NULL
+ *
+ * \param[in] a  first string or NULL
+ * \param[in] b  second string or NULL
+ * \return    non-zero if both are NULL or equal
+*/
+int same_string(const char *a, const char *b)
+{
+    if(a == NULL || b == NULL)
+        return a == b;
+    return !strcmp(a, b);
+}
+
+/**
+ * find or create the session for user, password, host and port of a
+ * request and lock it. A session is only shared by requests with the
+ * same credentials, so every request is authenticated with its own.
+ * The session is not connected yet if its sftp member is NULL.
+ *
+ * \param[in] ssh_p  pointer to ssh_param structure
+ * \return    locked session or NULL if no slot is available
+*/
+struct session *session_get(struct ssh_param *ssh_p)
+{
+    struct session *sess = NULL;
+    int n;
+
+    pthread_mutex_lock(&session_lock);
+    for(n = 0; n < session_count; n++)
+    {
+        if(!strcmp(sessions[n].user, ssh_p->user) &&
+           same_string(sessions[n].pw, ssh_p->pw) &&
+           !strcmp(sessions[n].host, ssh_p->host) &&
+           !strcmp(sessions[n].port, ssh_p->port))
+        {
+            sess = &sessions[n];
+            break;
+        }
+    }
+    if(sess == NULL && session_count < SCP_MAX_SESSIONS)
+    {
+        sess = &sessions[session_count++];
+        sess->user = strdup(ssh_p->user);
+        sess->pw = ssh_p->pw ? strdup(ssh_p->pw) : NULL;
+        sess->host = strdup(ssh_p->host);
+        sess->port = strdup(ssh_p->port);
+        sess->sftp = NULL;
+        pthread_mutex_init(&sess->lock, NULL);
+    }
+    pthread_mutex_unlock(&session_lock);
+
+    if(sess)
+        pthread_mutex_lock(&sess->lock);
+    return sess;
+}
+
+/**
+ * copy a remote file to a local file over a shared session. A session
+ * which has been closed by the server is connected again once.
+ *
+ * \param[in]  ssh_p     pointer to ssh_param structure
+ * \param[in]  local_fd  destination file descriptor
+ * \param[in]  window    maximum number of outstanding requests
+ * \param[in]  chunk     size of one read request
+ * \param[out] reply     status and messages of the transfer
+*/
+void fetch(struct ssh_param *ssh_p, int local_fd, int window, int chunk,
+           struct broker_reply *reply)
+{
+    struct timeval start, end;
+    struct session *sess;
+    SFTP_FILE *sftp_file;
+    int attempt, reused, unreachable = 0;
+    long long acc;
+    double secs;
+
+    memset(reply, 0, sizeof(*reply));
+    if((sess = session_get(ssh_p)) == NULL)
+    {
+        snprintf(reply->error, SCP_MSG_SIZE, "Too many SSH sessions.");
+        reply->status = 2;
+        return;
+    }
+
+    for(attempt = 0; attempt < 2; attempt++)
+    {
+        reused = (sess->sftp != NULL);
+        if(!reused && (sess->sftp = connect_ssh(ssh_p, &unreachable)) == NULL)
+        {
+            snprintf(reply->error, SCP_MSG_SIZE,
+                     "Cannot connect to '%s'.", ssh_p->host);
+            // sysload may use a cached copy if the server is unreachable
+            reply->status = unreachable ? CL_EXIT_UNREACHABLE : 2;
+            break;
+        }
+        if((sftp_file = open_remote(ssh_p->path, sess->sftp)) == NULL)
+        {
+            snprintf(reply->error, SCP_MSG_SIZE, "Cannot open '%s' - %s",
+                     ssh_p->path, ssh_get_error(sess->sftp->session));
+            reply->status = 4;
+            // the server may have closed an idle session
+            disconnect_ssh(sess->sftp);
+            sess->sftp = NULL;
+            if(reused)
+                continue;
+            break;
+        }
+
+        gettimeofday(&start, NULL);
+        acc = transfer(sftp_file, sess->sftp, local_fd, window, chunk,
+                       reply->error);
+        gettimeofday(&end, NULL);
+        sftp_file_close(sftp_file);
+
+        if(acc < 0)
+        {
+            reply->status = 5;
+            disconnect_ssh(sess->sftp);
+            sess->sftp = NULL;
+        }
+        else if(acc == 0)
+        {
+            reply->status = 0;
+            syslog(LOG_WARNING,"Nothing transferred, please check the remote file-name");
+        }
+        else
+        {
+            reply->status = 0;
+            secs = (end.tv_sec - start.tv_sec) +
+                   (end.tv_usec - start.tv_usec) / 1000000.0;
+            if(secs <= 0)
+                secs = 0.000001;
+            syslog(LOG_INFO,"Transferred %lld bytes successfully.", acc);
+            snprintf(reply->info, SCP_MSG_SIZE,
+                     "Transferred %lld bytes in %.1f s (%.1f MB/s)%s.",
+                     acc, secs, acc / secs / (1024 * 1024),
+                     reused ? " over existing session" : "");
+        }
+        break;
+    }
+    pthread_mutex_unlock(&sess->lock);
+}
+
+/**
+ * serve one client of the session broker
+ *
+ * \param[in] arg  connected socket cast to a pointer
+ * \return    always NULL
+*/
+void *broker_client(void *arg)
+{
+    int client = (long) arg;
+    struct broker_request request;
+    struct broker_reply reply;
+    struct ssh_param *srv_conn;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    int local_fd = -1;
+    ssize_t len;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &request;
+    iov.iov_len = sizeof(request);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    memset(&reply, 0, sizeof(reply));
+    memset(&request, 0, sizeof(request));
+    len = recvmsg(client, &msg, MSG_WAITALL);
+    if(len == sizeof(CL_BROKER_QUIT) &&
+       !memcmp(&request, CL_BROKER_QUIT, sizeof(CL_BROKER_QUIT)))
+    {
+        // sysload ends the boot attempt, the connection is closed
+        // when all sessions are closed
+        pthread_mutex_lock(&broker_lock);
+        if(broker_quit >= 0)
+            close(broker_quit);
+        broker_quit = client;
+        broker_active--;
+        pthread_mutex_unlock(&broker_lock);
+        return NULL;
+    }
+    if(len != sizeof(request) ||
+       (cmsg = CMSG_FIRSTHDR(&msg)) == NULL ||
+       cmsg->cmsg_type != SCM_RIGHTS)
+    {
+        snprintf(reply.error, SCP_MSG_SIZE, "Invalid broker request.");
+        reply.status = 1;
+        goto out;
+    }
+    memcpy(&local_fd, CMSG_DATA(cmsg), sizeof(int));
+    request.uri[SCP_URI_SIZE - 1] = 0;
+
+    if((srv_conn = decode_parameters(request.uri)) == NULL)
+    {
+        snprintf(reply.error, SCP_MSG_SIZE, "Invalid URI.");
+        reply.status = 1;
+        goto out;
+    }
+    fetch(srv_conn, local_fd, request.window, request.chunk, &reply);
+    free(srv_conn);
+
+ out:
+    if(local_fd >= 0 && close(local_fd) && reply.status == 0)
+    {
+        snprintf(reply.error, SCP_MSG_SIZE, "Cannot write destination - %s.",
+                 strerror(errno));
+        reply.status = 5;
+    }
+    if(write(client, &reply, sizeof(reply)) != sizeof(reply))
+        syslog(LOG_WARNING,"Cannot send broker reply.");
+    close(client);
+
+    pthread_mutex_lock(&broker_lock);
+    broker_active--;
+    pthread_mutex_unlock(&broker_lock);
+    return NULL;
+}
+
+/**
+ * main loop of the session broker. Every client is served by its own
+ * thread, transfers from the same server are serialized by the session
+ * lock. The broker exits when sysload ends the boot attempt, or after
+ * SCP_BROKER_IDLE seconds without clients, and closes all sessions.
+ *
+ * \param[in] listen_fd  listening socket
+*/
+void broker_main(int listen_fd)
+{
+    struct pollfd pfd;
+    pthread_t thread;
+    time_t last = time(NULL);
+    int client, active, quit, n;
+
+    pfd.fd = listen_fd;
+    pfd.events = POLLIN;
+    while(1)
+    {
+        if(poll(&pfd, 1, 1000) > 0 &&
+           (client = accept(listen_fd, NULL, NULL)) >= 0)
+        {
+            pthread_mutex_lock(&broker_lock);
+            broker_active++;
+            pthread_mutex_unlock(&broker_lock);
+            if(pthread_create(&thread, NULL, broker_client,
+                              (void *) (long) client))
+                broker_client((void *) (long) client);
+            else
+                pthread_detach(thread);
+        }
+
+        pthread_mutex_lock(&broker_lock);
+        active = broker_active;
+        quit = broker_quit;
+        pthread_mutex_unlock(&broker_lock);
+        if(active)
+            last = time(NULL);
+        else if(quit >= 0 || time(NULL) - last >= SCP_BROKER_IDLE)
+            break;
+    }
+
+    // stop accepting before the sessions are closed
+    unlink(SCP_BROKER_SOCKET);
+    close(listen_fd);
+    for(n = 0; n < session_count; n++)
+        if(sessions[n].sftp)
+            disconnect_ssh(sessions[n].sftp);
+    if(broker_quit >= 0)
+        close(broker_quit);
+    syslog(LOG_INFO,"Session broker finished.");
+}
+
+/**
+ * close all files except the given descriptor, standard input and output
+ * are redirected to /dev/null
+ *
+ * \param[in] keep  descriptor to be kept open
+*/
+void close_files(int keep)
+{
+    int fd, max;
+
+    max = sysconf(_SC_OPEN_MAX);
+    for(fd = 0; fd < max; fd++)
+        if(fd != keep)
+            close(fd);
+    fd = open("/dev/null", O_RDWR);
+    dup2(fd, 0);
+    dup2(fd, 1);
+    dup2(fd, 2);
+    if(fd > 2)
+        close(fd);
+}
+
+/**
+ * connect to the session broker. If no broker is running a new one is
+ * started in a child process.
+ *
+ * \return    connected socket or -1 if no broker is available
+*/
+int broker_connect(void)
+{
+    struct sockaddr_un addr;
+    int fd, listen_fd, attempt;
+    pid_t pid;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SCP_BROKER_SOCKET);
+
+    for(attempt = 0; attempt < 2; attempt++)
+    {
+        if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            return -1;
+        if(connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+
+        // no broker, a stale socket is left by a killed broker
+        if((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+            return -1;
+        if(bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)))
+        {
+            close(listen_fd);
+            if(errno == EADDRINUSE && attempt == 0)
+            {
+                // another client may just have started a broker
+                usleep(100000);
+                if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) >= 0 &&
+                   connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+                    return fd;
+                if(fd >= 0)
+                    close(fd);
+                unlink(SCP_BROKER_SOCKET);
+                continue;
+            }
+            return -1;
+        }
+        chmod(SCP_BROKER_SOCKET, S_IRUSR | S_IWUSR);
+        if(listen(listen_fd, 16))
+        {
+            close(listen_fd);
+            unlink(SCP_BROKER_SOCKET);
+            return -1;
+        }
+
+        if((pid = fork()) < 0)
+        {
+            close(listen_fd);
+            unlink(SCP_BROKER_SOCKET);
+            return -1;
+        }
+        if(pid == 0)
+        {
+            // the broker must not keep the pipes of the component loader
+            // or any other descriptor inherited from sysload
+            setsid();
+            signal(SIGPIPE, SIG_IGN);
+            close_files(listen_fd);
+            broker_main(listen_fd);
+            closelog();
+            _exit(0);
+        }
+        close(listen_fd);
+    }
+    return -1;
+}
+
+/**
+ * pass a request and the destination file descriptor to the broker
+ *
+ * \param[in]  broker    socket connected to the broker
+ * \param[in]  request   request to be sent
+ * \param[in]  local_fd  destination file descriptor
+ * \param[out] reply     reply of the broker
+ * \return     0 on success otherwise -1
+*/
+int broker_fetch(int broker, struct broker_request *request, int local_fd,
+                 struct broker_reply *reply)
+{
+    char control[CMSG_SPACE(sizeof(int))];
+    struct cmsghdr *cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = request;
+    iov.iov_len = sizeof(*request);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &local_fd, sizeof(int));
+
+    if(sendmsg(broker, &msg, MSG_NOSIGNAL) != sizeof(*request))
+        return -1;
+    if(recv(broker, reply, sizeof(*reply), MSG_WAITALL) != sizeof(*reply))
+        return -1;
+    reply->info[SCP_MSG_SIZE - 1] = 0;
+    reply->error[SCP_MSG_SIZE - 1] = 0;
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     struct ssh_param *srv_conn = NULL;
-    SFTP_SESSION *sftp;
-    SFTP_FILE    *sftp_file;
-    const int len = 255;
-    int rcvd = 0;
-    int acc  = 0;
-    char buffer[len+1];
+    struct broker_request request;
+    struct broker_reply reply;
     int local_fd;
+    int broker;
 
     openlog(basename(argv[0]), LOG_PID, LOG_USER);
 
@@ -229,39 +882,63 @@ int main(int argc, char **argv)
 	return 1;
     }
 
-    if((srv_conn = decode_parameters(argv[1])) == NULL)
+    // same calling convention as all loader modules: destination, URI
+    memset(&request, 0, sizeof(request));
+    if(strlen(argv[2]) >= SCP_URI_SIZE)
+    {
+        fprintf(stderr,"Invalid URI.\n");
+        return 1;
+    }
+    strcpy(request.uri, argv[2]);
+    request.window = env_setting(SCP_ENV_WINDOW, SCP_WINDOW, 1,
+                                 SCP_WINDOW_MAX);
+    request.chunk = env_setting(SCP_ENV_CHUNK, SCP_CHUNK_SIZE / 1024, 1,
+                                SCP_CHUNK_SIZE_MAX / 1024) * 1024;
+
+    if((srv_conn = decode_parameters(argv[2])) == NULL)
+    {
+        fprintf(stderr,"Invalid URI.\n");
         return 1;
+    }
 
-    if((sftp = connect_ssh(srv_conn)) == NULL)
-        return 2;
-    if((local_fd = open_local(argv[2])) == -1)
+    // start the broker before the destination is opened, so it does not
+    // inherit the descriptor
+    broker = broker_connect();
+
+    if((local_fd = open_local(argv[1])) == -1)
+    {
+        fprintf(stderr,"Cannot create '%s' - %s.\n", argv[1],
+                strerror(errno));
         return 3;
-    if((sftp_file = open_remote(srv_conn->path, sftp)) == NULL)
-        return 4;
+    }
 
-    do
+    // all transfers of a boot attempt share the sessions of the broker,
+    // transfer directly if it is not available
+    if(broker < 0 || broker_fetch(broker, &request, local_fd, &reply))
     {
-        rcvd = sftp_read(sftp_file, buffer, len);
-        if(rcvd == -1)
-        {
-            syslog(LOG_ERR,ssh_get_error(sftp->session));
-            if(write(local_fd, buffer, rcvd) != rcvd)
-                syslog(LOG_ERR,strerror(errno));
-        }
-        acc += rcvd;
-    }while(rcvd == len);
+        syslog(LOG_WARNING,"Session broker not available.");
+        if(ftruncate(local_fd, 0))
+            syslog(LOG_WARNING,"%s",strerror(errno));
+        fetch(srv_conn, local_fd, request.window, request.chunk, &reply);
+        if(sessions[0].sftp)
+            disconnect_ssh(sessions[0].sftp);
+    }
+    if(broker >= 0)
+        close(broker);
 
-    if(acc > 0)
-        syslog(LOG_INFO,"Transferred %d bytes successfully.", acc);
-    else
-        syslog(LOG_WARNING,"Nothing transferred, please check the remote file-name");
+    if(strlen(reply.info))
+        printf("%s\n", reply.info);
+    if(strlen(reply.error))
+        fprintf(stderr,"%s\n", reply.error);
 
-    sftp_file_close(sftp_file);
-    close(local_fd);
-    sftp_free(sftp);
+    if(close(local_fd) && reply.status == 0)
+    {
+        fprintf(stderr,"Cannot write '%s' - %s.\n", argv[1],
+                strerror(errno));
+        reply.status = 5;
+    }
     free(srv_conn);
     closelog();
 
-    return 0;
+    return reply.status;
 }
-
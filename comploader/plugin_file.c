@@ -0,0 +1,295 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file plugin_file.c
+ * \brief In-process component loader plugin for file URI scheme
+ *
+ * URI structure:
+ * file:///<path to file>
+ *
+ * path to file: path within local filesystem to access requested file
+ *
+ * Local files are not copied at all, the core uses them in place. If a
+ * copy is needed anyway the data is moved by copy_file_range() which
+ * shares extents with the source where the filesystem supports it.
+ *
+ * $Id$
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "comp_load.h"
+
+#define FILE_BUFFER_SIZE 65536 //!< size of fallback copy buffer
+
+
+/**
+ * Private data of an open stream.
+ */
+
+struct file_priv {
+	int fd;                     //!< open descriptor of local file
+	long long remaining;        //!< bytes left to read or -1 for all
+	int no_copy_range;          //!< copy_file_range() is not supported
+};
+
+
+/**
+ * Extract path from URI.
+ *
+ * \param[in,out] stream  Stream with URI.
+ * \return                Path within local filesystem or \c NULL if the
+ *                        URI is invalid.
+ */
+
+static const char *
+file_path(struct cl_stream *stream)
+{
+	// only the empty authority is accepted, no query or fragment
+	if (strncmp(stream->uri, "file://", 7) || stream->uri[7] != '/' ||
+	    strpbrk(stream->uri, "?#")) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Invalid URI.");
+		return NULL;
+	}
+	return stream->uri + 7;
+}
+
+
+/**
+ * Set size and validator of stream from file status.
+ *
+ * \param[in,out] stream  Stream to update.
+ * \param[in]     st      Status of local file.
+ */
+
+static void
+file_set_validator(struct cl_stream *stream, const struct stat *st)
+{
+	stream->size = st->st_size;
+	snprintf(stream->validator, CL_VALIDATOR_SIZE, "%llx-%lx-%lx.%lx",
+	    (unsigned long long) st->st_ino, (unsigned long) st->st_size,
+	    (unsigned long) st->st_mtim.tv_sec,
+	    (unsigned long) st->st_mtim.tv_nsec);
+}
+
+
+/**
+ * Report size and validator of local file named by URI.
+ *
+ * \param[in,out] stream  Stream to probe.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+file_probe(struct cl_stream *stream)
+{
+	const char *path;
+	struct stat st;
+
+	path = file_path(stream);
+	if (!path)
+		return -1;
+	if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "No such file.");
+		return -1;
+	}
+	file_set_validator(stream, &st);
+	stream->ranges = 1;
+	if (strlen(path) < CL_PATH_SIZE)
+		strcpy(stream->local_path, path);
+
+	return 0;
+}
+
+
+/**
+ * Open local file named by URI, positioned at \c stream->offset.
+ *
+ * \param[in,out] stream  Stream to open.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+file_open(struct cl_stream *stream)
+{
+	struct file_priv *priv;
+	const char *path;
+	struct stat st;
+
+	path = file_path(stream);
+	if (!path)
+		return -1;
+
+	priv = malloc(sizeof(*priv));
+	if (!priv) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Out of memory.");
+		return -1;
+	}
+	priv->fd = open(path, O_RDONLY);
+	if (priv->fd < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "No such file.");
+		free(priv);
+		return -1;
+	}
+	if (fstat(priv->fd, &st) == 0 && S_ISREG(st.st_mode))
+		file_set_validator(stream, &st);
+	if (stream->offset > 0 &&
+	    lseek(priv->fd, stream->offset, SEEK_SET) < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", strerror(errno));
+		close(priv->fd);
+		free(priv);
+		return -1;
+	}
+	priv->remaining = stream->length;
+	priv->no_copy_range = 0;
+
+	stream->priv = priv;
+	return 0;
+}
+
+
+/**
+ * Read next chunk of local file.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[out]    buf     Destination buffer.
+ * \param[in]     count   Size of destination buffer.
+ * \return                Number of bytes read, zero at end of file,
+ *                        negative value on error.
+ */
+
+static ssize_t
+file_read(struct cl_stream *stream, void *buf, size_t count)
+{
+	struct file_priv *priv = stream->priv;
+	ssize_t ret;
+
+	if (priv->remaining >= 0 && count > priv->remaining)
+		count = priv->remaining;
+	if (count == 0)
+		return 0;
+	do {
+		ret = read(priv->fd, buf, count);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0)
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", strerror(errno));
+	else if (priv->remaining > 0)
+		priv->remaining -= ret;
+
+	return ret;
+}
+
+
+/**
+ * Copy next chunk of local file to \p fd without passing it through user
+ * space. Falls back to read() and pwrite() if copy_file_range() is not
+ * supported, e.g. between different filesystems on older kernels.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[in]     fd      Destination file descriptor.
+ * \param[in]     offset  Position in destination file.
+ * \param[in]     count   Maximum number of bytes to copy.
+ * \return                Number of bytes copied, zero at end of file,
+ *                        negative value on error.
+ */
+
+static ssize_t
+file_copy(struct cl_stream *stream, int fd, long long offset, size_t count)
+{
+	struct file_priv *priv = stream->priv;
+	char buffer[FILE_BUFFER_SIZE];
+	loff_t out = offset;
+	ssize_t ret, written, done;
+
+	if (priv->remaining >= 0 && count > priv->remaining)
+		count = priv->remaining;
+	if (count == 0)
+		return 0;
+
+	if (!priv->no_copy_range) {
+		do {
+			ret = copy_file_range(priv->fd, NULL, fd, &out, count,
+			    0);
+		} while (ret < 0 && errno == EINTR);
+		if (ret >= 0 || (errno != EXDEV && errno != ENOSYS &&
+		    errno != EINVAL && errno != EOPNOTSUPP))
+			goto out;
+		priv->no_copy_range = 1;
+	}
+
+	ret = file_read(stream, buffer,
+	    count < sizeof(buffer) ? count : sizeof(buffer));
+	for (done = 0; ret > 0 && done < ret; done += written) {
+		written = pwrite(fd, buffer + done, ret - done, offset + done);
+		if (written < 0 && errno == EINTR)
+			written = 0;
+		else if (written < 0) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Cannot write - %s.", strerror(errno));
+			return -1;
+		}
+	}
+	return ret;
+
+ out:
+	if (ret < 0)
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", strerror(errno));
+	else if (priv->remaining > 0)
+		priv->remaining -= ret;
+
+	return ret;
+}
+
+
+/**
+ * Close local file.
+ *
+ * \param[in,out] stream  Open stream.
+ */
+
+static void
+file_close(struct cl_stream *stream)
+{
+	struct file_priv *priv = stream->priv;
+
+	close(priv->fd);
+	free(priv);
+	stream->priv = NULL;
+}
+
+
+static const struct cl_plugin file_plugin = {
+	.abi_version = CL_PLUGIN_ABI_VERSION,
+	.scheme      = "file",
+	.open        = file_open,
+	.read        = file_read,
+	.close       = file_close,
+	.probe       = file_probe,
+	.copy        = file_copy,
+};
+
+
+/**
+ * Plugin entry point.
+ *
+ * \return Description of this plugin.
+ */
+
+const struct cl_plugin *
+cl_plugin_entry(void)
+{
+	return &file_plugin;
+}
@@ -0,0 +1,1059 @@
+/**
+ * Copyright IBM Corp. 2006, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file plugin_http.c
+ * \brief In-process component loader plugin for http URI scheme
+ *
+ * URI structure:
+ * http://[account[:password]@]<host>[:port]/<path to file>
+ *
+ * if the account includes the "@" character, like in an email address
+ * it has to be replaced with "%40"
+ *
+ * Connections are kept open after a complete response and reused for
+ * further requests to the same host until the release function of the
+ * plugin is called at the end of a boot attempt.
+ *
+ * Connection attempts and single reads and writes are limited by the
+ * timeouts of the stream. A server which cannot be resolved or connected
+ * to, or which drops the connection before it answers, is reported as
+ * unreachable; an answer with an error status is not.
+ *
+ * $Id$
+ */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "comp_load.h"
+
+#define HTTP_HOST_SIZE     256    //!< maximum length of host name
+#define HTTP_PORT_SIZE     8      //!< maximum length of port
+#define HTTP_LINE_SIZE     4096   //!< maximum length of header line
+#define HTTP_TAG_SIZE      96     //!< maximum length of validator fields
+#define HTTP_BUFFER_SIZE   8192   //!< size of connection read buffer
+#define HTTP_POOL_SIZE     8      //!< maximum number of idle connections
+#define HTTP_MAX_REDIRECTS 5      //!< maximum number of redirects
+#define HTTP_DEFAULT_PORT  "80"   //!< default http port
+
+
+/**
+ * Open connection to a http server.
+ */
+
+struct http_conn {
+	char host[HTTP_HOST_SIZE];     //!< server host name
+	char port[HTTP_PORT_SIZE];     //!< server port
+	int fd;                        //!< socket
+	char buffer[HTTP_BUFFER_SIZE]; //!< received but unread data
+	size_t pos;                    //!< read position in buffer
+	size_t len;                    //!< number of valid bytes in buffer
+};
+
+
+/**
+ * Components of a http URI.
+ */
+
+struct http_uri {
+	char host[HTTP_HOST_SIZE];     //!< server host name
+	char port[HTTP_PORT_SIZE];     //!< server port
+	char *auth;                    //!< base64 encoded credentials or NULL
+	char *path;                    //!< request target
+};
+
+
+/**
+ * State of one transfer.
+ */
+
+struct http_stream {
+	struct http_conn *conn;        //!< connection used for transfer
+	int status;                    //!< http status code
+	int chunked;                   //!< chunked transfer encoding
+	long long remaining;           //!< bytes left in body or chunk,
+	                               //!< -1 if body ends with connection
+	long long length;              //!< Content-Length or -1
+	long long total;               //!< size from Content-Range or -1
+	int ranges;                    //!< server accepts range requests
+	int keep_alive;                //!< connection may be reused
+	int eof;                       //!< complete body has been read
+	char location[HTTP_LINE_SIZE]; //!< redirect target
+	char etag[HTTP_TAG_SIZE];      //!< entity tag
+	char modified[HTTP_TAG_SIZE];  //!< last modification date
+};
+
+static struct http_conn *http_pool[HTTP_POOL_SIZE];
+static pthread_mutex_t http_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Decode %XX escapes in place.
+ *
+ * \param[in,out] str  String to decode.
+ */
+
+static void
+http_unescape(char *str)
+{
+	char *in, *out, hex[3] = { 0, 0, 0 };
+
+	for (in = out = str; *in; in++, out++) {
+		if (in[0] == '%' && isxdigit(in[1]) && isxdigit(in[2])) {
+			hex[0] = in[1];
+			hex[1] = in[2];
+			*out = (char) strtol(hex, NULL, 16);
+			in += 2;
+		} else
+			*out = *in;
+	}
+	*out = '\0';
+}
+
+
+/**
+ * Encode string with base64.
+ *
+ * \param[in] src  String to encode.
+ * \return         Dynamically allocated encoded string or NULL.
+ */
+
+static char *
+http_base64(const char *src)
+{
+	static const char table[] =
+	    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t len = strlen(src), n;
+	unsigned long bits;
+	char *dest, *out;
+
+	dest = malloc((len + 2) / 3 * 4 + 1);
+	if (!dest)
+		return NULL;
+	for (n = 0, out = dest; n < len; n += 3) {
+		bits = (unsigned char) src[n] << 16;
+		if (n + 1 < len)
+			bits |= (unsigned char) src[n + 1] << 8;
+		if (n + 2 < len)
+			bits |= (unsigned char) src[n + 2];
+		*out++ = table[(bits >> 18) & 0x3f];
+		*out++ = table[(bits >> 12) & 0x3f];
+		*out++ = n + 1 < len ? table[(bits >> 6) & 0x3f] : '=';
+		*out++ = n + 2 < len ? table[bits & 0x3f] : '=';
+	}
+	*out = '\0';
+
+	return dest;
+}
+
+
+/**
+ * Split http URI into its components.
+ *
+ * \param[out] uri     Parsed URI, \c auth and \c path are dynamically
+ *                     allocated.
+ * \param[in]  str     URI to parse.
+ * \param[out] errmsg  Buffer for error message.
+ * \return             Zero on success, non-zero on error.
+ */
+
+static int
+http_parse_uri(struct http_uri *uri, const char *str, char *errmsg)
+{
+	const char *auth_end, *host, *host_end, *port = NULL, *ptr;
+	char *userinfo;
+	size_t len;
+
+	memset(uri, 0, sizeof(*uri));
+	if (strncasecmp(str, "http://", 7))
+		goto invalid;
+	str += 7;
+
+	auth_end = str + strcspn(str, "/?#");
+	host = str;
+	for (ptr = str; ptr < auth_end; ptr++)
+		if (*ptr == '@')
+			host = ptr + 1;
+
+	// host is either a name, an IPv4 address or an IPv6 literal
+	if (*host == '[') {
+		host_end = memchr(host, ']', auth_end - host);
+		if (!host_end)
+			goto invalid;
+		host++;
+		if (host_end + 1 < auth_end && host_end[1] == ':')
+			port = host_end + 2;
+	} else {
+		host_end = memchr(host, ':', auth_end - host);
+		if (host_end)
+			port = host_end + 1;
+		else
+			host_end = auth_end;
+	}
+	len = host_end - host;
+	if (len == 0 || len >= HTTP_HOST_SIZE)
+		goto invalid;
+	memcpy(uri->host, host, len);
+	if (port && port < auth_end) {
+		len = auth_end - port;
+		if (len >= HTTP_PORT_SIZE)
+			goto invalid;
+		memcpy(uri->port, port, len);
+	} else
+		strcpy(uri->port, HTTP_DEFAULT_PORT);
+
+	if (host > str) {
+		userinfo = strndup(str, host - 1 - str);
+		if (!userinfo)
+			goto nomem;
+		http_unescape(userinfo);
+		uri->auth = http_base64(userinfo);
+		free(userinfo);
+		if (!uri->auth)
+			goto nomem;
+	}
+
+	// fragments are not sent to the server
+	len = strcspn(auth_end, "#");
+	if (len == 0 || *auth_end != '/') {
+		uri->path = malloc(len + 2);
+		if (!uri->path)
+			goto nomem;
+		uri->path[0] = '/';
+		memcpy(uri->path + 1, auth_end, len);
+		uri->path[len + 1] = '\0';
+	} else {
+		uri->path = strndup(auth_end, len);
+		if (!uri->path)
+			goto nomem;
+	}
+
+	return 0;
+
+ invalid:
+	snprintf(errmsg, CL_MSG_SIZE, "Invalid URI.");
+	return -1;
+ nomem:
+	free(uri->auth);
+	uri->auth = NULL;
+	snprintf(errmsg, CL_MSG_SIZE, "Out of memory.");
+	return -1;
+}
+
+
+/**
+ * Free memory allocated by http_parse_uri().
+ *
+ * \param[in,out] uri  Parsed URI.
+ */
+
+static void
+http_free_uri(struct http_uri *uri)
+{
+	free(uri->auth);
+	free(uri->path);
+	uri->auth = NULL;
+	uri->path = NULL;
+}
+
+
+/**
+ * Close connection and free its memory.
+ *
+ * \param[in] conn  Connection to close.
+ */
+
+static void
+http_conn_close(struct http_conn *conn)
+{
+	if (!conn)
+		return;
+	close(conn->fd);
+	free(conn);
+}
+
+
+/**
+ * Connect socket to a server, giving up after \p timeout seconds.
+ *
+ * \param[in] fd       Socket.
+ * \param[in] addr     Address of the server.
+ * \param[in] len      Length of \p addr.
+ * \param[in] timeout  Timeout in seconds, 0 for no limit.
+ * \return             Zero on success, non-zero on error (errno set).
+ */
+
+static int
+http_connect(int fd, const struct sockaddr *addr, socklen_t len, int timeout)
+{
+	struct pollfd pfd;
+	socklen_t errlen = sizeof(int);
+	int flags, err = 0, ret;
+
+	if (timeout <= 0)
+		return connect(fd, addr, len);
+
+	flags = fcntl(fd, F_GETFL);
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+	ret = connect(fd, addr, len);
+	if (ret && errno == EINPROGRESS) {
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		do {
+			ret = poll(&pfd, 1, timeout * 1000);
+		} while (ret < 0 && errno == EINTR);
+		if (ret == 0) {
+			errno = ETIMEDOUT;
+			ret = -1;
+		} else if (ret > 0) {
+			getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+			errno = err;
+			ret = err ? -1 : 0;
+		}
+	}
+	err = errno;
+	fcntl(fd, F_SETFL, flags);
+	errno = err;
+
+	return ret;
+}
+
+
+/**
+ * Limit the time a single read or write on a connection may block.
+ *
+ * \param[in] conn     Connection.
+ * \param[in] timeout  Timeout in seconds, 0 for no limit.
+ */
+
+static void
+http_conn_timeout(struct http_conn *conn, int timeout)
+{
+	struct timeval tv;
+
+	tv.tv_sec = timeout > 0 ? timeout : 0;
+	tv.tv_usec = 0;
+	setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	setsockopt(conn->fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+
+/**
+ * Get connection to a server. An idle connection from the pool is
+ * used if available, otherwise a new connection is established.
+ *
+ * \param[in]  uri     Parsed URI naming the server.
+ * \param[in]  stream  Stream with the timeouts for the connection.
+ * \param[out] reused  Set to non-zero if connection was taken from pool.
+ * \param[out] errmsg  Buffer for error message.
+ * \return             Connection or NULL on error.
+ */
+
+static struct http_conn *
+http_conn_get(struct http_uri *uri, const struct cl_stream *stream,
+    int *reused, char *errmsg)
+{
+	struct addrinfo hints, *result, *ai;
+	struct http_conn *conn = NULL;
+	int n, fd = -1, err, one = 1;
+
+	pthread_mutex_lock(&http_pool_lock);
+	for (n = 0; n < HTTP_POOL_SIZE; n++) {
+		if (http_pool[n] && !strcmp(http_pool[n]->host, uri->host) &&
+		    !strcmp(http_pool[n]->port, uri->port)) {
+			conn = http_pool[n];
+			http_pool[n] = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&http_pool_lock);
+	if (conn) {
+		http_conn_timeout(conn, stream->io_timeout);
+		*reused = 1;
+		return conn;
+	}
+	*reused = 0;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	err = getaddrinfo(uri->host, uri->port, &hints, &result);
+	if (err) {
+		snprintf(errmsg, CL_MSG_SIZE, "Cannot resolve '%s' - %s.",
+		    uri->host, gai_strerror(err));
+		return NULL;
+	}
+	for (ai = result; ai; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (http_connect(fd, ai->ai_addr, ai->ai_addrlen,
+			stream->connect_timeout) == 0)
+			break;
+		err = errno;
+		close(fd);
+		fd = -1;
+		errno = err;
+	}
+	freeaddrinfo(result);
+	if (fd < 0) {
+		snprintf(errmsg, CL_MSG_SIZE, "Cannot connect to '%s' - %s.",
+		    uri->host, strerror(errno));
+		return NULL;
+	}
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	conn = calloc(1, sizeof(*conn));
+	if (!conn) {
+		close(fd);
+		snprintf(errmsg, CL_MSG_SIZE, "Out of memory.");
+		return NULL;
+	}
+	strcpy(conn->host, uri->host);
+	strcpy(conn->port, uri->port);
+	conn->fd = fd;
+	http_conn_timeout(conn, stream->io_timeout);
+
+	return conn;
+}
+
+
+/**
+ * Return connection to the pool. The connection is closed if the pool
+ * is full.
+ *
+ * \param[in] conn  Idle connection.
+ */
+
+static void
+http_conn_put(struct http_conn *conn)
+{
+	int n;
+
+	pthread_mutex_lock(&http_pool_lock);
+	for (n = 0; n < HTTP_POOL_SIZE; n++) {
+		if (!http_pool[n]) {
+			http_pool[n] = conn;
+			conn = NULL;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&http_pool_lock);
+	http_conn_close(conn);
+}
+
+
+/**
+ * Read data from connection, buffered data first.
+ *
+ * \param[in]  conn   Connection to read from.
+ * \param[out] buf    Destination buffer.
+ * \param[in]  count  Size of destination buffer.
+ * \return            Number of bytes read, zero on end of file, negative
+ *                    value on error.
+ */
+
+static ssize_t
+http_conn_read(struct http_conn *conn, void *buf, size_t count)
+{
+	ssize_t ret;
+
+	if (conn->pos < conn->len) {
+		if (count > conn->len - conn->pos)
+			count = conn->len - conn->pos;
+		memcpy(buf, conn->buffer + conn->pos, count);
+		conn->pos += count;
+		return count;
+	}
+	do {
+		ret = read(conn->fd, buf, count);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+
+/**
+ * Read one line terminated by LF from connection. CR and LF are
+ * removed.
+ *
+ * \param[in]  conn  Connection to read from.
+ * \param[out] line  Buffer of size #HTTP_LINE_SIZE.
+ * \return           Zero on success, non-zero on error or end of file.
+ */
+
+static int
+http_conn_getline(struct http_conn *conn, char *line)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (1) {
+		if (conn->pos == conn->len) {
+			do {
+				ret = read(conn->fd, conn->buffer,
+				    HTTP_BUFFER_SIZE);
+			} while (ret < 0 && errno == EINTR);
+			if (ret <= 0)
+				return -1;
+			conn->pos = 0;
+			conn->len = ret;
+		}
+		if (conn->buffer[conn->pos] == '\n') {
+			conn->pos++;
+			break;
+		}
+		if (len < HTTP_LINE_SIZE - 1)
+			line[len++] = conn->buffer[conn->pos];
+		conn->pos++;
+	}
+	if (len > 0 && line[len - 1] == '\r')
+		len--;
+	line[len] = '\0';
+
+	return 0;
+}
+
+
+/**
+ * Write complete buffer to connection.
+ *
+ * \param[in] conn  Connection to write to.
+ * \param[in] buf   Data to write.
+ * \param[in] len   Number of bytes to write.
+ * \return          Zero on success, non-zero on error.
+ */
+
+static int
+http_conn_write(struct http_conn *conn, const char *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = send(conn->fd, buf, len, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Send request and read response header.
+ *
+ * \param[in]     conn    Connection to use.
+ * \param[in]     method  Request method.
+ * \param[in]     uri     Parsed URI.
+ * \param[in,out] hs      Transfer state, filled with header information.
+ * \param[in,out] stream  Stream for size and messages.
+ * \return                Zero on success, -1 if the connection failed
+ *                        before a response was received, -2 on other
+ *                        errors.
+ */
+
+static int
+http_request(struct http_conn *conn, const char *method, struct http_uri *uri,
+    struct http_stream *hs, struct cl_stream *stream)
+{
+	char *request, line[HTTP_LINE_SIZE], *value, range[64] = "";
+	int len;
+
+	if (stream->length > 0)
+		snprintf(range, sizeof(range), "Range: bytes=%lld-%lld\r\n",
+		    stream->offset, stream->offset + stream->length - 1);
+	else if (stream->offset > 0)
+		snprintf(range, sizeof(range), "Range: bytes=%lld-\r\n",
+		    stream->offset);
+
+	len = asprintf(&request,
+	    "%s %s HTTP/1.1\r\n"
+	    "Host: %s%s%s\r\n"
+	    "User-Agent: sysload\r\n"
+	    "%s%s%s%s"
+	    "Connection: keep-alive\r\n"
+	    "\r\n",
+	    method, uri->path, uri->host,
+	    strcmp(uri->port, HTTP_DEFAULT_PORT) ? ":" : "",
+	    strcmp(uri->port, HTTP_DEFAULT_PORT) ? uri->port : "",
+	    uri->auth ? "Authorization: Basic " : "",
+	    uri->auth ? uri->auth : "", uri->auth ? "\r\n" : "", range);
+	if (len < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Out of memory.");
+		return -2;
+	}
+	len = http_conn_write(conn, request, len);
+	free(request);
+	if (len || http_conn_getline(conn, line))
+		return -1;
+
+	// status line
+	if (strncmp(line, "HTTP/1.", 7) ||
+	    sscanf(line + 8, " %d", &hs->status) != 1) {
+		snprintf(stream->errmsg, CL_MSG_SIZE,
+		    "Invalid response from '%s'.", uri->host);
+		return -2;
+	}
+	hs->keep_alive = (line[7] == '1');
+	hs->chunked = 0;
+	hs->length = -1;
+	hs->total = -1;
+	hs->ranges = 0;
+	hs->eof = 0;
+	hs->location[0] = '\0';
+	hs->etag[0] = '\0';
+	hs->modified[0] = '\0';
+
+	// header fields
+	while (1) {
+		if (http_conn_getline(conn, line)) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Connection to '%s' closed.", uri->host);
+			return -2;
+		}
+		if (line[0] == '\0')
+			break;
+		value = strchr(line, ':');
+		if (!value)
+			continue;
+		*value++ = '\0';
+		value += strspn(value, " \t");
+
+		if (!strcasecmp(line, "Content-Length"))
+			hs->length = strtoll(value, NULL, 10);
+		else if (!strcasecmp(line, "Content-Range") &&
+		    strchr(value, '/'))
+			hs->total = strtoll(strchr(value, '/') + 1, NULL, 10);
+		else if (!strcasecmp(line, "Accept-Ranges"))
+			hs->ranges = (strcasestr(value, "bytes") != NULL);
+		else if (!strcasecmp(line, "Transfer-Encoding"))
+			hs->chunked = (strcasestr(value, "chunked") != NULL);
+		else if (!strcasecmp(line, "Connection"))
+			hs->keep_alive = (strcasestr(value, "close") == NULL) &&
+			    (hs->keep_alive ||
+			    strcasestr(value, "keep-alive") != NULL);
+		else if (!strcasecmp(line, "Location"))
+			snprintf(hs->location, HTTP_LINE_SIZE, "%s", value);
+		else if (!strcasecmp(line, "ETag"))
+			snprintf(hs->etag, HTTP_TAG_SIZE, "%s", value);
+		else if (!strcasecmp(line, "Last-Modified"))
+			snprintf(hs->modified, HTTP_TAG_SIZE, "%s", value);
+	}
+	hs->remaining = hs->chunked ? 0 : hs->length;
+	if (hs->remaining < 0)
+		hs->keep_alive = 0;
+
+	return 0;
+}
+
+
+/**
+ * Skip body of a response which is not used, e.g. of a redirect, and
+ * return the connection to the pool. Connections with large or chunked
+ * bodies are closed instead.
+ *
+ * \param[in,out] hs      Transfer state.
+ * \param[in]     method  Request method of the response.
+ */
+
+static void
+http_discard(struct http_stream *hs, const char *method)
+{
+	char buffer[HTTP_BUFFER_SIZE];
+	ssize_t ret;
+
+	// responses to HEAD have no body regardless of the header
+	if (!strcmp(method, "HEAD")) {
+		hs->chunked = 0;
+		hs->remaining = 0;
+	}
+	if (!hs->keep_alive || hs->chunked || hs->remaining < 0 ||
+	    hs->remaining > HTTP_BUFFER_SIZE) {
+		http_conn_close(hs->conn);
+		hs->conn = NULL;
+		return;
+	}
+	while (hs->remaining > 0) {
+		ret = http_conn_read(hs->conn, buffer, hs->remaining);
+		if (ret <= 0) {
+			http_conn_close(hs->conn);
+			hs->conn = NULL;
+			return;
+		}
+		hs->remaining -= ret;
+	}
+	http_conn_put(hs->conn);
+	hs->conn = NULL;
+}
+
+
+/**
+ * Send request over a pooled or new connection. A request on a pooled
+ * connection which has been closed by the server in the meantime is
+ * repeated on a new connection.
+ *
+ * \param[in]     method  Request method.
+ * \param[in]     uri     Parsed URI.
+ * \param[in,out] hs      Transfer state.
+ * \param[in,out] stream  Stream for messages.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+http_exchange(const char *method, struct http_uri *uri,
+    struct http_stream *hs, struct cl_stream *stream)
+{
+	int reused, ret;
+
+	do {
+		hs->conn = http_conn_get(uri, stream, &reused,
+		    stream->errmsg);
+		if (!hs->conn) {
+			stream->unreachable = 1;
+			return -1;
+		}
+		ret = http_request(hs->conn, method, uri, hs, stream);
+		if (ret) {
+			http_conn_close(hs->conn);
+			hs->conn = NULL;
+		}
+	} while (ret == -1 && reused);
+
+	if (ret == -1) {
+		snprintf(stream->errmsg, CL_MSG_SIZE,
+		    "Connection to '%s' failed.", uri->host);
+		stream->unreachable = 1;
+	}
+
+	return ret;
+}
+
+
+/**
+ * Perform request and follow redirects.
+ *
+ * \param[in]     method  Request method.
+ * \param[in,out] hs      Transfer state.
+ * \param[in,out] stream  Stream with URI.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+http_perform(const char *method, struct http_stream *hs,
+    struct cl_stream *stream)
+{
+	struct http_uri uri;
+	char *target, *next;
+	int redirects = 0, ret = -1;
+
+	target = strdup(stream->uri);
+	if (!target) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Out of memory.");
+		return -1;
+	}
+
+	while (1) {
+		if (http_parse_uri(&uri, target, stream->errmsg))
+			break;
+		if (http_exchange(method, &uri, hs, stream)) {
+			http_free_uri(&uri);
+			break;
+		}
+		if (hs->status < 300 || hs->status >= 400 ||
+		    !strlen(hs->location)) {
+			http_free_uri(&uri);
+			ret = 0;
+			break;
+		}
+
+		// redirect, the connection may still be used for the
+		// new location
+		http_discard(hs, method);
+		if (++redirects > HTTP_MAX_REDIRECTS) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Too many redirects.");
+			http_free_uri(&uri);
+			break;
+		}
+		if (hs->location[0] == '/') {
+			if (asprintf(&next, "http://%s%s%s:%s%s",
+				strchr(uri.host, ':') ? "[" : "", uri.host,
+				strchr(uri.host, ':') ? "]" : "", uri.port,
+				hs->location) < 0)
+				next = NULL;
+		} else
+			next = strdup(hs->location);
+		http_free_uri(&uri);
+		free(target);
+		target = next;
+		if (!target) {
+			snprintf(stream->errmsg, CL_MSG_SIZE, "Out of memory.");
+			return -1;
+		}
+	}
+	free(target);
+
+	if (!ret && (hs->status < 200 || hs->status >= 300)) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Server reported"
+		    " status %d for '%s'.", hs->status, stream->uri);
+		http_discard(hs, method);
+		ret = -1;
+	}
+
+	return ret;
+}
+
+
+/**
+ * Set validator from entity tag or modification date.
+ *
+ * \param[in]     hs      Transfer state with response header.
+ * \param[in,out] stream  Stream to set validator for.
+ */
+
+static void
+http_set_validator(struct http_stream *hs, struct cl_stream *stream)
+{
+	if (hs->status == 206)
+		stream->size = hs->total;
+	else
+		stream->size = hs->chunked ? -1 : hs->length;
+
+	// weak entity tags and dates are only used together with the size
+	if (strlen(hs->etag) && strncmp(hs->etag, "W/", 2))
+		snprintf(stream->validator, CL_VALIDATOR_SIZE, "%s",
+		    hs->etag);
+	else if (stream->size >= 0 && strlen(hs->etag))
+		snprintf(stream->validator, CL_VALIDATOR_SIZE, "%lld %s",
+		    stream->size, hs->etag);
+	else if (stream->size >= 0 && strlen(hs->modified))
+		snprintf(stream->validator, CL_VALIDATOR_SIZE, "%lld %s",
+		    stream->size, hs->modified);
+	else
+		stream->validator[0] = '\0';
+}
+
+
+/**
+ * Report size and validator of file using a HEAD request.
+ *
+ * \param[in,out] stream  Stream to probe.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+http_probe(struct cl_stream *stream)
+{
+	struct http_stream hs;
+
+	memset(&hs, 0, sizeof(hs));
+	if (http_perform("HEAD", &hs, stream))
+		return -1;
+	http_set_validator(&hs, stream);
+	stream->ranges = hs.ranges && stream->size >= 0;
+	if (hs.keep_alive)
+		http_conn_put(hs.conn);
+	else
+		http_conn_close(hs.conn);
+
+	return 0;
+}
+
+
+/**
+ * Open file on http server.
+ *
+ * \param[in,out] stream  Stream to open.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+http_open(struct cl_stream *stream)
+{
+	struct http_stream *hs;
+
+	hs = calloc(1, sizeof(*hs));
+	if (!hs) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Out of memory.");
+		return -1;
+	}
+	if (http_perform("GET", hs, stream)) {
+		free(hs);
+		return -1;
+	}
+	if ((stream->offset > 0 || stream->length >= 0) &&
+	    hs->status != 206) {
+		snprintf(stream->errmsg, CL_MSG_SIZE,
+		    "Server ignored range request.");
+		http_conn_close(hs->conn);
+		free(hs);
+		return -1;
+	}
+	http_set_validator(hs, stream);
+	if (!hs->chunked && hs->remaining == 0)
+		hs->eof = 1;
+	stream->priv = hs;
+
+	return 0;
+}
+
+
+/**
+ * Read next chunk of response body.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[out]    buf     Destination buffer.
+ * \param[in]     count   Size of destination buffer.
+ * \return                Number of bytes read, zero at end of file,
+ *                        negative value on error.
+ */
+
+static ssize_t
+http_read(struct cl_stream *stream, void *buf, size_t count)
+{
+	struct http_stream *hs = stream->priv;
+	char line[HTTP_LINE_SIZE];
+	ssize_t ret;
+
+	if (hs->eof)
+		return 0;
+
+	// start of next chunk: size line, a zero size ends the body
+	if (hs->chunked && hs->remaining == 0) {
+		if (http_conn_getline(hs->conn, line))
+			goto closed;
+		hs->remaining = strtoll(line, NULL, 16);
+		if (hs->remaining == 0) {
+			do {
+				if (http_conn_getline(hs->conn, line))
+					goto closed;
+			} while (strlen(line));
+			hs->eof = 1;
+			return 0;
+		}
+	}
+
+	if (hs->remaining >= 0 && count > hs->remaining)
+		count = hs->remaining;
+	ret = http_conn_read(hs->conn, buf, count);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "No data received for %d "
+		    "seconds.", stream->io_timeout);
+		return -1;
+	}
+	if (ret < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", strerror(errno));
+		return -1;
+	}
+	if (ret == 0) {
+		if (hs->remaining < 0) {
+			hs->eof = 1;
+			return 0;
+		}
+		goto closed;
+	}
+	if (hs->remaining > 0)
+		hs->remaining -= ret;
+
+	// end of chunk is followed by CRLF, end of body by nothing
+	if (hs->remaining == 0) {
+		if (hs->chunked) {
+			if (http_conn_getline(hs->conn, line))
+				goto closed;
+		} else
+			hs->eof = 1;
+	}
+
+	return ret;
+
+ closed:
+	snprintf(stream->errmsg, CL_MSG_SIZE,
+	    "Connection closed before end of file.");
+	return -1;
+}
+
+
+/**
+ * Finish transfer. The connection is returned to the pool if the
+ * response has been read completely.
+ *
+ * \param[in,out] stream  Open stream.
+ */
+
+static void
+http_close(struct cl_stream *stream)
+{
+	struct http_stream *hs = stream->priv;
+
+	if (hs->eof && hs->keep_alive)
+		http_conn_put(hs->conn);
+	else
+		http_conn_close(hs->conn);
+	free(hs);
+	stream->priv = NULL;
+}
+
+
+/**
+ * Close all idle connections.
+ */
+
+static void
+http_release(void)
+{
+	int n;
+
+	pthread_mutex_lock(&http_pool_lock);
+	for (n = 0; n < HTTP_POOL_SIZE; n++) {
+		http_conn_close(http_pool[n]);
+		http_pool[n] = NULL;
+	}
+	pthread_mutex_unlock(&http_pool_lock);
+}
+
+
+static const struct cl_plugin http_plugin = {
+	.abi_version = CL_PLUGIN_ABI_VERSION,
+	.scheme      = "http",
+	.open        = http_open,
+	.read        = http_read,
+	.close       = http_close,
+	.probe       = http_probe,
+	.release     = http_release,
+};
+
+
+/**
+ * Plugin entry point.
+ *
+ * \return Description of this plugin.
+ */
+
+const struct cl_plugin *
+cl_plugin_entry(void)
+{
+	return &http_plugin;
+}
@@ -66,6 +66,11 @@ struct hd_geometry {
 	unsigned long start;
 };
 
+// maximum number of additional paths to a disk
+#define DISK_MAX_PATHS                  7
+// maximum number of concurrent readers of a component
+#define DISK_MAX_READERS                16
+
 // Disk type
 struct disk {
 	int fd;
@@ -74,6 +79,9 @@ struct disk {
 	uint64_t phy_blocks;
 	struct hd_geometry geo;
 	disk_blockptr_t program_table_ptr;
+	int path_fd[DISK_MAX_PATHS];    // additional paths to the same disk
+	int paths;                      // number of additional paths
+	int readers;                    // concurrent readers of a component
 };
 
 // path to create private block device nodes
@@ -90,6 +98,8 @@ void disk_close(struct disk *disk);
 char *disk_read_dasd_boot_record(struct disk *disk);
 char *disk_read_scsi_mbr(struct disk *disk);
 char *disk_open(struct disk *disk, const char *path);
+char *disk_add_path(struct disk *disk, const char *path);
+int disk_parse_readers(const char *value);
 void read_packed_blockptr(struct disk *disk, disk_blockptr_t *ptr,
     void *buffer);
 char *disk_read_phy_blocks(struct disk *disk, void *buffer,
@@ -99,5 +109,14 @@ char *boot_bootmap_disk(struct cfg_bentry *boot, struct disk *disk,
     int program);
 char *action_bootmap_boot_dasd(struct cfg_bentry *boot);
 char *action_bootmap_boot_zfcp(struct cfg_bentry *boot);
+char *set_dasd_online(const char *busid, char **dev);
+void set_dasd_offline(const char *busid);
+int dasd_is_online(const char *busid);
+char *set_fcp_disk_online(const char *busid, const char *wwpn,
+    const char *lun, char **dev);
+int set_fcp_disk_offline(const char *busid, const char *wwpn,
+    const char *lun);
+int fcp_disk_is_online(const char *busid, const char *wwpn,
+    const char *lun);
 
 #endif /* #ifndef _BOOTMAP_H_ */
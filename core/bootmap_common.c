@@ -14,6 +14,8 @@
  */
 
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
@@ -24,9 +26,11 @@
 #include <fcntl.h>
 #include <ctype.h>
 #include <sys/ioctl.h>
+#include <pthread.h>
 #include "sysload.h"
 #include "loader.h"
 #include "bootmap.h"
+#include "uri.h"
 
 
 // Most of the following definitions are take from zipl
@@ -126,6 +130,13 @@ struct zipl_stage3_params {
 #define PSW_DISABLED_WAIT               0x000a000000000000LL
 #define KERNEL_HEADER_SIZE              65536
 
+// Bounce buffer for code segments which cannot be spliced into a file
+#define COMPONENT_COPY_SIZE             (256 * 1024)
+// Pipe size requested for splicing code segments into a file
+#define COMPONENT_PIPE_SIZE             (1024 * 1024)
+// Granularity of the shares of concurrent readers of a component
+#define COMPONENT_SHARE_SIZE            (4 * 1024 * 1024)
+
 // IPL type in component table
 typedef enum {
         component_header_ipl = 0x00,
@@ -168,7 +179,7 @@ echo_and_test(const char *echo, const char *data, unsigned long msleep,
 	}
 
 	// sleep
-	if (usleep > 0) {
+	if (msleep > 0) {
 		rem.tv_sec = msleep / 1000;
 		rem.tv_nsec = (msleep % 1000) * 1000000;
 		do {
@@ -567,29 +578,98 @@ disk_open(struct disk *disk, const char *path)
 void
 disk_close(struct disk *disk)
 {
+	int n;
+
+	for (n = 0; n < disk->paths; n++)
+		close(disk->path_fd[n]);
 	close(disk->fd);
 }
 
 
 /**
- * Read physical blocks addressed by \p blockptr from disk into
- * memory. \p blockptr format must match disk type. On success NULL is
+ * Add another path to an open disk, e.g. the block device of the same
+ * LUN attached through another FCP channel or WWPN. Concurrent readers
+ * of a component are distributed over all paths. On success NULL is
  * returned. On error a dynamically allocated error message is returned.
  *
+ * \param[in,out] disk  Pointer to initialized disk structure
+ * \param[in]     path  Path to block device of the same disk
+ * \return        In case of error dynamically allocated error message.
+ */
+
+char *
+disk_add_path(struct disk *disk, const char *path)
+{
+	char *errmsg = NULL;
+	long devsize;
+	int fd, phy_block_size;
+
+	if (disk->paths >= DISK_MAX_PATHS) {
+		cfg_strcpy(&errmsg, "Error - too many paths to disk");
+		return errmsg;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd == -1) {
+		cfg_strprintf(&errmsg, "Error opening disk - %s",
+		    strerror(errno));
+		return errmsg;
+	}
+
+	// the path has to lead to a disk of the same geometry
+	if (ioctl(fd, BLKSSZGET, &phy_block_size) ||
+	    ioctl(fd, BLKGETSIZE, &devsize) ||
+	    phy_block_size != disk->phy_block_size ||
+	    devsize / (phy_block_size / 512) != disk->phy_blocks) {
+		cfg_strprintf(&errmsg, "Error - '%s' is not a path to the "
+		    "boot disk", path);
+		close(fd);
+		return errmsg;
+	}
+	disk->path_fd[disk->paths++] = fd;
+
+	return NULL;
+}
+
+
+/**
+ * Parse the value of the \c readers parameter of a boot map URI.
+ *
+ * \param[in]  value  Parameter value.
+ * \return     Number of concurrent readers or -1 if invalid.
+ */
+
+int
+disk_parse_readers(const char *value)
+{
+	int readers;
+
+	if (!uri_is_number(value, 2))
+		return -1;
+	readers = atoi(value);
+	if (readers < 1 || readers > DISK_MAX_READERS)
+		return -1;
+
+	return readers;
+}
+
+
+/**
+ * Convert \p blockptr to the byte range it addresses on disk. \p blockptr
+ * format must match disk type. On success NULL is returned. On error a
+ * dynamically allocated error message is returned.
+ *
  * \param[in]  disk      Pointer to initialized disk structure
- * \param[out] buffer    Pointer to allocated memory buffer where blocks
- *                       will be stored
- * \param[in]  blockptr  Block address of 1st block to be read from disk
+ * \param[in]  blockptr  Block address of 1st block
+ * \param[out] offset    Byte offset of 1st block on disk
+ * \param[out] length    Number of bytes addressed
  * \return     In case of error dynamically allocated error message.
  */
 
-char *
-disk_read_phy_blocks(struct disk *disk, void *buffer,
-    disk_blockptr_t *blockptr)
+static char *
+disk_blockptr_range(struct disk *disk, disk_blockptr_t *blockptr,
+    off_t *offset, size_t *length)
 {
 	char *errmsg = NULL;
-	off_t offset;
-	ssize_t read_len, read_total, read_cnt = 0;
 
 	if (check_blockptr(disk, blockptr)) {
 		cfg_strcpy(&errmsg, "Error reading block from disk "
@@ -602,17 +682,17 @@ disk_read_phy_blocks(struct disk *disk, void *buffer,
 	case disk_type_scsi:
 	case disk_type_fba:
 	case disk_type_diag:
-		offset = blockptr->linear.block;
-		read_total = disk->phy_block_size *
+		*offset = blockptr->linear.block;
+		*length = disk->phy_block_size *
 			(blockptr->linear.blockct+1);
 		break;
 
 	case disk_type_eckd_classic:
 	case disk_type_eckd_compatible:
-		offset = blockptr->chs.sec + disk->geo.sectors *
+		*offset = blockptr->chs.sec + disk->geo.sectors *
 			(blockptr->chs.head +
 			    blockptr->chs.cyl*disk->geo.heads) - 1;
-		read_total = disk->phy_block_size * (blockptr->chs.blockct+1);
+		*length = disk->phy_block_size * (blockptr->chs.blockct+1);
 		break;
 
 	default:
@@ -620,23 +700,47 @@ disk_read_phy_blocks(struct disk *disk, void *buffer,
 		    "Invalid disk type for physical block read");
 		return errmsg;
 	}
+	*offset *= disk->phy_block_size;
 
-	offset *= disk->phy_block_size;
-	if (lseek(disk->fd, offset, SEEK_SET) == (off_t)-1) {
-		cfg_strprintf(&errmsg,
-		    "Error seeking physical block - %s",
-		    strerror(errno));
-		return errmsg;
-	}
-	while (read_cnt < read_total) {
-		read_len = read(disk->fd, buffer+read_cnt,
-		    read_total - read_cnt);
+	return NULL;
+}
+
+
+/**
+ * Read \p length bytes at byte \p offset from disk into memory. On
+ * success NULL is returned. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param[in]  disk    Pointer to initialized disk structure
+ * \param[out] buffer  Memory buffer of at least \p length bytes
+ * \param[in]  length  Number of bytes to read
+ * \param[in]  offset  Byte offset on disk
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+disk_read_bytes(struct disk *disk, void *buffer, size_t length, off_t offset)
+{
+	char *errmsg = NULL;
+	ssize_t read_len;
+	size_t read_cnt = 0;
+
+	while (read_cnt < length) {
+		read_len = pread(disk->fd, buffer+read_cnt,
+		    length - read_cnt, offset + read_cnt);
+		if (read_len == -1 && errno == EINTR)
+			continue;
 		if (read_len == -1) {
 			cfg_strprintf(&errmsg,
 			    "Error reading data from disk - %s",
 			    strerror(errno));
 			return errmsg;
 		}
+		if (read_len == 0) {
+			cfg_strcpy(&errmsg, "Error reading data from disk "
+			    "- unexpected end of device");
+			return errmsg;
+		}
 		read_cnt += read_len;
 	}
 
@@ -644,6 +748,34 @@ disk_read_phy_blocks(struct disk *disk, void *buffer,
 }
 
 
+/**
+ * Read physical blocks addressed by \p blockptr from disk into
+ * memory. \p blockptr format must match disk type. On success NULL is
+ * returned. On error a dynamically allocated error message is returned.
+ *
+ * \param[in]  disk      Pointer to initialized disk structure
+ * \param[out] buffer    Pointer to allocated memory buffer where blocks
+ *                       will be stored
+ * \param[in]  blockptr  Block address of 1st block to be read from disk
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+disk_read_phy_blocks(struct disk *disk, void *buffer,
+    disk_blockptr_t *blockptr)
+{
+	char *errmsg;
+	off_t offset;
+	size_t length;
+
+	errmsg = disk_blockptr_range(disk, blockptr, &offset, &length);
+	if (errmsg)
+		return errmsg;
+
+	return disk_read_bytes(disk, buffer, length, offset);
+}
+
+
 /**
  * Calculate maximum number of program entries in program table based
  * on disk type.
@@ -791,56 +923,336 @@ get_component_table(struct disk *disk, struct component **component_table,
 
 
 /**
- * Copy component from disk into memory. On success NULL is returned. On error
- * a dynamically allocated error message is returned.
+ * Destination of the code segments of a component. Small components are
+ * collected in memory, large ones are written to a file segment by
+ * segment as the segment tables are walked, so that they never have to
+ * fit into memory as a whole.
+ */
+
+struct component_sink {
+	int fd;                 //!< destination file, -1 to collect in memory
+	off_t offset;           //!< file position of next segment
+	off_t limit;            //!< number of bytes to store, -1 for all
+	off_t size;             //!< number of bytes stored so far
+	char *buffer;           //!< collected component or bounce buffer
+	int pipe[2];            //!< pipe to splice segments, -1 if unused
+	const char *name;       //!< component name for messages
+	volatile int *failed;   //!< set if a concurrent reader failed
+};
+
+
+/**
+ * Open the pipe used to splice code segments into the destination file
+ * of \p sink. Without a pipe segments are copied through the bounce
+ * buffer.
  *
- * \param[in]  disk       Pointer to initialized disk structure
- * \param[in]  component  Pointer to component to be loaded
- * \param[out] buffer     Dynamically allocated memory buffer with component
- * \return     In case of error dynamically allocated error message.
+ * \param[in,out] sink  Component sink writing to a file.
+ */
+
+static void
+sink_open_pipe(struct component_sink *sink)
+{
+	if (pipe2(sink->pipe, O_CLOEXEC) == 0)
+		fcntl(sink->pipe[1], F_SETPIPE_SZ, COMPONENT_PIPE_SIZE);
+	else
+		sink->pipe[0] = sink->pipe[1] = -1;
+}
+
+
+/**
+ * Release pipe and bounce buffer of \p sink.
+ *
+ * \param[in,out] sink  Component sink writing to a file.
+ */
+
+static void
+sink_release(struct component_sink *sink)
+{
+	if (sink->pipe[0] != -1) {
+		close(sink->pipe[0]);
+		close(sink->pipe[1]);
+		sink->pipe[0] = sink->pipe[1] = -1;
+	}
+	free(sink->buffer);
+	sink->buffer = NULL;
+}
+
+
+/**
+ * Write \p length bytes from the bounce buffer of \p sink to its
+ * destination file. On success NULL is returned. On error a dynamically
+ * allocated error message is returned.
  *
+ * \param[in,out] sink    Component sink writing to a file.
+ * \param[in]     length  Number of bytes in bounce buffer.
+ * \return        In case of error dynamically allocated error message.
  */
 
 static char *
-copy_component_to_memory(struct disk *disk, void **buffer,
-    int *buffer_size, disk_blockptr_t *component_ptr)
+sink_write_buffer(struct component_sink *sink, size_t length)
+{
+	char *errmsg = NULL;
+	ssize_t written;
+	size_t done = 0;
+
+	while (done < length) {
+		written = pwrite(sink->fd, sink->buffer + done, length - done,
+		    sink->offset);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written == -1) {
+			cfg_strprintf(&errmsg, "Error writing %s file - %s",
+			    sink->name, strerror(errno));
+			return errmsg;
+		}
+		done += written;
+		sink->offset += written;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Move \p length bytes from disk at byte \p offset to the destination
+ * file of \p sink through its pipe, without copying them to user space.
+ * If the kernel cannot splice from the disk or into the file, the pipe
+ * is closed and -1 is returned with \p errmsg unset, data already in the
+ * pipe is written from the bounce buffer.
+ *
+ * \param[in]     disk    Pointer to initialized disk structure
+ * \param[in,out] sink    Component sink writing to a file.
+ * \param[in]     offset  Byte offset on disk.
+ * \param[in]     length  Maximum number of bytes to move.
+ * \param[out]    errmsg  Dynamically allocated error message on error.
+ * \return        Number of bytes moved, -1 on error.
+ */
+
+static ssize_t
+sink_splice(struct disk *disk, struct component_sink *sink, off_t offset,
+    size_t length, char **errmsg)
+{
+	ssize_t in, out, moved = 0;
+
+	do
+		in = splice(disk->fd, &offset, sink->pipe[1], NULL, length,
+		    SPLICE_F_MOVE);
+	while (in == -1 && errno == EINTR);
+	if (in == 0) {
+		cfg_strcpy(errmsg, "Error reading data from disk "
+		    "- unexpected end of device");
+		return -1;
+	}
+	if (in == -1 && errno != EINVAL && errno != ENOSYS) {
+		cfg_strprintf(errmsg, "Error reading data from disk - %s",
+		    strerror(errno));
+		return -1;
+	}
+
+	while (in > 0 && moved < in) {
+		out = splice(sink->pipe[0], NULL, sink->fd, &sink->offset,
+		    in - moved, SPLICE_F_MOVE);
+		if (out == -1 && errno == EINTR)
+			continue;
+		if (out == -1 && errno != EINVAL && errno != ENOSYS) {
+			cfg_strprintf(errmsg, "Error writing %s file - %s",
+			    sink->name, strerror(errno));
+			return -1;
+		}
+		if (out == -1)
+			break;
+		moved += out;
+	}
+	if (in > 0 && moved == in)
+		return in;
+
+	// splice() not supported, drain the pipe and fall back to pread()
+	if (!sink->buffer) {
+		sink->buffer = malloc(COMPONENT_COPY_SIZE);
+		MEM_ASSERT(sink->buffer);
+	}
+	while (in > 0 && moved < in) {
+		out = read(sink->pipe[0], sink->buffer,
+		    in - moved < COMPONENT_COPY_SIZE ?
+		    in - moved : COMPONENT_COPY_SIZE);
+		if (out == -1 && errno == EINTR)
+			continue;
+		if (out <= 0) {
+			cfg_strprintf(errmsg, "Error reading pipe - %s",
+			    out ? strerror(errno) : "unexpected end of data");
+			return -1;
+		}
+		*errmsg = sink_write_buffer(sink, out);
+		if (*errmsg)
+			return -1;
+		moved += out;
+	}
+	close(sink->pipe[0]);
+	close(sink->pipe[1]);
+	sink->pipe[0] = sink->pipe[1] = -1;
+
+	return in > 0 ? in : -1;
+}
+
+
+/**
+ * Byte range on disk holding one or more adjacent code segments.
+ */
+
+struct disk_extent {
+	off_t offset;           //!< byte offset on disk
+	off_t length;           //!< number of bytes
+};
+
+
+/**
+ * Store \p length bytes at byte \p offset on disk in \p sink. On success
+ * NULL is returned. On error a dynamically allocated error message is
+ * returned.
+ *
+ * \param[in]     disk    Pointer to initialized disk structure
+ * \param[in,out] sink    Component sink.
+ * \param[in]     offset  Byte offset on disk.
+ * \param[in]     length  Number of bytes to store.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+sink_extent(struct disk *disk, struct component_sink *sink, off_t offset,
+    off_t length)
+{
+	char *errmsg = NULL;
+	ssize_t count;
+
+	if (sink->fd == -1) {
+		sink->buffer = realloc(sink->buffer, sink->size + length);
+		MEM_ASSERT(sink->buffer);
+		errmsg = disk_read_bytes(disk, sink->buffer + sink->size,
+		    length, offset);
+		if (!errmsg)
+			sink->size += length;
+		return errmsg;
+	}
+
+	while (length > 0) {
+		if (sink->failed && *sink->failed) {
+			cfg_strcpy(&errmsg, "Cancelled.");
+			return errmsg;
+		}
+		count = -1;
+		if (sink->pipe[0] != -1)
+			count = sink_splice(disk, sink, offset, length,
+			    &errmsg);
+		if (errmsg)
+			return errmsg;
+		if (count == -1) {
+			if (!sink->buffer) {
+				sink->buffer = malloc(COMPONENT_COPY_SIZE);
+				MEM_ASSERT(sink->buffer);
+			}
+			count = length < COMPONENT_COPY_SIZE ?
+				length : COMPONENT_COPY_SIZE;
+			errmsg = disk_read_bytes(disk, sink->buffer, count,
+			    offset);
+			if (!errmsg)
+				errmsg = sink_write_buffer(sink, count);
+			if (errmsg)
+				return errmsg;
+		}
+		offset += count;
+		length -= count;
+		sink->size += count;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Append the byte range of a code segment to a list of extents. A
+ * segment starting where the last extent ends extends that extent.
+ *
+ * \param[in,out] extents  Dynamically allocated list of extents.
+ * \param[in,out] count    Number of extents in \p extents.
+ * \param[in]     offset   Byte offset of code segment on disk.
+ * \param[in]     length   Number of bytes of code segment.
+ */
+
+static void
+add_extent(struct disk_extent **extents, int *count, off_t offset,
+    off_t length)
+{
+	struct disk_extent *last;
+
+	last = *count ? &(*extents)[*count-1] : NULL;
+	if (last && last->offset + last->length == offset) {
+		last->length += length;
+		return;
+	}
+	if ((*count & (*count - 1)) == 0) {
+		*extents = realloc(*extents, sizeof(**extents) *
+		    (*count ? *count * 2 : 1));
+		MEM_ASSERT(*extents);
+	}
+	(*extents)[*count].offset = offset;
+	(*extents)[*count].length = length;
+	(*count)++;
+}
+
+
+/**
+ * Walk through all segment tables of a component and collect the byte
+ * ranges of its code segments, merging adjacent segments. zipl usually
+ * writes components as long runs of adjacent blocks, so a component is
+ * described by few extents which can be read with large requests. Only
+ * one segment table is held in memory at a time. On success NULL is
+ * returned. On error a dynamically allocated error message is returned.
+ *
+ * \param[in]  disk           Pointer to initialized disk structure
+ * \param[in]  component_ptr  Block pointer to 1st segment table.
+ * \param[in]  limit          Number of bytes needed, -1 for all.
+ * \param[out] extents        Dynamically allocated list of extents.
+ * \param[out] count          Number of extents in \p extents.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+plan_component(struct disk *disk, disk_blockptr_t *component_ptr,
+    off_t limit, struct disk_extent **extents, int *count)
 {
 	char *errmsg, *segment_table;
-	int pointer_in_segment_table, load_position = 0, entry = 0;
+	int pointer_in_segment_table, entry = 0;
 	disk_blockptr_t code_ptr;
+	off_t offset, total = 0;
+	size_t length;
+
+	*extents = NULL;
+	*count = 0;
 
 	// read 1st segment table for component
 	segment_table = malloc(disk->phy_block_size*
 	    (get_blockptr_blockct(disk, component_ptr)+1));
 	MEM_ASSERT(segment_table);
 	errmsg = disk_read_phy_blocks(disk, segment_table, component_ptr);
-	if (errmsg) {
-		free(segment_table);
-		return errmsg;
-	}
+	if (errmsg)
+		goto out;
 	pointer_in_segment_table = disk->phy_block_size *
 		(get_blockptr_blockct(disk, component_ptr)+1) /
 		get_blockptr_size(disk);
 	read_packed_blockptr(disk, &code_ptr, segment_table);
 
-	// walk through all segment tables and load code segments
-	*buffer = NULL;
-	*buffer_size = 0;
+	// walk through all segment tables and collect code segments
 	do {
-		// load code segment
-		*buffer_size += disk->phy_block_size *
-			(get_blockptr_blockct(disk, &code_ptr)+1);
-		*buffer = realloc(*buffer, *buffer_size);
-		MEM_ASSERT(*buffer);
-		errmsg = disk_read_phy_blocks(disk, (*buffer)+load_position,
-		    &code_ptr);
-		if (errmsg) {
-			free(segment_table);
-			free(*buffer);
-			return errmsg;
-		}
-		load_position += disk->phy_block_size *
-			(get_blockptr_blockct(disk, &code_ptr)+1);
+		errmsg = disk_blockptr_range(disk, &code_ptr, &offset,
+		    &length);
+		if (errmsg)
+			goto out;
+		if (limit >= 0 && (off_t) length > limit - total)
+			length = limit - total;
+		add_extent(extents, count, offset, length);
+		total += length;
+		if (limit >= 0 && total >= limit)
+			break;
 		entry++;
 		read_packed_blockptr(disk, &code_ptr,
 		    segment_table + entry * get_blockptr_size(disk));
@@ -855,11 +1267,8 @@ copy_component_to_memory(struct disk *disk, void **buffer,
 			MEM_ASSERT(segment_table);
 			errmsg = disk_read_phy_blocks(disk, segment_table,
 			    &code_ptr);
-			if (errmsg) {
-				free(segment_table);
-				free(*buffer);
-				return errmsg;
-			}
+			if (errmsg)
+				goto out;
 			pointer_in_segment_table = disk->phy_block_size *
 				(get_blockptr_blockct(disk, &code_ptr)+1) /
 				get_blockptr_size(disk);
@@ -868,7 +1277,321 @@ copy_component_to_memory(struct disk *disk, void **buffer,
 		}
 	} while (!blockptr_is_null(disk, &code_ptr));
 
+ out:
 	free(segment_table);
+	if (errmsg) {
+		free(*extents);
+		*extents = NULL;
+		*count = 0;
+	}
+
+	return errmsg;
+}
+
+
+/**
+ * Reader copying a share of the extents of a component concurrently with
+ * other readers, through its own path to the disk.
+ */
+
+struct component_reader {
+	pthread_t thread;               //!< reader thread
+	int started;                    //!< thread has been created
+	struct disk disk;               //!< disk with the path of this reader
+	struct component_sink sink;     //!< sink with own pipe and buffer
+	struct disk_extent *extents;    //!< share of the extents
+	int count;                      //!< number of extents in share
+	char *errmsg;                   //!< error message of the reader
+};
+
+
+/**
+ * Store extents of a component in \p sink in order, after requesting
+ * readahead for all of them. On success NULL is returned. On error a
+ * dynamically allocated error message is returned.
+ *
+ * \param[in]     disk     Pointer to initialized disk structure
+ * \param[in,out] sink     Component sink.
+ * \param[in]     extents  Extents of the component.
+ * \param[in]     count    Number of extents.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+copy_extents(struct disk *disk, struct component_sink *sink,
+    struct disk_extent *extents, int count)
+{
+	char *errmsg = NULL;
+	int n;
+
+	posix_fadvise(disk->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	for (n = 0; n < count; n++)
+		posix_fadvise(disk->fd, extents[n].offset, extents[n].length,
+		    POSIX_FADV_WILLNEED);
+	for (n = 0; n < count && !errmsg; n++)
+		errmsg = sink_extent(disk, sink, extents[n].offset,
+		    extents[n].length);
+
+	return errmsg;
+}
+
+
+/**
+ * Thread function copying the share of one reader. A failing reader
+ * stops the others.
+ *
+ * \param[in,out] arg  Component reader.
+ * \return             Always \c NULL.
+ */
+
+static void *
+copy_extents_thread(void *arg)
+{
+	struct component_reader *reader = arg;
+
+	reader->errmsg = copy_extents(&reader->disk, &reader->sink,
+	    reader->extents, reader->count);
+	if (reader->errmsg)
+		*reader->sink.failed = 1;
+
+	return NULL;
+}
+
+
+/**
+ * Store extents of a component in the destination file of \p sink with
+ * up to \c disk->readers concurrent readers. The component is split into
+ * contiguous shares of the destination file, readers are assigned to the
+ * paths of the disk in turn and each reader writes its share at its own
+ * position. With HyperPAV aliases the concurrent requests on one DASD
+ * are served in parallel, with additional FCP paths each path carries a
+ * part of the requests. On success NULL is returned. On error a
+ * dynamically allocated error message is returned.
+ *
+ * \param[in]     disk     Pointer to initialized disk structure
+ * \param[in,out] sink     Component sink writing to a file.
+ * \param[in]     extents  Extents of the component.
+ * \param[in]     count    Number of extents.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+copy_extents_parallel(struct disk *disk, struct component_sink *sink,
+    struct disk_extent *extents, int count)
+{
+	struct component_reader *reader;
+	volatile int failed = 0;
+	off_t total = 0, share, start = 0, skip = 0, left, take;
+	int readers, path, n, r, i = 0, first = -1;
+	char *errmsg = NULL;
+
+	for (n = 0; n < count; n++)
+		total += extents[n].length;
+	readers = disk->readers < DISK_MAX_READERS ?
+		disk->readers : DISK_MAX_READERS;
+	share = (total + readers - 1) / readers;
+	share = (share + COMPONENT_SHARE_SIZE - 1) / COMPONENT_SHARE_SIZE *
+		COMPONENT_SHARE_SIZE;
+	readers = share ? (total + share - 1) / share : 0;
+	if (readers < 2)
+		return copy_extents(disk, sink, extents, count);
+
+	reader = calloc(readers, sizeof(*reader));
+	MEM_ASSERT(reader);
+	for (r = 0; r < readers; r++) {
+		path = r % (disk->paths + 1);
+		reader[r].disk = *disk;
+		if (path)
+			reader[r].disk.fd = disk->path_fd[path-1];
+		reader[r].sink.fd = sink->fd;
+		reader[r].sink.offset = sink->offset + start;
+		reader[r].sink.limit = -1;
+		reader[r].sink.name = sink->name;
+		reader[r].sink.failed = &failed;
+		sink_open_pipe(&reader[r].sink);
+
+		// take extents, splitting them at the end of the share
+		reader[r].extents = malloc(sizeof(*extents) * (count - i));
+		MEM_ASSERT(reader[r].extents);
+		for (left = share; left > 0 && i < count; left -= take) {
+			take = extents[i].length - skip;
+			if (take > left)
+				take = left;
+			n = reader[r].count++;
+			reader[r].extents[n].offset = extents[i].offset + skip;
+			reader[r].extents[n].length = take;
+			start += take;
+			skip += take;
+			if (skip == extents[i].length) {
+				i++;
+				skip = 0;
+			}
+		}
+	}
+	dg_printf(DG_VERBOSE, "bootmap: copying %s in %d shares over %d "
+	    "path(s)\n", sink->name, readers, disk->paths + 1);
+
+	for (r = 0; r < readers; r++) {
+		if (!pthread_create(&reader[r].thread, NULL,
+			copy_extents_thread, &reader[r]))
+			reader[r].started = 1;
+		else
+			copy_extents_thread(&reader[r]);
+	}
+	for (r = 0; r < readers; r++)
+		if (reader[r].started)
+			pthread_join(reader[r].thread, NULL);
+
+	// report the reader which caused the failure, not the ones it
+	// stopped
+	for (r = 0; r < readers; r++)
+		if (reader[r].errmsg && (first < 0 ||
+		    !strcmp(reader[first].errmsg, "Cancelled.")))
+			first = r;
+	for (r = 0; r < readers; r++) {
+		if (r == first)
+			errmsg = reader[r].errmsg;
+		else
+			cfg_strfree(&reader[r].errmsg);
+		sink_release(&reader[r].sink);
+		free(reader[r].extents);
+	}
+	free(reader);
+	if (!errmsg) {
+		sink->offset += total;
+		sink->size += total;
+	}
+
+	return errmsg;
+}
+
+
+/**
+ * Store a component in \p sink. The extents of the component are
+ * determined first, then they are transferred with as few requests as
+ * possible, by concurrent readers if the disk is configured for them.
+ * On success NULL is returned. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param[in]     disk           Pointer to initialized disk structure
+ * \param[in,out] sink           Component sink.
+ * \param[in]     component_ptr  Block pointer to 1st segment table.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+walk_component(struct disk *disk, struct component_sink *sink,
+    disk_blockptr_t *component_ptr)
+{
+	struct disk_extent *extents;
+	char *errmsg;
+	int count;
+
+	errmsg = plan_component(disk, component_ptr, sink->limit, &extents,
+	    &count);
+	if (errmsg)
+		return errmsg;
+	dg_printf(DG_VERBOSE, "bootmap: component in %d extent(s)\n", count);
+
+	if (sink->fd != -1 && disk->readers > 1)
+		errmsg = copy_extents_parallel(disk, sink, extents, count);
+	else
+		errmsg = copy_extents(disk, sink, extents, count);
+	free(extents);
+
+	return errmsg;
+}
+
+
+/**
+ * Copy component from disk into memory. Only used for small components
+ * like zipl's stage 3 parameters and the parmfile. On success NULL is
+ * returned. On error a dynamically allocated error message is returned.
+ *
+ * \param[in]  disk       Pointer to initialized disk structure
+ * \param[out] buffer     Dynamically allocated memory buffer with component
+ * \param[out] buffer_size  Size of component in bytes
+ * \param[in]  component_ptr  Block pointer to component to be loaded
+ * \return     In case of error dynamically allocated error message.
+ *
+ */
+
+static char *
+copy_component_to_memory(struct disk *disk, void **buffer,
+    int *buffer_size, disk_blockptr_t *component_ptr)
+{
+	struct component_sink sink = {
+		.fd = -1, .limit = -1, .pipe = { -1, -1 },
+	};
+	char *errmsg;
+
+	errmsg = walk_component(disk, &sink, component_ptr);
+	if (errmsg) {
+		free(sink.buffer);
+		return errmsg;
+	}
+	*buffer = sink.buffer;
+	*buffer_size = sink.size;
+
+	return NULL;
+}
+
+
+/**
+ * Copy component from disk to a file in the local filesystem. Code
+ * segments are written as they are read, spliced from the disk where the
+ * kernel supports it and through a small bounce buffer otherwise, so that
+ * memory usage does not depend on the size of the component. The first
+ * \p offset bytes of the file are zero. The file is removed on error. On
+ * success NULL is returned. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param[in]  disk           Pointer to initialized disk structure
+ * \param[in]  component_ptr  Block pointer to component to be loaded
+ * \param[in]  path           Pathname of the file to be written
+ * \param[in]  name           Name of the component for messages
+ * \param[in]  offset         Position of component in file
+ * \param[in]  limit          Number of bytes to copy, -1 for all
+ * \param[out] size           Number of bytes copied
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+copy_component_to_file(struct disk *disk, disk_blockptr_t *component_ptr,
+    const char *path, const char *name, off_t offset, off_t limit,
+    off_t *size)
+{
+	struct component_sink sink = {
+		.offset = offset, .limit = limit, .pipe = { -1, -1 },
+		.name = name,
+	};
+	char *errmsg = NULL;
+
+	sink.fd = creat(path, S_IRUSR | S_IWUSR);
+	if (sink.fd == -1) {
+		cfg_strprintf(&errmsg, "Error writing %s file - %s", name,
+		    strerror(errno));
+		return errmsg;
+	}
+	// the leading zero bytes are left as a hole
+	if (offset && ftruncate(sink.fd, offset)) {
+		cfg_strprintf(&errmsg, "Error writing %s file - %s", name,
+		    strerror(errno));
+		close(sink.fd);
+		unlink(path);
+		return errmsg;
+	}
+	sink_open_pipe(&sink);
+	errmsg = walk_component(disk, &sink, component_ptr);
+	sink_release(&sink);
+	if (close(sink.fd) && !errmsg)
+		cfg_strprintf(&errmsg, "Error writing %s file - %s", name,
+		    strerror(errno));
+	if (errmsg) {
+		unlink(path);
+		return errmsg;
+	}
+	*size = sink.size;
 
 	return NULL;
 }
@@ -967,51 +1690,11 @@ identify_boot_objects(struct disk *disk, struct component *component_table,
 static char *
 read_kernel_component(struct disk *disk, disk_blockptr_t *kernel)
 {
-	void *buffer;
-	char *errmsg = NULL;
-	int fd, n, buffer_size, zero = 0x0;
-
-	// open local kernel file and write kernel header because kernel header
-	// was removed by zipl
-	fd = creat(SYSLOAD_FILENAME_KERNEL, S_IRUSR | S_IWUSR);
-	if (fd == -1) {
-		cfg_strprintf(&errmsg, "Error writing kernel file - %s",
-		    strerror(errno));
-		return errmsg;
-	}
-	for (n = 0; n < KERNEL_HEADER_SIZE / sizeof(zero); n++) {
-		if (write(fd, &zero, sizeof zero) != sizeof(zero)) {
-			cfg_strprintf(&errmsg,
-			    "Error writing kernel file - %s", strerror(errno));
-			close(fd);
-			unlink(SYSLOAD_FILENAME_KERNEL);
-			return errmsg;
-		}
-	}
+	off_t size;
 
-	// write kernel image
-	errmsg = copy_component_to_memory(disk, &buffer, &buffer_size, kernel);
-	if (errmsg) {
-		close(fd);
-		return errmsg;
-	}
-	if (write(fd, buffer, buffer_size) != buffer_size) {
-		cfg_strprintf(&errmsg, "Error writing kernel file - %s",
-		    strerror(errno));
-		free(buffer);
-		close(fd);
-		unlink(SYSLOAD_FILENAME_KERNEL);
-		return errmsg;
-	}
-	free(buffer);
-	if (close(fd)) {
-		cfg_strprintf(&errmsg, "Error writing kernel file - %s",
-		    strerror(errno));
-		unlink(SYSLOAD_FILENAME_KERNEL);
-		return errmsg;
-	}
-
-	return NULL;
+	// kernel header was removed by zipl, it is written as zero bytes
+	return copy_component_to_file(disk, kernel, SYSLOAD_FILENAME_KERNEL,
+	    "kernel", KERNEL_HEADER_SIZE, -1, &size);
 }
 
 
@@ -1029,45 +1712,16 @@ static char *
 read_initrd_component(struct disk *disk, disk_blockptr_t *initrd,
     int initrd_len)
 {
-	void *buffer;
 	char *errmsg = NULL;
-	int fd, buffer_size;
+	off_t size;
 
-	// open local initrd file
-	fd = creat(SYSLOAD_FILENAME_INITRD, S_IRUSR | S_IWUSR);
-	if (fd == -1) {
-		cfg_strprintf(&errmsg, "Error writing initrd file - %s",
-		    strerror(errno));
-		return errmsg;
-	}
-
-	// write initrd image
-	errmsg = copy_component_to_memory(disk, &buffer, &buffer_size, initrd);
-	if (errmsg) {
-		close(fd);
-		unlink(SYSLOAD_FILENAME_INITRD);
+	errmsg = copy_component_to_file(disk, initrd, SYSLOAD_FILENAME_INITRD,
+	    "initrd", 0, initrd_len, &size);
+	if (errmsg)
 		return errmsg;
-	}
-	if (buffer_size < initrd_len) {
+	if (size < initrd_len) {
 		cfg_strcpy(&errmsg, "Error writing initrd file "
 		    "- invalid initrd component length");
-		free(buffer);
-		close(fd);
-		unlink(SYSLOAD_FILENAME_INITRD);
-		return errmsg;
-	}
-	if (write(fd, buffer, initrd_len) != initrd_len) {
-		cfg_strprintf(&errmsg, "Error writing initrd file - %s",
-		    strerror(errno));
-		free(buffer);
-		close(fd);
-		unlink(SYSLOAD_FILENAME_INITRD);
-		return errmsg;
-	}
-	free(buffer);
-	if (close(fd)) {
-		cfg_strprintf(&errmsg, "Error writing kernel file - %s",
-		    strerror(errno));
 		unlink(SYSLOAD_FILENAME_INITRD);
 		return errmsg;
 	}
@@ -1105,33 +1759,57 @@ read_parmfile_component(struct disk *disk, disk_blockptr_t *parmfile,
 }
 
 
+/**
+ * Start loading of parmfile specified in config file. The parmfile is
+ * loaded in the background while the boot objects are read from disk.
+ *
+ * \param[in]  boot  Pointer to cfg_bentry structure with boot information.
+ * \param[out] req   Component load request for parmfile.
+ * \return     Number of started requests.
+ */
+
+static int
+start_config_parmfile(struct cfg_bentry *boot, struct comp_request *req)
+{
+	if (!strlen(boot->parmfile))
+		return 0;
+
+	comp_request_init(req, "parmfile", SYSLOAD_FILENAME_PARMFILE,
+	    prefix_root(boot->root, boot->parmfile), 1);
+	set_timeouts(req, 1, boot);
+	comp_load_start(req, 1);
+
+	return 1;
+}
+
+
 /**
  * Prepare command line passed via config file's parmfile and cmdline
- * commands. On success NULL is returned. On error a dynamically allocated
- * error message is returned.
+ * commands. Waits for the parmfile request started by
+ * start_config_parmfile(). On success NULL is returned. On error a
+ * dynamically allocated error message is returned.
  *
  * \param[in]  boot    Pointer to cfg_bentry structure with boot information.
+ * \param[in]  req     Parmfile load request.
+ * \param[in]  count   Number of started requests.
  * \param[out] cmdline Dynamically allocated string with assembled command line
  * \return     In case of error dynamically allocated error message.
  *
  */
 
 static char *
-prepare_config_command_line(struct cfg_bentry *boot, char **cmdline)
+prepare_config_command_line(struct cfg_bentry *boot, struct comp_request *req,
+    int count, char **cmdline)
 {
-	char *errmsg = NULL, *tmp_uri, *tmp_msg;
-
-	if (strlen(boot->parmfile)) {
-		tmp_uri = prefix_root(boot->root, boot->parmfile);
-		if (comp_load(SYSLOAD_FILENAME_PARMFILE, tmp_uri, NULL,
-			&tmp_msg)) {
-			cfg_strprintf(&errmsg, "Error loading parmfile - %s",
-			    tmp_msg);
-			cfg_strfree(&tmp_msg);
-			cfg_strfree(&tmp_uri);
-			return errmsg;
-		}
-		cfg_strfree(&tmp_uri);
+	char *errmsg;
+
+	errmsg = comp_load_wait(req, count);
+	if (count)
+		comp_request_destroy(req);
+	if (errmsg)
+		return errmsg;
+
+	if (count) {
 		errmsg = compose_commandline(cmdline, SYSLOAD_FILENAME_PARMFILE,
 		    boot->cmdline);
 		if (errmsg)
@@ -1158,9 +1836,10 @@ char *
 boot_bootmap_disk(struct cfg_bentry *boot, struct disk *disk, int program)
 {
 	char *errmsg = NULL, *cmdline, *extra_cmdline;
-	int opt, initrd_len;
+	int opt, initrd_len, count;
 	disk_blockptr_t *program_table, kernel, initrd, parmfile;
 	struct component *component_table;
+	struct comp_request req;
 
 	// check program entry
 	if (program < 0 || program >= get_program_table_size(disk)) {
@@ -1194,25 +1873,27 @@ boot_bootmap_disk(struct cfg_bentry *boot, struct disk *disk, int program)
 		return errmsg;
 	}
 
-	// load boot objects
+	// load boot objects, parmfile from config file is loaded meanwhile
 	identify_boot_objects(disk, component_table, &kernel, &initrd,
 	    &initrd_len, &parmfile);
 	free(component_table);
+	count = start_config_parmfile(boot, &req);
 	errmsg = read_kernel_component(disk, &kernel);
 	if (errmsg)
-		return errmsg;
+		goto out_cancel;
 	if (!blockptr_is_null(disk, &initrd)) {
 		errmsg = read_initrd_component(disk, &initrd, initrd_len);
 		if (errmsg)
-			return errmsg;
+			goto out_cancel;
 	}
 	if (!blockptr_is_null(disk, &parmfile)) {
 		errmsg = read_parmfile_component(disk, &parmfile, &cmdline);
 		if (errmsg)
-			return errmsg;
+			goto out_cancel;
 	} else
 		cfg_strinit(&cmdline);
-	errmsg = prepare_config_command_line(boot, &extra_cmdline);
+	errmsg = prepare_config_command_line(boot, &req, count,
+	    &extra_cmdline);
 	if (errmsg) {
 		free(cmdline);
 		return errmsg;
@@ -1231,4 +1912,11 @@ boot_bootmap_disk(struct cfg_bentry *boot, struct disk *disk, int program)
 
 	// if we are still here, something went wrong
 	return errmsg;
+
+ out_cancel:
+	comp_load_cancel(&req, count);
+	free(comp_load_wait(&req, count));
+	if (count)
+		comp_request_destroy(&req);
+	return errmsg;
 }
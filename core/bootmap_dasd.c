@@ -15,44 +15,42 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
-#include <regex.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <ctype.h>
 #include "loader.h"
 #include "bootmap.h"
+#include "devwait.h"
+#include "uri.h"
 
 
-// definitions to extract URI fields
-#define URI_DASD_BOOTMAP_RE    "^dasd://\\(([[:xdigit:]])\\.([[:xdigit:]])" \
-	"\\.([[:xdigit:]]{4})(,([[:digit:]]{1,2}))?\\)$"
-#define URI_DASD_BOOTMAP_BUSID 1
-#define URI_DASD_BOOTMAP_PROG  5
-#define URI_DASD_BOOTMAP_MAX   7
-
 #define SYS_PATH_DASD                   "/sys/bus/ccw/devices"
 
 
 /**
- * Set DASD Channel device online and return device node. On success NULL
- * is returned. On error a dynamically allocated error message is returned.
+ * Set DASD Channel device online and return device node. The device is
+ * used as soon as its block device appears, waiting at most the device
+ * timeout. On success NULL is returned. On error a dynamically allocated
+ * error message is returned.
  *
  * \param[in]  busid  Bus ID of channel device to be set online
  * \param[out] dev    Dynamically allocated string with path to block device
  * \return     In case of error dynamically allocated error message.
  */
 
-static char *
+char *
 set_dasd_online(const char *busid, char **dev)
 {
 	char *errmsg = NULL, *syspath = NULL, *echo = NULL;
 	char nodestr[16], *pattern = NULL, block[50];
 	int fd, major = 0, minor = 0;
+	struct devwait wait;
 
 	// check if channel device exists
 	cfg_strprintf(&syspath, "%s/%s", SYS_PATH_DASD, busid);
@@ -64,10 +62,13 @@ set_dasd_online(const char *busid, char **dev)
 	}
 
 	// set channel device online
+	devwait_start(&wait);
 	cfg_strprintf(&echo, "%s/online", syspath);
-	if (echo_and_test(echo, "1", 100, echo) != 1) {
+	if (echo_and_test(echo, "1", 0, NULL) ||
+	    devwait_for_attr(&wait, echo, "1")) {
 		cfg_strprintf(&errmsg, "Error setting DASD '%s' online",
 		    busid);
+		devwait_end(&wait);
 		cfg_strfree(&syspath);
 		cfg_strfree(&echo);
 		return errmsg;
@@ -76,13 +77,15 @@ set_dasd_online(const char *busid, char **dev)
 
 	// create device node
 	cfg_strprintf(&pattern, "%s/block:*/dev", syspath);
-	if (cfg_glob_filename(pattern, block, sizeof(block)) != 1) {
+	if (devwait_for_glob(&wait, pattern, block, sizeof(block))) {
 		cfg_strprintf(&errmsg, "Error setting DASD '%s' online - "
 			"could not get block:* sysfs link", busid);
+		devwait_end(&wait);
 		cfg_strfree(&pattern);
 		cfg_strfree(&syspath);
 		return errmsg;
 	}
+	devwait_end(&wait);
 	cfg_strfree(&pattern);
 	cfg_strfree(&syspath);
 
@@ -122,7 +125,7 @@ set_dasd_online(const char *busid, char **dev)
  * \param[in]  busid  Bus ID of channel device to be set offline
  */
 
-static void
+void
 set_dasd_offline(const char *busid)
 {
 	char *echo = NULL, *dev = NULL;
@@ -140,6 +143,28 @@ set_dasd_offline(const char *busid)
 }
 
 
+/**
+ * Check whether a DASD channel device is online.
+ *
+ * \param[in]  busid  Bus ID of channel device
+ * \return     Non-zero if the device is online.
+ */
+
+int
+dasd_is_online(const char *busid)
+{
+	char *path = NULL, online[4];
+	int ret;
+
+	cfg_strprintf(&path, "%s/%s/online", SYS_PATH_DASD, busid);
+	ret = read_file(path, online, sizeof(online)) > 0 &&
+	    !strcmp(online, "1");
+	cfg_strfree(&path);
+
+	return ret;
+}
+
+
 /**
  * Read DASD boot record and update program table pointer. On success NULL is
  * returned. On error a dynamically allocated error message is returned.
@@ -174,6 +199,38 @@ disk_read_dasd_boot_record(struct disk *disk)
 }
 
 
+/**
+ * Parse the query of a DASD boot map URI: \c readers=<n> sets the number
+ * of concurrent readers of a component, which lets HyperPAV aliases of
+ * the DASD serve several requests at a time.
+ *
+ * \param[in,out] query    Query of the URI, modified.
+ * \param[out]    readers  Number of concurrent readers.
+ * \return        Zero on success, non-zero if the query is invalid.
+ */
+
+static int
+parse_dasd_query(char *query, int *readers)
+{
+	char *param, *save;
+
+	*readers = 1;
+	if (!query)
+		return 0;
+	for (param = strtok_r(query, "&", &save); param;
+	     param = strtok_r(NULL, "&", &save)) {
+		if (strncmp(param, "readers=", 8) == 0)
+			*readers = disk_parse_readers(param + 8);
+		else
+			return -1;
+		if (*readers < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+
 /**
  * Handle bootmap boot from DASD devices. On error a dynamically allocated
  * error message is returned.
@@ -185,37 +242,31 @@ disk_read_dasd_boot_record(struct disk *disk)
 char *
 action_bootmap_boot_dasd(struct cfg_bentry *boot)
 {
-	char *errmsg = NULL, tmp_buffer[64], busid[16], *dev;
-	int ret, n, program = 0;
-	regex_t preg;
-	regmatch_t pmatch[URI_DASD_BOOTMAP_MAX];
+	char *errmsg = NULL, busid[16], *dev;
+	int program = 0, readers;
+	struct uri uri;
 	struct disk disk;
 
-	// compile regular expression
-	if ((ret = regcomp(&preg, URI_DASD_BOOTMAP_RE, REG_EXTENDED))) {
-		regerror(ret, &preg, tmp_buffer, sizeof(tmp_buffer));
-		cfg_strprintf(&errmsg, "Internal error: unable to compile "
-		    "regular expression - %s", tmp_buffer);
+	// extract fields: dasd://(<bus id>[,<program>])[?readers=<n>]
+	if (uri_parse(&uri, boot->bootmap)) {
+		cfg_strcpy(&errmsg,
+		    "Error - invalid 'dasd' boot map URI.");
 		return errmsg;
 	}
-
-	// match URI & extract fields
-	ret = regexec(&preg, boot->bootmap, URI_DASD_BOOTMAP_MAX, pmatch, 0);
-	if (ret) {
-		regfree(&preg);
+	if (strcmp(uri.scheme, "dasd") || uri.args < 1 || uri.args > 2 ||
+	    strlen(uri.path) || uri.fragment ||
+	    !uri_is_busid(uri.busid) || (uri.args == 2 &&
+	    (!strlen(uri.arg[1]) || !uri_is_number(uri.arg[1], 2))) ||
+	    parse_dasd_query(uri.query, &readers)) {
+		uri_free(&uri);
 		cfg_strcpy(&errmsg,
 		    "Error - invalid 'dasd' boot map URI.");
 		return errmsg;
 	}
-	strncpy(busid, boot->bootmap + pmatch[URI_DASD_BOOTMAP_BUSID].rm_so,
-	    8);
-	busid[8] = '\0';
-	for (n = 0; n < strlen(busid); n++)
-		busid[n] = tolower(busid[n]);
-	if (pmatch[URI_DASD_BOOTMAP_PROG].rm_so != -1)
-		sscanf(boot->bootmap+pmatch[URI_DASD_BOOTMAP_PROG].rm_so,
-		    "%i", &program);
-	regfree(&preg);
+	strcpy(busid, uri.busid);
+	if (uri.args == 2)
+		program = atoi(uri.arg[1]);
+	uri_free(&uri);
 
 	// set DASD online and boot
 	errmsg = set_dasd_online(busid, &dev);
@@ -225,6 +276,7 @@ action_bootmap_boot_dasd(struct cfg_bentry *boot)
 	cfg_strfree(&dev);
 	if (errmsg)
 		return errmsg;
+	disk.readers = readers;
 	errmsg = boot_bootmap_disk(boot, &disk, program);
 
 	// if we are still here boot failed
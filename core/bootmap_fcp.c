@@ -15,101 +15,63 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
 #include <time.h>
-#include <regex.h>
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include "debug.h"
 #include "loader.h"
 #include "bootmap.h"
+#include "devwait.h"
+#include "scsi_index.h"
+#include "uri.h"
 
 
-// definitions to extract URI fields
-#define URI_ZFCP_BOOTMAP_RE    "^zfcp://\\(([[:xdigit:]])\\.([[:xdigit:]])" \
-	"\\.([[:xdigit:]]{4}),(0x[[:xdigit:]]{16}),(0x[[:xdigit:]]{16})" \
-	"(,([[:digit:]]{1,2}))?\\)$"
-#define URI_ZFCP_BOOTMAP_BUSID 1
-#define URI_ZFCP_BOOTMAP_WWPN  4
-#define URI_ZFCP_BOOTMAP_LUN   5
-#define URI_ZFCP_BOOTMAP_PROG  7
-#define URI_ZFCP_BOOTMAP_MAX   9
-
 #define SYS_PATH_FCP                    "/sys/bus/ccw/drivers/zfcp"
 #define SYS_PATH_SCSI                   "/sys/bus/scsi/devices"
 
 
 /**
- * Find FCP SCSI device identified by bus ID, WWPN and LUN and return host
- * number, channel, SCSI ID and SCSI LUN.
- *
- * \param[in]  busid    Bus ID of the FCP channel through which the SCSI
- *                      device is attached
- * \param[in]  wwpn     WWPN through which the SCSI device is accessed
- * \param[in]  lun      LUN of the SCSI device
- * \param[out] host     Host number of FCP SCSI device
- * \param[out] channel  Channel of FCP SCSI device
- * \param[out] scsi_id  SCSI ID of FCP SCSI device
- * \param[out] scsi_lun SCSI LUN of FCP SCSI device
- * \return              If FCP SCSI device was found 0, otherwise -1.
- *
+ * Address of an FCP SCSI device which is waited for.
  */
 
-static int
-find_scsi_device(const char *busid, const char *wwpn, const char *lun,
-    int *host, int *channel, int *scsi_id, int *scsi_lun)
-{
-	char *path = NULL, tmpstr[20];
-	int ret = -1;
-	DIR *dir;
-	struct dirent *dirent;
-
-	dir = opendir(SYS_PATH_SCSI);
-	if (dir == NULL)
-		return -1;
-	while ((dirent = readdir(dir)) != NULL) {
-		if (strcmp(dirent->d_name, ".") == 0 ||
-		    strcmp(dirent->d_name, "..") == 0 )
-			continue;
-
-		cfg_strprintf(&path, "%s/%s/hba_id", SYS_PATH_SCSI,
-		    dirent->d_name);
-		if (read_file(path, tmpstr, sizeof(tmpstr)) == -1 ||
-		    strcmp(busid, tmpstr) !=0 )
-			continue;
+struct scsi_address {
+	const char *busid;      //!< bus ID of FCP channel
+	const char *wwpn;       //!< WWPN of target port
+	const char *lun;        //!< LUN of SCSI device
+};
 
-		cfg_strprintf(&path, "%s/%s/wwpn", SYS_PATH_SCSI,
-		    dirent->d_name);
-		if (read_file(path, tmpstr, sizeof(tmpstr)) == -1 ||
-		    strcmp(wwpn, tmpstr) !=0 )
-			continue;
 
-		cfg_strprintf(&path, "%s/%s/fcp_lun", SYS_PATH_SCSI,
-		    dirent->d_name);
-		if (read_file(path, tmpstr, sizeof(tmpstr)) == -1 ||
-		    strcmp(lun, tmpstr) !=0 )
-			continue;
+/**
+ * Check whether the SCSI device of an FCP LUN and its block device exist.
+ *
+ * \param[in] arg  Pointer to struct scsi_address.
+ * \return         Non-zero if the block device was found.
+ */
 
-		if (sscanf(dirent->d_name, "%i:%i:%i:%i", host, channel,
-			scsi_id, scsi_lun) == 4) {
-			ret = 0;
-			break;
-		}
-	}
-	cfg_strfree(&path);
-	closedir(dir);
+static int
+scsi_device_ready(const void *arg)
+{
+	const struct scsi_address *addr = arg;
+	struct scsi_entry entry;
 
-	return ret;
+	return !scsi_index_lookup(addr->busid, addr->wwpn, addr->lun,
+	    &entry) && entry.major != 0;
 }
 
 
 /**
- * Set FCP attached SCSI disk online and return device node. On success NULL
- * is returned. On error a dynamically allocated error message is returned.
+ * Set FCP attached SCSI disk online and return device node. Each step
+ * ends as soon as the kernel has completed it and the disk is used as
+ * soon as its block device appears, waiting at most the device timeout
+ * in total. On success NULL is returned. On error a dynamically
+ * allocated error message is returned.
  *
  * \param[in]  busid  Bus ID of the FCP channel through which the SCSI disk
  *                    is attached
@@ -119,13 +81,14 @@ find_scsi_device(const char *busid, const char *wwpn, const char *lun,
  * \return     In case of error dynamically allocated error message.
  */
 
-static char *
+char *
 set_fcp_disk_online(const char *busid, const char *wwpn, const char *lun,
     char **dev)
 {
-	char *errmsg = NULL, *syspath = NULL, *echo = NULL;
-	char *test = NULL, *pattern = NULL, block[50], nodestr[16];
-	int fd, host, channel, scsi_id, scsi_lun, major = 0, minor = 0;
+	char *errmsg = NULL, *syspath = NULL, *echo = NULL, *test = NULL;
+	struct scsi_address addr = { busid, wwpn, lun };
+	struct scsi_entry entry;
+	struct devwait wait;
 
 	// check if FCP channel exists
 	cfg_strprintf(&syspath, "%s/%s", SYS_PATH_FCP, busid);
@@ -137,10 +100,13 @@ set_fcp_disk_online(const char *busid, const char *wwpn, const char *lun,
 	}
 
 	// set FCP channel online
+	devwait_start(&wait);
 	cfg_strprintf(&echo, "%s/online", syspath);
-	if (echo_and_test(echo, "1", 200, echo) != 1) {
+	if (echo_and_test(echo, "1", 0, NULL) ||
+	    devwait_for_attr(&wait, echo, "1")) {
 		cfg_strprintf(&errmsg,
 		    "Error setting FCP channel '%s' online", busid);
+		devwait_end(&wait);
 		cfg_strfree(&syspath);
 		cfg_strfree(&echo);
 		return errmsg;
@@ -151,10 +117,12 @@ set_fcp_disk_online(const char *busid, const char *wwpn, const char *lun,
 	if (access(test, F_OK)) {
 		cfg_strprintf(&echo, "%s/port_add", syspath);
 		cfg_strprintf(&test, "%s/%s/failed", syspath, wwpn);
-		if (echo_and_test(echo, wwpn, 200, test) != 0) {
+		if (echo_and_test(echo, wwpn, 0, NULL) ||
+		    devwait_for_attr(&wait, test, "0")) {
 			cfg_strprintf(&errmsg,
 			    "Error configuring WWPN '%s' on FCP channel '%s'",
 			    wwpn, busid);
+			devwait_end(&wait);
 			cfg_strfree(&syspath);
 			cfg_strfree(&echo);
 			cfg_strfree(&test);
@@ -167,10 +135,12 @@ set_fcp_disk_online(const char *busid, const char *wwpn, const char *lun,
 	if (access(test, F_OK)) {
 		cfg_strprintf(&echo, "%s/%s/unit_add", syspath, wwpn);
 		cfg_strprintf(&test, "%s/%s/%s/failed", syspath, wwpn, lun);
-		if (echo_and_test(echo, lun, 200, test) != 0) {
+		if (echo_and_test(echo, lun, 0, NULL) ||
+		    devwait_for_attr(&wait, test, "0")) {
 			cfg_strprintf(&errmsg,
 			    "Error configuring LUN '%s' on WWPN '%s' on FCP "
 			    "channel '%s'", lun, wwpn, busid);
+			devwait_end(&wait);
 			cfg_strfree(&syspath);
 			cfg_strfree(&echo);
 			cfg_strfree(&test);
@@ -182,44 +152,19 @@ set_fcp_disk_online(const char *busid, const char *wwpn, const char *lun,
 	cfg_strfree(&test);
 
 	// create device node
-	if (find_scsi_device(busid, wwpn, lun, &host, &channel,
-		&scsi_id, &scsi_lun)) {
+	if (devwait_until(&wait, scsi_device_ready, &addr) ||
+	    scsi_index_lookup(busid, wwpn, lun, &entry)) {
 		cfg_strprintf(&errmsg, "Error getting device node information"
 		    " for FCP disk %s:%s:%s", busid, wwpn, lun);
+		devwait_end(&wait);
 		return errmsg;
 	}
+	devwait_end(&wait);
 
-	cfg_strprintf(&pattern, "%s/%i:%i:%i:%i/block:*/dev", SYS_PATH_SCSI,
-		      host, channel, scsi_id, scsi_lun);
-	if (cfg_glob_filename(pattern, block, sizeof(block)) != 1) {
-		cfg_strprintf(&errmsg, "Error getting device node information"
-			" for FCP disk %s:%s:%s - could not get block:* "
-			"sysfs link", busid, wwpn, lun);
-		cfg_strfree(&pattern);
-		return errmsg;
-	}
-	cfg_strfree(&pattern);
-
-	fd = open(block, O_RDONLY);
-	if (fd == -1) {
-		cfg_strprintf(&errmsg, "Error getting device node information"
-		    " for FCP disk %s:%s:%s - %s", busid, wwpn, lun,
-		    strerror(errno));
-		return errmsg;
-	}
-	memset(nodestr, 0x0, sizeof(nodestr));
-	cfg_read(fd, nodestr, sizeof(nodestr)-1);
-	close(fd);
-	if (sscanf(nodestr, "%i:%i", &major, &minor) != 2) {
-		cfg_strprintf(&errmsg,
-		    "Error getting device node information for "
-		    "FCP disk %s:%s:%s", busid, wwpn, lun);
-		return errmsg;
-	}
 	cfg_strinit(dev);
 	cfg_strprintf(dev, "%s/b%s:%s:%s", BLOCKDEV_PATH, busid, wwpn, lun);
 	unlink(*dev);
-	if (mknod(*dev, 0660 | S_IFBLK, makedev(major, minor))) {
+	if (mknod(*dev, 0660 | S_IFBLK, makedev(entry.major, entry.minor))) {
 		cfg_strprintf(&errmsg,
 		    "Error creating device node for FCP disk "
 		    "%s:%s:%s - %s",
@@ -246,13 +191,12 @@ static int
 delete_scsi_device(const char *busid, const char *wwpn, const char *lun)
 {
 	char *echo = NULL;
-	int host, scsi_id, channel, scsi_lun, ret;
+	struct scsi_entry entry;
+	int ret;
 
-	if (find_scsi_device(busid, wwpn, lun, &host, &channel, &scsi_id,
-		&scsi_lun))
+	if (scsi_index_lookup(busid, wwpn, lun, &entry))
 		return -1;
-	cfg_strprintf(&echo, "%s/%i:%i:%i:%i/delete", SYS_PATH_SCSI, host,
-	    channel, scsi_id, scsi_lun);
+	cfg_strprintf(&echo, "%s/%s/delete", SYS_PATH_SCSI, entry.hctl);
 	ret = echo_and_test(echo, "1", 0, NULL);
 	cfg_strfree(&echo);
 	return ret;
@@ -269,7 +213,7 @@ delete_scsi_device(const char *busid, const char *wwpn, const char *lun)
  * \return     If FCP SCSI disk was set offline 0, otherwise -1.
  */
 
-static int
+int
 set_fcp_disk_offline(const char *busid, const char *wwpn, const char *lun)
 {
 	char *path = NULL;
@@ -305,6 +249,29 @@ set_fcp_disk_offline(const char *busid, const char *wwpn, const char *lun)
 }
 
 
+/**
+ * Check whether a LUN is configured on an FCP channel.
+ *
+ * \param[in]  busid  Bus ID of the FCP channel
+ * \param[in]  wwpn   WWPN through which the SCSI disk is accessed
+ * \param[in]  lun    LUN of the SCSI disk
+ * \return     Non-zero if the LUN is configured.
+ */
+
+int
+fcp_disk_is_online(const char *busid, const char *wwpn, const char *lun)
+{
+	char *path = NULL;
+	int ret;
+
+	cfg_strprintf(&path, "%s/%s/%s/%s", SYS_PATH_FCP, busid, wwpn, lun);
+	ret = !access(path, F_OK);
+	cfg_strfree(&path);
+
+	return ret;
+}
+
+
 /**
  * Read SCSI MBR and update program table pointer. On success NULL is
  * returned. On error a dynamically allocated error message is returned.
@@ -353,6 +320,68 @@ disk_read_scsi_mbr(struct disk *disk)
 }
 
 
+/**
+ * Additional path to an FCP SCSI disk.
+ */
+
+struct fcp_path {
+	char busid[16];                 //!< bus ID of FCP channel
+	char wwpn[20];                  //!< WWPN of target port
+};
+
+
+/**
+ * Parse the query of a zfcp boot map URI. Each \c path=<bus id>,<WWPN>
+ * parameter names another path to the same LUN, \c readers=<n> sets the
+ * number of concurrent readers of a component, by default one per path.
+ *
+ * \param[in,out] query    Query of the URI, modified.
+ * \param[out]    path     Array of #DISK_MAX_PATHS additional paths.
+ * \param[out]    paths    Number of additional paths.
+ * \param[out]    readers  Number of concurrent readers.
+ * \return        Zero on success, non-zero if the query is invalid.
+ */
+
+static int
+parse_zfcp_query(char *query, struct fcp_path *path, int *paths,
+    int *readers)
+{
+	char *param, *save, *wwpn;
+
+	*paths = 0;
+	*readers = 0;
+	for (param = query ? strtok_r(query, "&", &save) : NULL; param;
+	     param = strtok_r(NULL, "&", &save)) {
+		if (strncmp(param, "readers=", 8) == 0) {
+			*readers = disk_parse_readers(param + 8);
+			if (*readers < 0)
+				return -1;
+			continue;
+		}
+		if (strncmp(param, "path=", 5) || *paths >= DISK_MAX_PATHS)
+			return -1;
+		wwpn = strchr(param + 5, ',');
+		if (!wwpn)
+			return -1;
+		*wwpn++ = '\0';
+		if (!uri_is_busid(param + 5) || !uri_is_fcp_address(wwpn) ||
+		    strlen(param + 5) >= sizeof(path->busid) ||
+		    strlen(wwpn) >= sizeof(path->wwpn))
+			return -1;
+		strcpy(path[*paths].busid, param + 5);
+		strcpy(path[*paths].wwpn, wwpn);
+		// like the address in the authority, see uri_parse()
+		uri_lower(path[*paths].busid);
+		uri_lower(path[*paths].wwpn);
+		(*paths)++;
+	}
+	if (!*readers)
+		*readers = *paths + 1;
+
+	return 0;
+}
+
+
 /**
  * Handle bootmap boot from FCP SCSI disk devices. On error a dynamically
  * allocated error message is returned.
@@ -364,47 +393,37 @@ disk_read_scsi_mbr(struct disk *disk)
 char *
 action_bootmap_boot_zfcp(struct cfg_bentry *boot)
 {
-	char *errmsg = NULL, tmp_buffer[64], busid[16], wwpn[20];
-	char lun[20], *dev;
-	int ret, n, program = 0;
-	regex_t preg;
-	regmatch_t pmatch[URI_ZFCP_BOOTMAP_MAX];
+	char *errmsg = NULL, busid[16], wwpn[20];
+	char lun[20], *dev, *tmp_msg;
+	int program = 0, paths, readers, n;
+	struct fcp_path path[DISK_MAX_PATHS];
+	struct uri uri;
 	struct disk disk;
 
-	// compile regular expression
-	if ((ret = regcomp(&preg, URI_ZFCP_BOOTMAP_RE, REG_EXTENDED))) {
-		regerror(ret, &preg, tmp_buffer, sizeof(tmp_buffer));
-		cfg_strprintf(&errmsg,
-		    "Internal error: unable to compile regular "
-		    "expression - %s", tmp_buffer);
+	// extract fields: zfcp://(<bus id>,<WWPN>,<LUN>[,<program>])
+	// [?path=<bus id>,<WWPN>&...&readers=<n>]
+	if (uri_parse(&uri, boot->bootmap)) {
+		cfg_strcpy(&errmsg,
+		    "Error - invalid 'zfcp' boot map URI.");
 		return errmsg;
 	}
-
-	// match URI & extract fields
-	ret = regexec(&preg, boot->bootmap, URI_ZFCP_BOOTMAP_MAX, pmatch, 0);
-	if (ret) {
-		regfree(&preg);
+	if (strcmp(uri.scheme, "zfcp") || uri.args < 3 || uri.args > 4 ||
+	    strlen(uri.path) || uri.fragment ||
+	    !uri_is_busid(uri.busid) || !uri_is_fcp_address(uri.wwpn) ||
+	    !uri_is_fcp_address(uri.lun) || (uri.args == 4 &&
+	    (!strlen(uri.arg[3]) || !uri_is_number(uri.arg[3], 2))) ||
+	    parse_zfcp_query(uri.query, path, &paths, &readers)) {
+		uri_free(&uri);
 		cfg_strcpy(&errmsg,
 		    "Error - invalid 'zfcp' boot map URI.");
 		return errmsg;
 	}
-	strncpy(busid, boot->bootmap + pmatch[URI_ZFCP_BOOTMAP_BUSID].rm_so,
-	    8);
-	busid[8] = '\0';
-	for (n = 0; n < strlen(busid); n++)
-		busid[n] = tolower(busid[n]);
-	strncpy(wwpn, boot->bootmap + pmatch[URI_ZFCP_BOOTMAP_WWPN].rm_so, 18);
-	wwpn[18] = '\0';
-	for (n = 0; n < strlen(wwpn); n++)
-		wwpn[n] = tolower(wwpn[n]);
-	strncpy(lun, boot->bootmap + pmatch[URI_ZFCP_BOOTMAP_LUN].rm_so, 18);
-	lun[18] = '\0';
-	for (n = 0; n < strlen(lun); n++)
-		lun[n] = tolower(lun[n]);
-	if (pmatch[URI_ZFCP_BOOTMAP_PROG].rm_so != -1)
-		sscanf(boot->bootmap+pmatch[URI_ZFCP_BOOTMAP_PROG].rm_so,
-		    "%i", &program);
-	regfree(&preg);
+	strcpy(busid, uri.busid);
+	strcpy(wwpn, uri.wwpn);
+	strcpy(lun, uri.lun);
+	if (uri.args == 4)
+		program = atoi(uri.arg[3]);
+	uri_free(&uri);
 
 	// set FCP disk online and boot
 	errmsg = set_fcp_disk_online(busid, wwpn, lun, &dev);
@@ -414,10 +433,29 @@ action_bootmap_boot_zfcp(struct cfg_bentry *boot)
 	cfg_strfree(&dev);
 	if (errmsg)
 		return errmsg;
+
+	// additional paths are optional, the disk is read through the
+	// paths which could be set online
+	for (n = 0; n < paths; n++) {
+		tmp_msg = set_fcp_disk_online(path[n].busid, path[n].wwpn,
+		    lun, &dev);
+		if (!tmp_msg) {
+			tmp_msg = disk_add_path(&disk, dev);
+			cfg_strfree(&dev);
+		}
+		if (tmp_msg) {
+			dg_printf(DG_VERBOSE, "bootmap: skipping path %s,%s - "
+			    "%s\n", path[n].busid, path[n].wwpn, tmp_msg);
+			cfg_strfree(&tmp_msg);
+		}
+	}
+	disk.readers = readers;
 	errmsg = boot_bootmap_disk(boot, &disk, program);
 
 	// if we are still here boot failed
 	disk_close(&disk);
+	for (n = 0; n < paths; n++)
+		set_fcp_disk_offline(path[n].busid, path[n].wwpn, lun);
 	set_fcp_disk_offline(busid, wwpn, lun);
 
 	return errmsg;
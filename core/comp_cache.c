@@ -0,0 +1,817 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_cache.c
+ * \brief Cache for components loaded by the component loader
+ *
+ * The cache has two tiers. The memory tier keeps loaded components as
+ * hard links in #CC_CACHE_DIR which is located on the in-memory root
+ * filesystem. Entries are keyed by URI plus a validator reported by
+ * the loader plugin (e.g. size and modification time or an entity
+ * tag), so a changed source is never served from the cache. When the
+ * memory budget is exceeded the least recently used entries are
+ * removed.
+ *
+ * The optional disk tier is a directory on a local block device which
+ * is mounted on first use. It keeps one copy per URI together with its
+ * validator and survives reboots. Copies are revalidated against the
+ * validator of the source and used without validation if the source
+ * cannot be loaded at all.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <utime.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "config.h"
+#include "debug.h"
+#include "comp_cache.h"
+
+#define CC_MAX_ENTRIES 64    //!< maximum number of cached components
+#define CC_MAX_DISK_ENTRIES 1024 //!< maximum number of files on disk
+#define CC_DISK_TEMP ".tmp."    //!< infix of temporary files on disk
+
+
+/**
+ * This structure describes one cached component.
+ */
+
+struct cc_entry {
+	char *key;                  //!< URI and validator
+	char *path;                 //!< pathname of cached copy
+	long long size;             //!< size of cached copy
+	unsigned long last_use;     //!< LRU stamp
+};
+
+
+/**
+ * This structure describes one file of the disk tier during eviction.
+ */
+
+struct cc_disk_entry {
+	char name[32];              //!< filename without suffix
+	long long size;             //!< size of cached copy
+	time_t last_use;            //!< modification time used as LRU stamp
+};
+
+static struct cc_entry cc_entries[CC_MAX_ENTRIES];
+static int cc_count = 0;
+static long long cc_memory = 0;         //!< memory budget in bytes
+static long long cc_used = 0;           //!< bytes used by cached copies
+static unsigned long cc_clock = 0;      //!< LRU clock
+static char *cc_disk = NULL;            //!< disk tier block device
+static char *cc_fstype = NULL;          //!< disk tier filesystem type
+static long long cc_disk_size = 0;      //!< disk budget in bytes
+static int cc_disk_mounted = 0;         //!< disk tier is mounted
+static pthread_mutex_t cc_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Create and initialize a cc_conf structure.
+ *
+ * \return Pointer to cc_conf structure created and initialized.
+ */
+
+struct cc_conf *cc_conf_new()
+{
+	struct cc_conf *conf_to_init = NULL;
+
+	conf_to_init = malloc(sizeof(*conf_to_init));
+	MEM_ASSERT(conf_to_init);
+
+	cc_conf_init(conf_to_init);
+	return(conf_to_init);
+}
+
+
+/**
+ * Initialize a cc_conf structure (cache disabled).
+ *
+ * \param[in] cacheconf Pointer to cc_conf structure to be initialized.
+ */
+
+void cc_conf_init(struct cc_conf *cacheconf)
+{
+	cacheconf->memory = 0;
+	cacheconf->size = 0;
+	cfg_strinit(&cacheconf->disk);
+	cfg_strinit(&cacheconf->fstype);
+}
+
+
+/**
+ * Destroy a cc_conf structure and free all alocated memory.
+ *
+ * \param[in] cacheconf Pointer to cc_conf structure to be destroyed.
+ */
+
+void cc_conf_destroy(struct cc_conf *cacheconf)
+{
+	cfg_strfree(&cacheconf->disk);
+	cfg_strfree(&cacheconf->fstype);
+}
+
+
+/**
+ * Destroy and re-initialize a cc_conf structure.
+ *
+ * \param[in] cacheconf Pointer to structure to be destroyed/re-initialized.
+ */
+
+void cc_conf_reset(struct cc_conf *cacheconf)
+{
+	cc_conf_destroy(cacheconf);
+	cc_conf_init(cacheconf);
+}
+
+
+/**
+ * Free a dynamically allocated cc_conf structure and assign \p NULL.
+ *
+ * \param[in] cacheconf Pointer to cc_conf structure to be freed.
+ */
+
+void cc_conf_free(struct cc_conf **cacheconf)
+{
+	if (*cacheconf == NULL) return;
+	free(*cacheconf);
+	*cacheconf = NULL;
+}
+
+
+/**
+ * Remove cache entry. Must be called with \p cc_lock held.
+ *
+ * \param[in] n  Index of entry to be removed.
+ */
+
+static void cc_remove(int n)
+{
+	unlink(cc_entries[n].path);
+	cc_used -= cc_entries[n].size;
+	cfg_strfree(&cc_entries[n].key);
+	cfg_strfree(&cc_entries[n].path);
+	cc_entries[n] = cc_entries[--cc_count];
+}
+
+
+/**
+ * Remove least recently used entries until \p needed bytes fit into the
+ * memory budget. Must be called with \p cc_lock held.
+ *
+ * \param[in] needed  Number of bytes to make room for.
+ */
+
+static void cc_evict(long long needed)
+{
+	int n, lru;
+
+	while (cc_count > 0 &&
+	    (cc_used + needed > cc_memory || cc_count == CC_MAX_ENTRIES)) {
+		lru = 0;
+		for (n = 1; n < cc_count; n++)
+			if (cc_entries[n].last_use < cc_entries[lru].last_use)
+				lru = n;
+		dg_printf(DG_VERBOSE, "cache: evicting '%s'\n",
+		    cc_entries[lru].key);
+		cc_remove(lru);
+	}
+}
+
+
+/**
+ * Unmount disk tier. Must be called with \p cc_lock held.
+ */
+
+static void cc_disk_umount(void)
+{
+	char *cmd;
+
+	if (!cc_disk_mounted)
+		return;
+
+	cfg_strinit(&cmd);
+	cfg_strprintf(&cmd, "umount %s", CC_DISK_MOUNT);
+	sync();
+	cfg_system(cmd);
+	cfg_strfree(&cmd);
+	cc_disk_mounted = 0;
+}
+
+
+/**
+ * Remove temporary files left behind in the disk tier, e.g. by a
+ * sysload which was stopped while storing a copy. Only called when the
+ * disk tier is mounted, before any copy is stored.
+ */
+
+static void cc_disk_clean(void)
+{
+	struct dirent *dirent;
+	char *path;
+	DIR *dir;
+
+	dir = opendir(CC_DISK_MOUNT "/" CC_DISK_DIR);
+	if (!dir)
+		return;
+	cfg_strinit(&path);
+	while ((dirent = readdir(dir)))
+		if (strstr(dirent->d_name, CC_DISK_TEMP)) {
+			cfg_strprintf(&path, "%s/%s/%s", CC_DISK_MOUNT,
+			    CC_DISK_DIR, dirent->d_name);
+			unlink(path);
+		}
+	cfg_strfree(&path);
+	closedir(dir);
+}
+
+
+/**
+ * Mount disk tier if configured and not yet mounted. Must be called
+ * with \p cc_lock held.
+ *
+ * \return Zero if disk tier is available, non-zero otherwise.
+ */
+
+static int cc_disk_mount(void)
+{
+	char *cmd;
+	int ret;
+
+	if (cc_disk_mounted)
+		return 0;
+	if (!cc_disk || !strlen(cc_disk) || cc_disk_size <= 0)
+		return -1;
+
+	cfg_strinit(&cmd);
+	if (strlen(cc_fstype))
+		cfg_strprintf(&cmd, "mkdir -p %s && mount -t %s %s %s",
+		    CC_DISK_MOUNT, cc_fstype, cc_disk, CC_DISK_MOUNT);
+	else
+		cfg_strprintf(&cmd, "mkdir -p %s && mount %s %s",
+		    CC_DISK_MOUNT, cc_disk, CC_DISK_MOUNT);
+	ret = cfg_system(cmd);
+	cfg_strfree(&cmd);
+	if (ret) {
+		syslog(LOG_ERR, "unable to mount cache disk '%s'", cc_disk);
+		return -1;
+	}
+	mkdir(CC_DISK_MOUNT "/" CC_DISK_DIR, S_IRWXU);
+	cc_disk_mounted = 1;
+	cc_disk_clean();
+
+	return 0;
+}
+
+
+/**
+ * Apply cache configuration. A smaller budget evicts entries
+ * immediately, a zero budget disables the cache. The disk tier is
+ * mounted when it is used for the first time.
+ *
+ * \param[in] cacheconf Pointer to cc_conf structure to be applied.
+ */
+
+void cc_conf_enable(struct cc_conf *cacheconf)
+{
+	pthread_mutex_lock(&cc_lock);
+	cc_memory = cacheconf->memory;
+	cc_evict(0);
+	if (cc_memory > 0)
+		mkdir(CC_CACHE_DIR, S_IRWXU);
+
+	if (!cc_disk) {
+		cfg_strinit(&cc_disk);
+		cfg_strinit(&cc_fstype);
+	}
+	if (strcmp(cc_disk, cacheconf->disk))
+		cc_disk_umount();
+	cfg_strcpy(&cc_disk, cacheconf->disk);
+	cfg_strcpy(&cc_fstype, cacheconf->fstype);
+	cc_disk_size = cacheconf->size;
+	pthread_mutex_unlock(&cc_lock);
+
+	dg_printf(DG_VERBOSE, "cache: memory budget %lld bytes\n", cc_memory);
+	dg_printf(DG_VERBOSE, "cache: disk '%s' budget %lld bytes\n",
+	    cc_disk, cc_disk_size);
+}
+
+
+/**
+ * Find cache entry. Must be called with \p cc_lock held.
+ *
+ * \param[in] key  URI and validator.
+ * \return         Index of entry or -1 if not found.
+ */
+
+static int cc_find(const char *key)
+{
+	int n;
+
+	for (n = 0; n < cc_count; n++)
+		if (!strcmp(cc_entries[n].key, key))
+			return n;
+	return -1;
+}
+
+
+/**
+ * Build cache key from URI and validator.
+ *
+ * \param[out] key        Dynamically allocated cache key.
+ * \param[in]  uri        Source URI.
+ * \param[in]  validator  Validator reported by the loader plugin.
+ */
+
+static void cc_make_key(char **key, const char *uri, const char *validator)
+{
+	cfg_strinit(key);
+	cfg_strprintf(key, "%s %s", uri, validator);
+}
+
+
+/**
+ * Copy data from file descriptor to a new file.
+ *
+ * \param[in] in    File descriptor to read from.
+ * \param[in] dest  Destination pathname.
+ * \return          Zero on success, non-zero on error.
+ */
+
+static int cc_copy_fd(int in, const char *dest)
+{
+	char buffer[65536];
+	ssize_t count;
+	int out, ret = 0;
+
+	out = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (out < 0)
+		return -1;
+	while ((count = cfg_read(in, buffer, sizeof(buffer))) > 0)
+		if (write(out, buffer, count) != count) {
+			ret = -1;
+			break;
+		}
+	if (count < 0 || fsync(out))
+		ret = -1;
+	if (close(out))
+		ret = -1;
+	if (ret)
+		unlink(dest);
+
+	return ret;
+}
+
+
+/**
+ * Copy file. Used if a cached copy cannot be linked.
+ *
+ * \param[in] src   Source pathname.
+ * \param[in] dest  Destination pathname.
+ * \return          Zero on success, non-zero on error.
+ */
+
+static int cc_copy(const char *src, const char *dest)
+{
+	int in, ret;
+
+	in = open(src, O_RDONLY);
+	if (in < 0)
+		return -1;
+	ret = cc_copy_fd(in, dest);
+	close(in);
+
+	return ret;
+}
+
+
+/**
+ * Add component to the memory tier. Must be called with \p cc_lock
+ * held.
+ *
+ * \param[in] key   Cache key.
+ * \param[in] dest  Pathname of local copy.
+ */
+
+static void cc_mem_insert(const char *key, const char *dest)
+{
+	struct cc_entry *entry;
+	struct stat st;
+	char *path;
+	int n;
+
+	if (stat(dest, &st) || st.st_size > cc_memory)
+		return;
+
+	// replace older copy with same key
+	n = cc_find(key);
+	if (n >= 0)
+		cc_remove(n);
+	cc_evict(st.st_size);
+
+	cfg_strinit(&path);
+	cfg_strprintf(&path, "%s/%lu", CC_CACHE_DIR, ++cc_clock);
+	if (link(dest, path)) {
+		dg_printf(DG_VERBOSE, "cache: cannot link '%s' - %s\n",
+		    dest, strerror(errno));
+		cfg_strfree(&path);
+		return;
+	}
+	entry = &cc_entries[cc_count++];
+	cfg_strinitcpy(&entry->key, key);
+	entry->path = path;
+	entry->size = st.st_size;
+	entry->last_use = cc_clock;
+	cc_used += st.st_size;
+}
+
+
+/**
+ * Build pathname of a disk tier file. Files are named by a hash of the
+ * URI, the key file holds URI and validator of the data file.
+ *
+ * \param[out] path    Dynamically allocated pathname.
+ * \param[in]  uri     Source URI.
+ * \param[in]  suffix  Filename suffix.
+ */
+
+static void cc_disk_path(char **path, const char *uri, const char *suffix)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const char *ptr;
+
+	// FNV-1a
+	for (ptr = uri; *ptr; ptr++) {
+		hash ^= (unsigned char) *ptr;
+		hash *= 1099511628211ULL;
+	}
+	cfg_strinit(path);
+	cfg_strprintf(path, "%s/%s/%016llx%s", CC_DISK_MOUNT, CC_DISK_DIR,
+	    hash, suffix);
+}
+
+
+/**
+ * Open data file of the disk tier for an URI. Must be called with
+ * \p cc_lock held.
+ *
+ * \param[in] uri        Source URI.
+ * \param[in] validator  Validator of current source or \p NULL to
+ *                       accept any version.
+ * \return               Open file descriptor or -1 if no matching
+ *                       copy is available.
+ */
+
+static int cc_disk_open(const char *uri, const char *validator)
+{
+	char *key_path, *data_path, *key, line[4096];
+	FILE *file;
+	int fd = -1;
+
+	if (cc_disk_mount())
+		return -1;
+
+	cc_disk_path(&key_path, uri, ".key");
+	cc_disk_path(&data_path, uri, ".dat");
+	cc_make_key(&key, uri, validator ? validator : "");
+
+	file = fopen(key_path, "r");
+	if (!file)
+		goto out;
+	if (!fgets(line, sizeof(line), file))
+		line[0] = '\0';
+	fclose(file);
+	line[strcspn(line, "\n")] = '\0';
+
+	// key file holds URI and validator separated by a blank
+	if (validator ? strcmp(line, key) :
+	    strncmp(line, key, strlen(key)))
+		goto out;
+
+	fd = open(data_path, O_RDONLY);
+	if (fd >= 0)
+		utime(data_path, NULL);
+
+ out:
+	cfg_strfree(&key_path);
+	cfg_strfree(&data_path);
+	cfg_strfree(&key);
+
+	return fd;
+}
+
+
+/**
+ * Remove least recently used files of the disk tier until \p needed
+ * bytes fit into the disk budget. Must be called with \p cc_lock held.
+ *
+ * \param[in] needed  Number of bytes to make room for.
+ * \param[in] keep    Filename prefix of the entry being replaced.
+ */
+
+static void cc_disk_evict(long long needed, const char *keep)
+{
+	struct cc_disk_entry *entries;
+	struct dirent *dirent;
+	struct stat st;
+	char *path, *name;
+	long long used = 0;
+	int count = 0, n, lru;
+	DIR *dir;
+
+	dir = opendir(CC_DISK_MOUNT "/" CC_DISK_DIR);
+	if (!dir)
+		return;
+	entries = malloc(CC_MAX_DISK_ENTRIES * sizeof(*entries));
+	MEM_ASSERT(entries);
+	cfg_strinit(&path);
+
+	while ((dirent = readdir(dir)) && count < CC_MAX_DISK_ENTRIES) {
+		name = dirent->d_name;
+		if (strlen(name) != 20 || strcmp(name + 16, ".dat") ||
+		    !strncmp(name, keep, 16))
+			continue;
+		cfg_strprintf(&path, "%s/%s/%s", CC_DISK_MOUNT, CC_DISK_DIR,
+		    name);
+		if (stat(path, &st))
+			continue;
+		strncpy(entries[count].name, name, 16);
+		entries[count].name[16] = '\0';
+		entries[count].size = st.st_size;
+		entries[count].last_use = st.st_mtime;
+		used += st.st_size;
+		count++;
+	}
+	closedir(dir);
+
+	while (count > 0 && used + needed > cc_disk_size) {
+		lru = 0;
+		for (n = 1; n < count; n++)
+			if (entries[n].last_use < entries[lru].last_use)
+				lru = n;
+		dg_printf(DG_VERBOSE, "cache: evicting disk entry %s\n",
+		    entries[lru].name);
+		cfg_strprintf(&path, "%s/%s/%s.key", CC_DISK_MOUNT,
+		    CC_DISK_DIR, entries[lru].name);
+		unlink(path);
+		cfg_strprintf(&path, "%s/%s/%s.dat", CC_DISK_MOUNT,
+		    CC_DISK_DIR, entries[lru].name);
+		unlink(path);
+		used -= entries[lru].size;
+		entries[lru] = entries[--count];
+	}
+
+	cfg_strfree(&path);
+	free(entries);
+}
+
+
+/**
+ * Create a temporary file in the disk tier with a unique name, so that
+ * concurrent loads of the same URI do not write into the same file.
+ *
+ * \param[in]  uri   Source URI.
+ * \param[in]  what  Kind of file, e.g. "dat".
+ * \param[out] path  Dynamically allocated pathname of the file.
+ * \return     Zero on success, non-zero on error.
+ */
+
+static int cc_disk_temp(const char *uri, const char *what, char **path)
+{
+	char *suffix;
+	int fd;
+
+	cfg_strinit(&suffix);
+	cfg_strprintf(&suffix, "%s%s.XXXXXX", CC_DISK_TEMP, what);
+	cc_disk_path(path, uri, suffix);
+	cfg_strfree(&suffix);
+	fd = mkstemp(*path);
+	if (fd < 0)
+		return -1;
+	close(fd);
+
+	return 0;
+}
+
+
+/**
+ * Store component in the disk tier. Data and key are written to
+ * temporary files first and renamed together with \p cc_lock held, so
+ * that a key never refers to the data of another load.
+ *
+ * \param[in] uri        Source URI.
+ * \param[in] validator  Validator of loaded source, may be empty.
+ * \param[in] dest       Pathname of local copy.
+ */
+
+static void cc_disk_insert(const char *uri, const char *validator,
+    const char *dest)
+{
+	char *key_path, *data_path, *tmp_data = NULL, *tmp_key = NULL, *key;
+	struct stat st;
+	FILE *file;
+	int ret;
+
+	pthread_mutex_lock(&cc_lock);
+	ret = cc_disk_mount();
+	pthread_mutex_unlock(&cc_lock);
+	if (ret || stat(dest, &st) || st.st_size > cc_disk_size)
+		return;
+
+	cc_disk_path(&key_path, uri, ".key");
+	cc_disk_path(&data_path, uri, ".dat");
+	cc_make_key(&key, uri, validator);
+
+	// write copy and key outside of the lock, it may take a while
+	if (cc_disk_temp(uri, "dat", &tmp_data) ||
+	    cc_copy(dest, tmp_data) || cc_disk_temp(uri, "key", &tmp_key))
+		goto out;
+	file = fopen(tmp_key, "w");
+	if (!file)
+		goto out;
+	fprintf(file, "%s\n", key);
+	if (fflush(file) || fsync(fileno(file)))
+		ret = -1;
+	if (fclose(file) || ret)
+		goto out;
+
+	pthread_mutex_lock(&cc_lock);
+	cc_disk_evict(st.st_size, strrchr(data_path, '/') + 1);
+	// invalidate old key before data is replaced
+	unlink(key_path);
+	if (rename(tmp_data, data_path) == 0)
+		rename(tmp_key, key_path);
+	pthread_mutex_unlock(&cc_lock);
+
+ out:
+	// left over only if not renamed
+	if (tmp_data)
+		unlink(tmp_data);
+	if (tmp_key)
+		unlink(tmp_key);
+	cfg_strfree(&key_path);
+	cfg_strfree(&data_path);
+	cfg_strfree(&tmp_data);
+	cfg_strfree(&tmp_key);
+	cfg_strfree(&key);
+}
+
+
+/**
+ * Provide cached copy of a component. The memory tier is searched
+ * first, then the disk tier. Copies found on disk are added to the
+ * memory tier.
+ *
+ * \param[in] uri        Source URI.
+ * \param[in] validator  Validator of current source.
+ * \param[in] dest       Pathname of local copy to be created.
+ * \return               Zero if \p dest was created from the cache,
+ *                       non-zero otherwise.
+ */
+
+int cc_lookup(const char *uri, const char *validator, const char *dest)
+{
+	char *key;
+	int n, fd, ret = -1;
+
+	if (!strlen(validator))
+		return -1;
+
+	cc_make_key(&key, uri, validator);
+	pthread_mutex_lock(&cc_lock);
+	n = cc_find(key);
+	if (n >= 0) {
+		unlink(dest);
+		if (link(cc_entries[n].path, dest) == 0 ||
+		    cc_copy(cc_entries[n].path, dest) == 0) {
+			cc_entries[n].last_use = ++cc_clock;
+			ret = 0;
+		} else
+			cc_remove(n);
+	}
+	fd = ret ? cc_disk_open(uri, validator) : -1;
+	pthread_mutex_unlock(&cc_lock);
+
+	if (fd >= 0) {
+		ret = cc_copy_fd(fd, dest);
+		close(fd);
+		if (!ret) {
+			pthread_mutex_lock(&cc_lock);
+			cc_mem_insert(key, dest);
+			pthread_mutex_unlock(&cc_lock);
+		}
+	}
+	dg_printf(DG_VERBOSE, "cache: %s '%s'\n", ret ? "miss" : "hit", key);
+	cfg_strfree(&key);
+
+	return ret;
+}
+
+
+/**
+ * Provide cached copy of a component regardless of its validator. Used
+ * if the source cannot be loaded, e.g. because the server is down.
+ *
+ * \param[in] uri   Source URI.
+ * \param[in] dest  Pathname of local copy to be created.
+ * \return          Zero if \p dest was created from the cache,
+ *                  non-zero otherwise.
+ */
+
+int cc_lookup_stale(const char *uri, const char *dest)
+{
+	char *prefix;
+	int n, fd = -1, ret = -1;
+
+	cc_make_key(&prefix, uri, "");
+	pthread_mutex_lock(&cc_lock);
+	for (n = 0; n < cc_count; n++)
+		if (!strncmp(cc_entries[n].key, prefix, strlen(prefix)))
+			break;
+	if (n < cc_count)
+		fd = open(cc_entries[n].path, O_RDONLY);
+	if (fd < 0)
+		fd = cc_disk_open(uri, NULL);
+	pthread_mutex_unlock(&cc_lock);
+	cfg_strfree(&prefix);
+
+	if (fd >= 0) {
+		unlink(dest);
+		ret = cc_copy_fd(fd, dest);
+		close(fd);
+	}
+	if (!ret)
+		syslog(LOG_WARNING, "source unavailable, using cached copy"
+		    " of '%s'", uri);
+
+	return ret;
+}
+
+
+/**
+ * Add loaded component to the cache. The memory tier is skipped if it
+ * is disabled, no validator is available or the component does not fit
+ * into the memory budget. The disk tier stores components without
+ * validator, they are used if the source cannot be loaded.
+ *
+ * \param[in] uri        Source URI.
+ * \param[in] validator  Validator of loaded source.
+ * \param[in] dest       Pathname of local copy.
+ */
+
+void cc_insert(const char *uri, const char *validator, const char *dest)
+{
+	char *key;
+
+	if (strlen(validator)) {
+		cc_make_key(&key, uri, validator);
+		pthread_mutex_lock(&cc_lock);
+		cc_mem_insert(key, dest);
+		pthread_mutex_unlock(&cc_lock);
+		cfg_strfree(&key);
+	}
+
+	cc_disk_insert(uri, validator, dest);
+}
+
+
+/**
+ * Remove all cached components from the memory tier.
+ */
+
+void cc_flush(void)
+{
+	pthread_mutex_lock(&cc_lock);
+	while (cc_count > 0)
+		cc_remove(0);
+	pthread_mutex_unlock(&cc_lock);
+}
+
+
+/**
+ * Release resources which must not be held while the new kernel is
+ * started: unmount the disk tier. It is mounted again if the cache is
+ * used later on.
+ */
+
+void cc_release(void)
+{
+	pthread_mutex_lock(&cc_lock);
+	cc_disk_umount();
+	pthread_mutex_unlock(&cc_lock);
+}
@@ -0,0 +1,47 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_cache.h
+ * \brief Cache for components loaded by the component loader
+ *
+ * $Id$
+ */
+
+
+#ifndef _COMP_CACHE_H_
+#define _COMP_CACHE_H_
+
+#define CC_CACHE_DIR "/tmp/sysload-cache" //!< directory with cached files
+#define CC_DISK_MOUNT "/var/sysload/cache" //!< mount point of disk cache
+#define CC_DISK_DIR "sysload-cache" //!< directory on disk cache device
+
+
+/**
+ * This structure describes the configuration of the component cache
+ */
+
+struct cc_conf {
+	long long memory;   //!< memory budget in bytes, zero disables cache
+	char *disk;         //!< block device for persistent cache
+	char *fstype;       //!< filesystem type of disk, empty for auto
+	long long size;     //!< disk budget in bytes
+};
+
+struct cc_conf *cc_conf_new();
+void cc_conf_init(struct cc_conf *cacheconf);
+void cc_conf_destroy(struct cc_conf *cacheconf);
+void cc_conf_reset(struct cc_conf *cacheconf);
+void cc_conf_free(struct cc_conf **cacheconf);
+void cc_conf_enable(struct cc_conf *cacheconf);
+
+int cc_lookup(const char *uri, const char *validator, const char *dest);
+int cc_lookup_stale(const char *uri, const char *dest);
+void cc_insert(const char *uri, const char *validator, const char *dest);
+void cc_flush(void);
+void cc_release(void);
+
+#endif /* #ifndef _COMP_CACHE_H_ */
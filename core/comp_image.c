@@ -0,0 +1,572 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_image.c
+ * \brief Loading components from inside remote filesystem images
+ *
+ * A URI whose fragment is an absolute path, e.g.
+ * \c http://host/image.iso#/boot/vmlinuz, names a file inside the ext2/3/4
+ * or ISO9660 image at the URI without fragment. The image is not
+ * downloaded. It is read with range requests through the in-process
+ * plugin of its scheme, and only the filesystem metadata and the
+ * extents of the requested file are transferred. Metadata is kept in a
+ * small block cache per image, so all components loaded from the same
+ * image share directory lookups. An image is opened under a lock of its
+ * own, so that a slow image server does not hold up other images, and
+ * every stream reads it with its own timeouts. Images are closed by
+ * ci_release() at the end of each boot attempt.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "loader.h"
+#include "comp_load.h"
+#include "comp_image.h"
+#include "fsread.h"
+#include "debug.h"
+
+
+/**
+ * One cached block of an image.
+ */
+
+struct ci_block {
+	char *data;                 //!< block data or NULL if unused
+	uint64_t offset;            //!< position in image
+	size_t length;              //!< valid bytes, less at end of image
+	unsigned long used;         //!< time of last use for replacement
+};
+
+
+/**
+ * An image opened for reading.
+ */
+
+struct ci_session {
+	char *key;                  //!< image URI without fragment
+	const struct cl_plugin *plugin; //!< plugin handling the image URI
+	struct fs *fs;              //!< filesystem of image once opened, only
+	                            //!< read through copies, see ci_reader_open()
+	long long size;             //!< size of image
+	char validator[CL_VALIDATOR_SIZE]; //!< validator of image
+	struct ci_block cache[CI_CACHE_BLOCKS]; //!< cached blocks
+	unsigned long clock;        //!< counter for ci_block.used
+	pthread_mutex_t lock;       //!< protects cache
+	pthread_mutex_t open_lock;  //!< held while the image is opened
+};
+
+
+/**
+ * An image read on behalf of one stream. Range requests are made with
+ * the timeouts of the stream.
+ */
+
+struct ci_reader {
+	struct ci_session *session; //!< image
+	int connect_timeout;        //!< timeouts of the stream, used
+	int io_timeout;             //!< for its range requests
+};
+
+
+/**
+ * Private data of an open stream.
+ */
+
+struct ci_priv {
+	struct ci_reader reader;    //!< image of file
+	struct fs *fs;              //!< filesystem read by reader
+	struct fs_file file;        //!< file in image
+	uint64_t pos;               //!< position in file
+	long long remaining;        //!< bytes left to read or -1 for all
+	char *buffer;               //!< buffer of ci_copy()
+	size_t buffer_size;         //!< size of buffer
+};
+
+static struct ci_session ci_sessions[CI_MAX_SESSIONS];
+static int ci_count = 0;
+static pthread_mutex_t ci_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Read part of an image with one range request.
+ *
+ * \param[in]  reader  Image and timeouts.
+ * \param[out] buf     Destination buffer.
+ * \param[in]  offset  Position in image.
+ * \param[in]  count   Number of bytes.
+ * \return     Zero on success, non-zero on error.
+ */
+
+static int
+ci_fetch(const struct ci_reader *reader, char *buf, uint64_t offset,
+    size_t count)
+{
+	struct ci_session *session = reader->session;
+	struct cl_stream stream;
+	size_t done = 0;
+	ssize_t ret = -1;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.uri = session->key;
+	stream.dest_fd = -1;
+	stream.size = -1;
+	stream.offset = offset;
+	stream.length = count;
+	stream.connect_timeout = reader->connect_timeout;
+	stream.io_timeout = reader->io_timeout;
+	if (session->plugin->open(&stream)) {
+		dg_printf(DG_VERBOSE, "reading '%s': %s\n", session->key,
+		    stream.errmsg);
+		return -1;
+	}
+
+	// never mix data of different versions of the image
+	stream.validator[CL_VALIDATOR_SIZE-1] = '\0';
+	if (strlen(session->validator) &&
+	    strcmp(stream.validator, session->validator))
+		snprintf(stream.errmsg, CL_MSG_SIZE, "Image changed.");
+	else
+		while (done < count && (ret = session->plugin->read(&stream,
+		    buf + done, count - done)) > 0)
+			done += ret;
+	session->plugin->close(&stream);
+	if (done < count) {
+		dg_printf(DG_VERBOSE, "reading '%s': %s\n", session->key,
+		    ret == 0 ? "Unexpected end of file." : stream.errmsg);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Read function of struct fs_source for an image. Large reads, i.e. file
+ * data, are passed through, small reads are served from the block cache.
+ *
+ * \param[in]  priv    Reader of image.
+ * \param[out] buf     Destination buffer.
+ * \param[in]  count   Number of bytes.
+ * \param[in]  offset  Position in image.
+ * \return     Zero on success, non-zero on error.
+ */
+
+static int
+ci_source_read(void *priv, void *buf, size_t count, uint64_t offset)
+{
+	const struct ci_reader *reader = priv;
+	struct ci_session *session = reader->session;
+	struct ci_block *block, *victim, *entry;
+	uint64_t start;
+	size_t n, skip;
+	int i, ret = 0;
+
+	if (count > session->size || offset > session->size - count)
+		return -1;
+	if (count >= CI_BLOCK_SIZE)
+		return ci_fetch(reader, buf, offset, count);
+
+	pthread_mutex_lock(&session->lock);
+	while (count > 0 && !ret) {
+		start = offset - offset % CI_BLOCK_SIZE;
+		block = victim = NULL;
+		for (i = 0; i < CI_CACHE_BLOCKS && !block; i++) {
+			entry = &session->cache[i];
+			if (entry->data && entry->offset == start)
+				block = entry;
+			// replace an unused block or the least recently used
+			else if (!victim || (victim->data && (!entry->data ||
+			    entry->used < victim->used)))
+				victim = entry;
+		}
+		if (!block) {
+			block = victim;
+			if (!block->data) {
+				block->data = malloc(CI_BLOCK_SIZE);
+				MEM_ASSERT(block->data);
+			}
+			block->offset = start;
+			block->length = session->size - start < CI_BLOCK_SIZE ?
+			    session->size - start : CI_BLOCK_SIZE;
+			if (ci_fetch(reader, block->data, start,
+			    block->length)) {
+				free(block->data);
+				block->data = NULL;
+				ret = -1;
+				break;
+			}
+		}
+		block->used = ++session->clock;
+		skip = offset - start;
+		n = block->length - skip < count ? block->length - skip : count;
+		memcpy(buf, block->data + skip, n);
+		buf = (char *) buf + n;
+		offset += n;
+		count -= n;
+	}
+	pthread_mutex_unlock(&session->lock);
+
+	return ret;
+}
+
+
+/**
+ * Set up a reader of an image for a stream.
+ *
+ * \param[out] reader   Reader to set up.
+ * \param[in]  session  Image.
+ * \param[in]  stream   Stream whose timeouts are used.
+ * \return     Source of the filesystem reads of \p reader.
+ */
+
+static struct fs_source
+ci_reader_init(struct ci_reader *reader, struct ci_session *session,
+    const struct cl_stream *stream)
+{
+	struct fs_source source;
+
+	reader->session = session;
+	reader->connect_timeout = stream->connect_timeout;
+	reader->io_timeout = stream->io_timeout;
+	source.read = ci_source_read;
+	source.priv = reader;
+
+	return source;
+}
+
+
+/**
+ * Open the filesystem of an image for a stream. The image is probed and
+ * its filesystem opened if not done yet. This is done with the lock of
+ * the image held, so that other streams of the image wait for it while
+ * streams of other images go on.
+ *
+ * \param[in,out] stream   Stream with URI.
+ * \param[out]    reader   Reader of the image for \p stream.
+ * \param[out]    fs       Filesystem read by \p reader, to be closed
+ *                         with fs_close().
+ * \param[out]    path     Pathname in image, points into \c stream->uri.
+ * \return                 Zero on success, non-zero on error
+ *                         (\c stream->errmsg set).
+ */
+
+static int
+ci_reader_open(struct cl_stream *stream, struct ci_reader *reader,
+    struct fs **fs, const char **path)
+{
+	const char *hash = strchr(stream->uri, '#');
+	struct ci_session *session = NULL;
+	struct fs_source source;
+	struct cl_stream probe;
+	char *errmsg = NULL;
+	int n;
+
+	*path = hash + 1;
+	pthread_mutex_lock(&ci_lock);
+	for (n = 0; n < ci_count; n++)
+		if (strlen(ci_sessions[n].key) == hash - stream->uri &&
+		    !strncmp(ci_sessions[n].key, stream->uri,
+		    hash - stream->uri))
+			session = &ci_sessions[n];
+	pthread_mutex_unlock(&ci_lock);
+	if (!session) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Too many images.");
+		return -1;
+	}
+
+	source = ci_reader_init(reader, session, stream);
+	pthread_mutex_lock(&session->open_lock);
+	if (!session->fs) {
+		memset(&probe, 0, sizeof(probe));
+		probe.uri = session->key;
+		probe.dest_fd = -1;
+		probe.size = -1;
+		probe.length = -1;
+		probe.connect_timeout = stream->connect_timeout;
+		probe.io_timeout = stream->io_timeout;
+		if (!session->plugin->probe || session->plugin->probe(&probe)) {
+			cfg_strprintf(&errmsg, "Cannot access image - %s",
+			    probe.errmsg);
+			if (session->plugin->abi_version >= 7)
+				stream->unreachable = probe.unreachable;
+		} else if (!probe.ranges || probe.size <= 0)
+			cfg_strprintf(&errmsg, "Image source does not support "
+			    "range requests.");
+		else {
+			session->size = probe.size;
+			probe.validator[CL_VALIDATOR_SIZE-1] = '\0';
+			strcpy(session->validator, probe.validator);
+			errmsg = fs_open(&session->fs, &source);
+		}
+	}
+	if (!errmsg)
+		*fs = fs_dup(session->fs, &source);
+	pthread_mutex_unlock(&session->open_lock);
+
+	if (errmsg) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+		free(errmsg);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Set size and validator of stream. The validator combines the validator
+ * of the image with the identity of the file in it.
+ *
+ * \param[in,out] stream   Stream to update.
+ * \param[in]     session  Image of file.
+ * \param[in]     file     File found by fs_lookup().
+ */
+
+static void
+ci_set_validator(struct cl_stream *stream, const struct ci_session *session,
+    const struct fs_file *file)
+{
+	stream->size = file->size;
+	if (strlen(session->validator))
+		snprintf(stream->validator, CL_VALIDATOR_SIZE,
+		    "%llx-%llx-%lx %.72s", (unsigned long long) file->ino,
+		    (unsigned long long) file->size,
+		    (unsigned long) file->mtime, session->validator);
+	else
+		stream->validator[0] = '\0';
+}
+
+
+/**
+ * Open image of URI and report size and validator of the file.
+ *
+ * \param[in,out] stream  Stream to probe.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+ci_probe(struct cl_stream *stream)
+{
+	struct ci_reader reader;
+	struct fs_file file;
+	const char *path;
+	struct fs *fs;
+	char *errmsg;
+
+	if (ci_reader_open(stream, &reader, &fs, &path))
+		return -1;
+	errmsg = fs_lookup(fs, path, &file);
+	fs_close(fs);
+	if (errmsg) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+		free(errmsg);
+		return -1;
+	}
+	ci_set_validator(stream, reader.session, &file);
+	stream->ranges = 1;
+	fs_file_free(&file);
+
+	return 0;
+}
+
+
+/**
+ * Open file in image, positioned at \c stream->offset.
+ *
+ * \param[in,out] stream  Stream to open.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+ci_open(struct cl_stream *stream)
+{
+	struct ci_priv *priv;
+	const char *path;
+	char *errmsg;
+
+	priv = malloc(sizeof(*priv));
+	MEM_ASSERT(priv);
+	memset(priv, 0, sizeof(*priv));
+	if (ci_reader_open(stream, &priv->reader, &priv->fs, &path)) {
+		free(priv);
+		return -1;
+	}
+	errmsg = fs_lookup(priv->fs, path, &priv->file);
+	if (errmsg) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+		free(errmsg);
+		fs_close(priv->fs);
+		free(priv);
+		return -1;
+	}
+	ci_set_validator(stream, priv->reader.session, &priv->file);
+	priv->pos = stream->offset > 0 ? stream->offset : 0;
+	priv->remaining = stream->length;
+
+	stream->priv = priv;
+	return 0;
+}
+
+
+/**
+ * Read next chunk of file.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[out]    buf     Destination buffer.
+ * \param[in]     count   Size of destination buffer.
+ * \return                Number of bytes read, zero at end of file,
+ *                        negative value on error.
+ */
+
+static ssize_t
+ci_read(struct cl_stream *stream, void *buf, size_t count)
+{
+	struct ci_priv *priv = stream->priv;
+	ssize_t ret;
+
+	if (priv->remaining >= 0 && count > priv->remaining)
+		count = priv->remaining;
+	if (count == 0)
+		return 0;
+	ret = fs_read(priv->fs, &priv->file, buf, count, priv->pos);
+	if (ret < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Error reading image.");
+		return -1;
+	}
+	priv->pos += ret;
+	if (priv->remaining > 0)
+		priv->remaining -= ret;
+
+	return ret;
+}
+
+
+/**
+ * Transfer next chunk of file to the local copy. The whole chunk is
+ * requested from the image at once, so each extent of the file is
+ * fetched with few large range requests.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[in]     fd      Descriptor of local copy.
+ * \param[in]     offset  Position in local copy.
+ * \param[in]     count   Maximum number of bytes.
+ * \return                Number of bytes transferred, zero at end of
+ *                        file, negative value on error.
+ */
+
+static ssize_t
+ci_copy(struct cl_stream *stream, int fd, long long offset, size_t count)
+{
+	struct ci_priv *priv = stream->priv;
+
+	return comp_load_copy_buffered(stream, ci_read, &priv->buffer,
+	    &priv->buffer_size, fd, offset, count);
+}
+
+
+/**
+ * Close file.
+ *
+ * \param[in,out] stream  Open stream.
+ */
+
+static void
+ci_close(struct cl_stream *stream)
+{
+	struct ci_priv *priv = stream->priv;
+
+	fs_file_free(&priv->file);
+	fs_close(priv->fs);
+	free(priv->buffer);
+	free(priv);
+	stream->priv = NULL;
+}
+
+
+static const struct cl_plugin ci_plugin = {
+	.abi_version = CL_PLUGIN_ABI_VERSION,
+	.scheme      = "image",
+	.open        = ci_open,
+	.read        = ci_read,
+	.close       = ci_close,
+	.probe       = ci_probe,
+	.copy        = ci_copy,
+};
+
+
+/**
+ * Select plugin for a URI. URIs naming a file inside an image, i.e.
+ * with an absolute path as fragment, are handled by the image plugin if
+ * the plugin of the image supports range requests. The image is
+ * registered for the current boot attempt but not opened yet.
+ *
+ * \param[in] plugin  Plugin handling the URI scheme.
+ * \param[in] uri     URI of component.
+ * \return            Plugin to use for the URI.
+ */
+
+const struct cl_plugin *
+ci_select(const struct cl_plugin *plugin, const char *uri)
+{
+	const char *hash = strchr(uri, '#');
+	struct ci_session *session;
+	int n, found = 0;
+
+	if (!hash || hash[1] != '/' || plugin->abi_version < 4 ||
+	    !plugin->probe)
+		return plugin;
+
+	pthread_mutex_lock(&ci_lock);
+	for (n = 0; n < ci_count && !found; n++)
+		found = strlen(ci_sessions[n].key) == hash - uri &&
+		    !strncmp(ci_sessions[n].key, uri, hash - uri);
+	if (!found && ci_count < CI_MAX_SESSIONS) {
+		session = &ci_sessions[ci_count++];
+		memset(session, 0, sizeof(*session));
+		cfg_strinit(&session->key);
+		cfg_strncpy(&session->key, uri, hash - uri);
+		session->plugin = plugin;
+		pthread_mutex_init(&session->lock, NULL);
+		pthread_mutex_init(&session->open_lock, NULL);
+	}
+	pthread_mutex_unlock(&ci_lock);
+
+	return &ci_plugin;
+}
+
+
+/**
+ * Close all images and drop their cached blocks. Must not be called
+ * while components are loaded.
+ */
+
+void
+ci_release(void)
+{
+	struct ci_session *session;
+	int n;
+
+	pthread_mutex_lock(&ci_lock);
+	while (ci_count > 0) {
+		session = &ci_sessions[--ci_count];
+		if (session->fs)
+			fs_close(session->fs);
+		for (n = 0; n < CI_CACHE_BLOCKS; n++)
+			free(session->cache[n].data);
+		cfg_strfree(&session->key);
+		pthread_mutex_destroy(&session->lock);
+		pthread_mutex_destroy(&session->open_lock);
+	}
+	pthread_mutex_unlock(&ci_lock);
+}
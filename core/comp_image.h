@@ -0,0 +1,28 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_image.h
+ * \brief Loading components from inside remote filesystem images
+ *
+ * $Id$
+ */
+
+
+#ifndef _COMP_IMAGE_H_
+#define _COMP_IMAGE_H_
+
+#include "comp_load.h"
+
+#define CI_MAX_SESSIONS 4           //!< images open per boot attempt
+#define CI_BLOCK_SIZE   65536       //!< size of cached image blocks
+#define CI_CACHE_BLOCKS 64          //!< cached blocks per image
+
+const struct cl_plugin *ci_select(const struct cl_plugin *plugin,
+    const char *uri);
+void ci_release(void);
+
+#endif /* #ifndef _COMP_IMAGE_H_ */
@@ -18,41 +18,107 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
-#include <ctype.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <syslog.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
 #include "sysload.h"
+#include "comp_cache.h"
+#include "comp_image.h"
+#include "sha256.h"
+#include "uri.h"
+
+
+#define CL_MAX_PLUGINS    16    //!< maximum number of registered schemes
+#define CL_SCHEME_SIZE    32    //!< maximum length of URI scheme
+#define CL_BUFFER_SIZE    65536 //!< size of copy buffer
+#define CL_COPY_SIZE      (1 << 20) //!< bytes per plugin copy call
+#define CL_CANCEL_POLL    200   //!< cancel poll interval in milliseconds
+#define CL_RETRIES        5     //!< resume attempts per transfer
+#define CL_RETRY_DELAY    1000  //!< first resume delay in milliseconds,
+                                //!< doubled for every attempt
+#define CL_MAGIC_SIZE     6     //!< bytes checked for compressed formats
+#define CL_BROKER_WAIT    5     //!< seconds to wait for a broker to stop
+#define CL_UNREACHABLE    1     //!< result of a transfer whose source
+                                //!< could not be contacted
+#define CL_KILL_DELAY     2000  //!< delay in milliseconds before loader
+                                //!< modules are killed with SIGKILL
 
 
 /**
- * Verify that URI starts with a valid URI scheme.
- *
- * \param[in] uri  URI to verify.
- * \return         Zero for correct URI scheme, non zero otherwise.
+ * Plugin registry entry. Entries with \c plugin set to \c NULL record
+ * schemes without plugin so that they are not looked up again.
  */
 
-int verify_uri_scheme(const char *uri)
-{
-	const char *colon_ptr, *ptr;
+struct cl_registry_entry {
+	char scheme[CL_SCHEME_SIZE];     //!< URI scheme
+	const struct cl_plugin *plugin;  //!< plugin or NULL
+	void *handle;                    //!< handle returned by dlopen()
+};
 
-	// valid URIs it must contain a ':'
-	colon_ptr = strchr(uri, ':');
-	if (!colon_ptr)
-		return -1;
+/**
+ * Compressed format recognized by its first bytes and the command which
+ * decompresses it from standard input to standard output.
+ */
 
-	// valid URIs must start with a alphabetic character
-	if (!islower(uri[0]) && !isupper(uri[0]))
-		return -1;
+struct cl_format {
+	const char *name;                   //!< name for messages
+	unsigned char magic[CL_MAGIC_SIZE]; //!< first bytes of the data
+	size_t magic_len;                   //!< number of bytes in magic
+	char *const argv[4];                //!< decompression command
+};
 
-	// all remaining characters before ':' must be either alphabetic
-	// characters or digits or '+' or '-' or '.'
-	for (ptr = uri+1; ptr < colon_ptr; ptr++) {
-		if (!islower(*ptr) && !isupper(*ptr) && !isdigit(*ptr) &&
-		    *ptr != '+' && *ptr != '-' && *ptr != '.')
-			return -1;
-	}
+static const struct cl_format cl_formats[] = {
+	{ "gzip", { 0x1f, 0x8b }, 2, { "gzip", "-dc", NULL } },
+	{ "xz", { 0xfd, '7', 'z', 'X', 'Z', 0x00 }, 6,
+	  { "xz", "-dc", "-T0", NULL } },
+	{ "zstd", { 0x28, 0xb5, 0x2f, 0xfd }, 4, { "zstd", "-dcq", NULL } },
+};
 
-	return 0;
-}
+
+/**
+ * Decompression stage of a transfer. The data of a compressed source is
+ * passed to a decompression process writing the local copy as the
+ * transfer proceeds.
+ */
+
+struct cl_decoder {
+	int enabled;                     //!< decompress compressed sources
+	int checked;                     //!< format of source is known
+	const struct cl_format *format;  //!< running decoder or NULL
+	int fd;                          //!< socket to decoder input
+	pid_t pid;                       //!< decoder process
+};
+
+/**
+ * Deadlines configured for a URI scheme. The entry with an empty scheme
+ * applies to all schemes.
+ */
+
+struct cl_timeouts_entry {
+	char scheme[CL_SCHEME_SIZE];     //!< URI scheme or empty
+	struct cl_timeouts timeouts;     //!< deadlines, 0 if not set
+};
+
+static struct cl_registry_entry cl_registry[CL_MAX_PLUGINS];
+static int cl_registry_count = 0;
+static pthread_mutex_t cl_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct cl_timeouts_entry cl_timeouts[CL_MAX_PLUGINS];
+static int cl_timeouts_count = 0;
+static pthread_mutex_t cl_timeouts_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// signalled whenever a request thread completes
+static pthread_mutex_t cl_finish_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cl_finish = PTHREAD_COND_INITIALIZER;
 
 
 /**
@@ -81,52 +147,1246 @@ read_to_string(int fd, char **str)
 
 
 /**
- * Access file specified by a URI and create a copy on a local filesystem.
+ * Find registry entry for an URI scheme.
+ *
+ * \param[in] scheme  URI scheme.
+ * \return            Registry entry or \c NULL if scheme is unknown.
+ */
+
+static struct cl_registry_entry *
+cl_registry_find(const char *scheme)
+{
+	int i;
+
+	for (i = 0; i < cl_registry_count; i++)
+		if (!strcmp(cl_registry[i].scheme, scheme))
+			return &cl_registry[i];
+	return NULL;
+}
+
+
+/**
+ * Add plugin to the registry.
+ *
+ * \param[in] scheme  URI scheme.
+ * \param[in] plugin  Plugin description or \c NULL to record a miss.
+ * \param[in] handle  Handle returned by dlopen() or \c NULL.
+ * \return            Zero on success, non-zero if registry is full or
+ *                    scheme is too long.
+ */
+
+static int
+cl_registry_add(const char *scheme, const struct cl_plugin *plugin,
+    void *handle)
+{
+	struct cl_registry_entry *entry;
+
+	if (cl_registry_count >= CL_MAX_PLUGINS ||
+	    strlen(scheme) >= CL_SCHEME_SIZE)
+		return -1;
+
+	entry = &cl_registry[cl_registry_count++];
+	strcpy(entry->scheme, scheme);
+	entry->plugin = plugin;
+	entry->handle = handle;
+
+	return 0;
+}
+
+
+/**
+ * Register a plugin which is linked into the calling program.
+ *
+ * \param[in] plugin  Plugin description.
+ * \return            Zero on success, non-zero on error.
+ */
+
+int
+comp_load_register(const struct cl_plugin *plugin)
+{
+	struct cl_registry_entry *entry;
+
+	int ret = 0;
+
+	if (plugin->abi_version < CL_PLUGIN_ABI_MIN ||
+	    plugin->abi_version > CL_PLUGIN_ABI_VERSION)
+		return -1;
+
+	pthread_mutex_lock(&cl_registry_lock);
+	entry = cl_registry_find(plugin->scheme);
+	if (entry)
+		entry->plugin = plugin;
+	else
+		ret = cl_registry_add(plugin->scheme, plugin, NULL);
+	pthread_mutex_unlock(&cl_registry_lock);
+
+	return ret;
+}
+
+
+/**
+ * Set deadlines for the transfers of a URI scheme. Deadlines which are
+ * zero in \p timeouts keep their previous setting.
+ *
+ * \param[in] scheme    URI scheme or empty string for all schemes.
+ * \param[in] timeouts  Deadlines in seconds.
+ */
+
+void
+comp_load_set_timeouts(const char *scheme, const struct cl_timeouts *timeouts)
+{
+	struct cl_timeouts_entry *entry = NULL;
+	int n;
+
+	if (strlen(scheme) >= CL_SCHEME_SIZE)
+		return;
+
+	pthread_mutex_lock(&cl_timeouts_lock);
+	for (n = 0; n < cl_timeouts_count; n++)
+		if (!strcmp(cl_timeouts[n].scheme, scheme))
+			entry = &cl_timeouts[n];
+	if (!entry && cl_timeouts_count < CL_MAX_PLUGINS) {
+		entry = &cl_timeouts[cl_timeouts_count++];
+		memset(entry, 0, sizeof(*entry));
+		strcpy(entry->scheme, scheme);
+	}
+	if (entry) {
+		if (timeouts->connect > 0)
+			entry->timeouts.connect = timeouts->connect;
+		if (timeouts->stall > 0)
+			entry->timeouts.stall = timeouts->stall;
+		if (timeouts->total > 0)
+			entry->timeouts.total = timeouts->total;
+	}
+	pthread_mutex_unlock(&cl_timeouts_lock);
+}
+
+
+/**
+ * Complete the deadlines of a request from the settings of its URI
+ * scheme, falling back to the settings for all schemes.
+ *
+ * \param[in,out] req  Component load request.
+ */
+
+static void
+comp_load_deadlines(struct comp_request *req)
+{
+	const struct cl_timeouts *t;
+	size_t len = uri_scheme_length(req->uri);
+	int pass, n;
+
+	pthread_mutex_lock(&cl_timeouts_lock);
+	for (pass = 0; pass < 2; pass++) {
+		for (n = 0; n < cl_timeouts_count; n++) {
+			// scheme specific settings first, then the defaults
+			if (pass == 0 && (!len ||
+			    strlen(cl_timeouts[n].scheme) != len ||
+			    strncmp(cl_timeouts[n].scheme, req->uri, len)))
+				continue;
+			if (pass == 1 && strlen(cl_timeouts[n].scheme))
+				continue;
+			t = &cl_timeouts[n].timeouts;
+			if (!req->timeouts.connect)
+				req->timeouts.connect = t->connect;
+			if (!req->timeouts.stall)
+				req->timeouts.stall = t->stall;
+			if (!req->timeouts.total)
+				req->timeouts.total = t->total;
+		}
+	}
+	pthread_mutex_unlock(&cl_timeouts_lock);
+}
+
+
+/**
+ * Look up plugin for URI scheme. On first use of a scheme the shared
+ * object <tt>cl_<scheme>.so</tt> is loaded from the loader module
+ * directory. The result is cached, including the absence of a plugin.
+ *
+ * \param[in] scheme       URI scheme.
+ * \param[in] defaultpath  sysload installation directory.
+ * \return                 Plugin description or \c NULL if the scheme
+ *                         has to be handled by a loader executable.
+ */
+
+static const struct cl_plugin *
+cl_plugin_lookup(const char *scheme, const char *defaultpath)
+{
+	struct cl_registry_entry *entry;
+	const struct cl_plugin *plugin = NULL;
+	cl_plugin_entry_t plugin_entry;
+	char *path = NULL;
+	void *handle;
+
+	pthread_mutex_lock(&cl_registry_lock);
+	entry = cl_registry_find(scheme);
+	if (entry) {
+		plugin = entry->plugin;
+		pthread_mutex_unlock(&cl_registry_lock);
+		return plugin;
+	}
+
+	cfg_strinit(&path);
+	cfg_strprintf(&path, "%s/%s/cl_%s.so",
+	    defaultpath, COMP_LOAD_MODULE_PATH, scheme);
+	handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (!handle)
+		goto out;
+
+	plugin_entry = (cl_plugin_entry_t) dlsym(handle, CL_PLUGIN_ENTRY);
+	if (plugin_entry)
+		plugin = plugin_entry();
+
+	// refuse plugins built against another ABI or for another scheme
+	if (!plugin || plugin->abi_version < CL_PLUGIN_ABI_MIN ||
+	    plugin->abi_version > CL_PLUGIN_ABI_VERSION ||
+	    strcmp(plugin->scheme, scheme) || !plugin->open ||
+	    !plugin->read || !plugin->close) {
+		dg_printf(DG_VERBOSE, "ignoring loader plugin '%s'\n", path);
+		dlclose(handle);
+		handle = NULL;
+		plugin = NULL;
+	}
+
+ out:
+	if (cl_registry_add(scheme, plugin, handle) && handle) {
+		dlclose(handle);
+		plugin = NULL;
+	}
+	pthread_mutex_unlock(&cl_registry_lock);
+	cfg_strfree(&path);
+
+	return plugin;
+}
+
+
+/**
+ * Ask plugin for validator, size and range support of the source file.
+ * Plugins older than ABI version 2 or without probe function provide no
+ * validator, plugins older than ABI version 4 do not support ranges.
+ *
+ * \param[in]  plugin    Plugin handling the URI scheme.
+ * \param[in]  uri       URI of source file
+ * \param[in]  timeouts  Deadlines of the transfer, passed on to the
+ *                       plugin with every stream.
+ * \param[out] probe     Stream receiving the result. The validator is
+ *                       set to an empty string if no validator is
+ *                       available.
+ */
+
+static void
+comp_load_probe(const struct cl_plugin *plugin, const char *uri,
+    const struct cl_timeouts *timeouts, struct cl_stream *probe)
+{
+	memset(probe, 0, sizeof(*probe));
+	probe->uri = uri;
+	probe->dest_fd = -1;
+	probe->size = -1;
+	probe->length = -1;
+	probe->connect_timeout = timeouts->connect;
+	probe->io_timeout = timeouts->stall;
+	if (plugin->abi_version < 2 || !plugin->probe)
+		return;
+
+	if (plugin->probe(probe)) {
+		probe->validator[0] = '\0';
+		probe->size = -1;
+		probe->ranges = 0;
+		probe->local_path[0] = '\0';
+	}
+	probe->validator[CL_VALIDATOR_SIZE-1] = '\0';
+	if (plugin->abi_version < 4)
+		probe->ranges = 0;
+	if (plugin->abi_version < 5)
+		probe->local_path[0] = '\0';
+	probe->local_path[CL_PATH_SIZE-1] = '\0';
+}
+
+
+/**
+ * Reopen a stream after a transfer error at \c stream->offset for
+ * \c stream->length bytes. Attempts are delayed with exponential backoff
+ * and limited to #CL_RETRIES per transfer. Only sources with range
+ * support and validator are resumed, and only if the validator has not
+ * changed, so data of different versions is never mixed. The stream
+ * must be closed when this function is called.
+ *
+ * \param[in]     plugin   Plugin handling the URI scheme.
+ * \param[in,out] stream   Closed stream with offset and length to
+ *                         resume at. \c errmsg holds the last error.
+ * \param[in]     probe    Result of comp_load_probe().
+ * \param[in,out] retries  Number of attempts made so far.
+ * \param[in]     cancel   Transfer is aborted when set to non-zero.
+ * \param[in]     stop     Optional second cancel flag or \c NULL.
+ * \return                 Zero if the stream is open again, non-zero
+ *                         otherwise (\c stream->errmsg set).
+ */
+
+static int
+comp_load_resume(const struct cl_plugin *plugin, struct cl_stream *stream,
+    const struct cl_stream *probe, int *retries, volatile int *cancel,
+    volatile int *stop)
+{
+	long long delay;
+
+	if (!probe->ranges || !strlen(probe->validator))
+		return -1;
+
+	while (*retries < CL_RETRIES) {
+		delay = (long long) CL_RETRY_DELAY << (*retries)++;
+		syslog(LOG_WARNING, "%s: %s - resuming at byte %lld in %lld ms",
+		    stream->uri, stream->errmsg, stream->offset, delay);
+		for (; delay > 0 && !*cancel && !(stop && *stop);
+		     delay -= CL_CANCEL_POLL)
+			usleep(CL_CANCEL_POLL * 1000);
+		if (*cancel || (stop && *stop)) {
+			snprintf(stream->errmsg, CL_MSG_SIZE, "Cancelled.");
+			return -1;
+		}
+
+		stream->priv = NULL;
+		stream->size = -1;
+		stream->validator[0] = '\0';
+		stream->errmsg[0] = '\0';
+		if (plugin->open(stream))
+			continue;
+		stream->validator[CL_VALIDATOR_SIZE-1] = '\0';
+		if (stream->size == probe->size &&
+		    !strcmp(stream->validator, probe->validator))
+			return 0;
+		plugin->close(stream);
+		snprintf(stream->errmsg, CL_MSG_SIZE,
+		    "Source changed during transfer.");
+		return -1;
+	}
+
+	return -1;
+}
+
+
+/**
+ * Start a decompression process writing to \p out_fd.
+ *
+ * \param[in,out] dec     Decoder.
+ * \param[in]     format  Format of the data.
+ * \param[in]     in_fd   Descriptor of compressed data or -1 to pass the
+ *                        data with comp_load_decoder_write().
+ * \param[in]     out_fd  Descriptor of local copy.
+ * \return        Zero on success, non-zero on error.
+ */
+
+static int
+comp_load_decoder_start(struct cl_decoder *dec, const struct cl_format *format,
+    int in_fd, int out_fd)
+{
+	int sv[2] = { -1, -1 }, devnull;
+
+	// a socket instead of a pipe: MSG_NOSIGNAL avoids SIGPIPE if the
+	// decoder exits early; close-on-exec keeps other loader processes
+	// from holding it open
+	if (in_fd < 0) {
+		if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv))
+			return -1;
+		in_fd = sv[0];
+	}
+	devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	dec->pid = fork();
+	if (dec->pid == 0) {
+		sigset_t unblocked;
+
+		// signals blocked in preload threads are unblocked for exec
+		sigemptyset(&unblocked);
+		sigprocmask(SIG_SETMASK, &unblocked, NULL);
+		dup2(in_fd, 0);
+		dup2(out_fd, 1);
+		if (devnull >= 0)
+			dup2(devnull, 2);
+		execvp(format->argv[0], format->argv);
+		_exit(127);
+	}
+	if (devnull >= 0)
+		close(devnull);
+	if (sv[0] >= 0)
+		close(sv[0]);
+	if (dec->pid < 0) {
+		if (sv[1] >= 0)
+			close(sv[1]);
+		return -1;
+	}
+	dec->fd = sv[1];
+	dec->format = format;
+	dg_printf(DG_VERBOSE, "decompressing with %s\n", format->name);
+
+	return 0;
+}
+
+
+/**
+ * Wait for the decompression process to finish. Its input is closed
+ * first, so the process also ends if the transfer failed.
+ *
+ * \param[in,out] dec  Decoder.
+ * \return        Zero if no decoder was running or the data has been
+ *                decompressed completely, non-zero otherwise.
+ */
+
+static int
+comp_load_decoder_finish(struct cl_decoder *dec)
+{
+	int status;
+
+	if (!dec->format)
+		return 0;
+	if (dec->fd >= 0)
+		close(dec->fd);
+	dec->format = NULL;
+	while (waitpid(dec->pid, &status, 0) < 0)
+		if (errno != EINTR)
+			return -1;
+
+	return !WIFEXITED(status) || WEXITSTATUS(status);
+}
+
+
+/**
+ * Determine format of a source from its first bytes and start a decoder
+ * if it is compressed.
+ *
+ * \param[in,out] dec     Decoder.
+ * \param[in,out] stream  Open stream with local copy.
+ * \param[in]     data    First bytes of source.
+ * \param[in]     len     Number of bytes in \p data.
+ * \return        Zero on success, non-zero on error (\c stream->errmsg
+ *                set).
+ */
+
+static int
+comp_load_decoder_check(struct cl_decoder *dec, struct cl_stream *stream,
+    const char *data, size_t len)
+{
+	int i;
+
+	dec->checked = 1;
+	for (i = 0; i < sizeof(cl_formats) / sizeof(cl_formats[0]); i++) {
+		if (len < cl_formats[i].magic_len ||
+		    memcmp(data, cl_formats[i].magic, cl_formats[i].magic_len))
+			continue;
+		if (comp_load_decoder_start(dec, &cl_formats[i], -1,
+		    stream->dest_fd)) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Cannot start %s - %s.", cl_formats[i].name,
+			    strerror(errno));
+			return -1;
+		}
+		break;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Pass data to the decompression process.
+ *
+ * \param[in,out] dec     Running decoder.
+ * \param[in,out] stream  Open stream for messages.
+ * \param[in]     data    Compressed data.
+ * \param[in]     len     Number of bytes in \p data.
+ * \return        Zero on success, non-zero on error (\c stream->errmsg
+ *                set).
+ */
+
+static int
+comp_load_decoder_write(struct cl_decoder *dec, struct cl_stream *stream,
+    const char *data, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = send(dec->fd, data, len, MSG_NOSIGNAL);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Error decompressing '%s' with %s.", stream->uri,
+			    dec->format->name);
+			return -1;
+		}
+		data += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Decompress a local copy written by a loader module executable in
+ * place, if it is compressed.
+ *
+ * \param[in]  dest    Pathname of local copy.
+ * \param[out] errmsg  Accumulation string for error messages.
+ * \return     Zero on success, non-zero on error.
+ */
+
+static int
+comp_load_decode_file(const char *dest, char **errmsg)
+{
+	struct cl_decoder dec;
+	unsigned char magic[CL_MAGIC_SIZE];
+	int in_fd, out_fd, i, ret = 0;
+	ssize_t len;
+
+	in_fd = open(dest, O_RDONLY | O_CLOEXEC);
+	if (in_fd < 0)
+		return 0;
+	len = read(in_fd, magic, sizeof(magic));
+	for (i = 0; i < sizeof(cl_formats) / sizeof(cl_formats[0]); i++)
+		if (len >= (ssize_t) cl_formats[i].magic_len &&
+		    !memcmp(magic, cl_formats[i].magic,
+		    cl_formats[i].magic_len))
+			break;
+	if (i == sizeof(cl_formats) / sizeof(cl_formats[0]) ||
+	    lseek(in_fd, 0, SEEK_SET)) {
+		close(in_fd);
+		return 0;
+	}
+
+	// the open descriptor keeps the compressed data
+	unlink(dest);
+	out_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	memset(&dec, 0, sizeof(dec));
+	dec.fd = -1;
+	if (out_fd < 0 || comp_load_decoder_start(&dec, &cl_formats[i],
+	    in_fd, out_fd) || comp_load_decoder_finish(&dec)) {
+		cfg_strprintf(errmsg, "Error decompressing '%s' with %s.",
+		    dest, cl_formats[i].name);
+		unlink(dest);
+		ret = -1;
+	}
+	if (out_fd >= 0)
+		close(out_fd);
+	close(in_fd);
+
+	return ret;
+}
+
+
+/**
+ * Check whether a command can be executed from one of the directories
+ * of \c PATH.
+ *
+ * \param[in] name  Command name.
+ * \return    Non-zero if the command was found.
+ */
+
+static int
+comp_load_find_command(const char *name)
+{
+	const char *path = getenv("PATH"), *end;
+	char *file = NULL;
+	int found = 0;
+
+	if (!path)
+		path = "/bin:/usr/bin";
+	for (; !found && *path; path = *end ? end + 1 : end) {
+		end = strchr(path, ':');
+		if (!end)
+			end = path + strlen(path);
+		cfg_strprintf(&file, "%.*s/%s", (int) (end - path), path,
+		    name);
+		found = !access(file, X_OK);
+		cfg_strfree(&file);
+	}
+
+	return found;
+}
+
+
+/**
+ * Check that the decompression tools are present, so that a setting
+ * which asks for decompression is rejected when it is read and not
+ * in the middle of a transfer.
+ *
+ * \param[in]  format  Name of compressed format or \c NULL for all
+ *                     formats.
+ * \param[out] errmsg  Initialized string receiving an error message
+ *                     naming the missing tools.
+ * \return     Zero if all tools are present, non-zero otherwise.
+ */
+
+int
+comp_load_check_decoders(const char *format, char **errmsg)
+{
+	char *missing = NULL;
+	int i, ret = 0;
+
+	cfg_strinit(&missing);
+	for (i = 0; i < sizeof(cl_formats) / sizeof(cl_formats[0]); i++)
+		if ((!format || !strcmp(format, cl_formats[i].name)) &&
+		    !comp_load_find_command(cl_formats[i].argv[0])) {
+			if (*missing)
+				cfg_strcat(&missing, ", ");
+			cfg_strcat(&missing, cl_formats[i].argv[0]);
+		}
+	if (*missing) {
+		cfg_strprintf(errmsg, "Decompression tool(s) %s not found "
+		    "in the sysload initramfs", missing);
+		ret = -1;
+	}
+	cfg_strfree(&missing);
+
+	return ret;
+}
+
+
+/**
+ * Copy function for plugins which provide \c copy only to read the
+ * whole chunk with one \c read call, e.g. to turn it into few large
+ * requests to the source. The chunk is read into a buffer of the
+ * plugin which grows to the size of the largest chunk.
+ *
+ * \param[in,out] stream       Open stream.
+ * \param[in]     read         Read function of the plugin.
+ * \param[in,out] buffer       Dynamically allocated buffer or \c NULL.
+ * \param[in,out] buffer_size  Size of \p buffer.
+ * \param[in]     fd           Descriptor of local copy.
+ * \param[in]     offset       Position in local copy.
+ * \param[in]     count        Maximum number of bytes.
+ * \return                     Number of bytes transferred, zero at end
+ *                             of file, negative value on error.
+ */
+
+ssize_t
+comp_load_copy_buffered(struct cl_stream *stream,
+    ssize_t (*read)(struct cl_stream *, void *, size_t), char **buffer,
+    size_t *buffer_size, int fd, long long offset, size_t count)
+{
+	ssize_t ret, written, done;
+
+	if (*buffer_size < count) {
+		free(*buffer);
+		*buffer = malloc(count);
+		MEM_ASSERT(*buffer);
+		*buffer_size = count;
+	}
+	ret = read(stream, *buffer, count);
+	for (done = 0; ret > 0 && done < ret; done += written) {
+		written = pwrite(fd, *buffer + done, ret - done,
+		    offset + done);
+		if (written < 0 && errno == EINTR)
+			written = 0;
+		else if (written < 0) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Cannot write '%s' - %s.", stream->dest,
+			    strerror(errno));
+			return -1;
+		}
+	}
+
+	return ret;
+}
+
+
+/**
+ * Transfer next chunk of an open stream to \c stream->dest_fd at
+ * \c offset. Plugins providing \c copy move the data themselves,
+ * e.g. with \c copy_file_range(), otherwise it is read into \c buffer
+ * and written from there. With an enabled decoder the data always goes
+ * through \c buffer, compressed data is passed to the decoder. The same
+ * holds for a digest, which is computed over the data of the source.
+ *
+ * \param[in]     plugin  Plugin handling the URI scheme.
+ * \param[in,out] stream  Open stream.
+ * \param[in]     buffer  Copy buffer of #CL_BUFFER_SIZE bytes.
+ * \param[in]     offset  Position in local copy.
+ * \param[in]     count   Maximum number of bytes to transfer.
+ * \param[in,out] dec     Decoder or \c NULL.
+ * \param[in,out] sum     Digest of the source or \c NULL.
+ * \return                Number of bytes transferred, zero at end of
+ *                        data, -1 on source error and -2 if the local
+ *                        copy cannot be written (\c stream->errmsg set).
+ */
+
+static ssize_t
+comp_load_chunk(const struct cl_plugin *plugin, struct cl_stream *stream,
+    char *buffer, long long offset, size_t count, struct cl_decoder *dec,
+    struct sha256 *sum)
+{
+	ssize_t ret, written, done;
+
+	if (dec && !dec->enabled)
+		dec = NULL;
+	if (plugin->abi_version >= 5 && plugin->copy && !dec && !sum) {
+		if (count > CL_COPY_SIZE)
+			count = CL_COPY_SIZE;
+		ret = plugin->copy(stream, stream->dest_fd, offset, count);
+		return ret < 0 ? -1 : ret;
+	}
+
+	if (count > CL_BUFFER_SIZE)
+		count = CL_BUFFER_SIZE;
+	ret = plugin->read(stream, buffer, count);
+	if (ret <= 0)
+		return ret < 0 ? -1 : 0;
+
+	if (dec && !dec->checked) {
+		// the format is known from the first bytes
+		written = 0;
+		while (ret < CL_MAGIC_SIZE && count > CL_MAGIC_SIZE &&
+		    (written = plugin->read(stream, buffer + ret,
+		    count - ret)) > 0)
+			ret += written;
+		if (ret < CL_MAGIC_SIZE && written < 0)
+			return -1;
+		if (comp_load_decoder_check(dec, stream, buffer, ret))
+			return -2;
+	}
+	if (sum && sha256_update(sum, buffer, ret)) {
+		snprintf(stream->errmsg, CL_MSG_SIZE,
+		    "Cannot compute digest of '%s'.", stream->uri);
+		return -2;
+	}
+	if (dec && dec->format)
+		return comp_load_decoder_write(dec, stream, buffer, ret) ?
+		    -2 : ret;
+
+	for (done = 0; done < ret; done += written) {
+		written = pwrite(stream->dest_fd, buffer + done, ret - done,
+		    offset + done);
+		if (written < 0 && errno == EINTR)
+			written = 0;
+		else if (written < 0) {
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Cannot write '%s' - %s.", stream->dest,
+			    strerror(errno));
+			return -2;
+		}
+	}
+
+	return ret;
+}
+
+
+/**
+ * Copy file specified by a URI to a local file using an in-process
+ * loader plugin. A transfer interrupted by an error is resumed at the
+ * last byte written if the source supports it.
+ *
+ * \param[in]   plugin      Plugin handling the URI scheme.
+ * \param[in]   probe       Result of comp_load_probe().
+ * \param[in]   dest        Pathname of local copy
+ * \param[in]   decompress  Decompress compressed sources.
+ * \param[in]   size        Expected size of the source, used if the
+ *                          plugin does not report it, 0 if unknown.
+ * \param[out]  digest      SHA-256 digest of the source or \c NULL if
+ *                          not needed.
+ * \param[out]  info        Accumulation string for informational
+ *                          messages.
+ * \param[out]  errmsg      Accumulation string for error messages.
+ * \param[in]   cancel      Transfer is aborted when set to non-zero.
+ * \param[out]  loaded      Bytes transferred, updated as the transfer
+ *                          proceeds.
+ * \return  On success zero is returned. #CL_UNREACHABLE if the plugin
+ *          could not contact the source, -1 on other errors.
+ */
+
+static int
+comp_load_plugin(const struct cl_plugin *plugin,
+    const struct cl_stream *probe, const char *dest, int decompress,
+    long long size, unsigned char *digest, char **info, char **errmsg,
+    volatile int *cancel, volatile long long *loaded)
+{
+	const struct cl_format *format;
+	struct cl_decoder dec;
+	struct sha256 sum;
+	struct cl_stream stream;
+	char *buffer = NULL;
+	ssize_t count;
+	long long total = 0;
+	int ret = -1, retries = 0;
+
+	memset(&stream, 0, sizeof(stream));
+	stream.uri = probe->uri;
+	stream.dest = dest;
+	stream.size = -1;
+	stream.length = -1;
+	stream.connect_timeout = probe->connect_timeout;
+	stream.io_timeout = probe->io_timeout;
+	memset(&dec, 0, sizeof(dec));
+	dec.enabled = decompress;
+
+	stream.dest_fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (stream.dest_fd < 0) {
+		cfg_strprintf(errmsg, "Cannot create '%s' - %s.",
+		    dest, strerror(errno));
+		return -1;
+	}
+	if (digest)
+		sha256_init(&sum);
+
+	if (plugin->open(&stream))
+		goto out_close;
+
+	// reserve space up front if the plugin knows the size, which
+	// avoids fragmentation and fails early if the filesystem is full;
+	// the size of decompressed data is not known
+	if (stream.size > 0)
+		size = stream.size;
+	if (size > 0 && !decompress) {
+		errno = posix_fallocate(stream.dest_fd, 0, size);
+		if (errno == ENOSPC) {
+			snprintf(stream.errmsg, CL_MSG_SIZE,
+			    "Cannot write '%s' - %s.", dest, strerror(errno));
+			goto out_plugin;
+		}
+	}
+
+	buffer = malloc(CL_BUFFER_SIZE);
+	MEM_ASSERT(buffer);
+
+	while ((count = comp_load_chunk(plugin, &stream, buffer, total,
+		    CL_COPY_SIZE, &dec, digest ? &sum : NULL)) != 0) {
+		if (count == -2)
+			goto out_plugin;
+		if (count < 0) {
+			plugin->close(&stream);
+			stream.offset = total;
+			if (comp_load_resume(plugin, &stream, probe, &retries,
+				cancel, NULL))
+				goto out_free;
+			continue;
+		}
+		if (*cancel) {
+			snprintf(stream.errmsg, CL_MSG_SIZE, "Cancelled.");
+			goto out_plugin;
+		}
+		total += count;
+		*loaded = total;
+	}
+	ret = 0;
+	format = dec.format;
+	if (comp_load_decoder_finish(&dec)) {
+		snprintf(stream.errmsg, CL_MSG_SIZE,
+		    "Error decompressing '%s' with %s.", probe->uri,
+		    format->name);
+		ret = -1;
+	} else if (total < size && !decompress &&
+	    ftruncate(stream.dest_fd, total)) {
+		snprintf(stream.errmsg, CL_MSG_SIZE,
+		    "Cannot write '%s' - %s.", dest, strerror(errno));
+		ret = -1;
+	} else if (digest && sha256_final(&sum, digest)) {
+		snprintf(stream.errmsg, CL_MSG_SIZE,
+		    "Cannot compute digest of '%s'.", probe->uri);
+		ret = -1;
+	}
+
+ out_plugin:
+	plugin->close(&stream);
+ out_free:
+	free(buffer);
+	comp_load_decoder_finish(&dec);
+ out_close:
+	if (digest)
+		sha256_release(&sum);
+	if (close(stream.dest_fd) && !ret) {
+		snprintf(stream.errmsg, CL_MSG_SIZE,
+		    "Cannot write '%s' - %s.", dest, strerror(errno));
+		ret = -1;
+	}
+	if (ret) {
+		unlink(dest);
+		if (!strlen(stream.errmsg))
+			snprintf(stream.errmsg, CL_MSG_SIZE,
+			    "Error loading '%s'.", probe->uri);
+		if (plugin->abi_version >= 7 && stream.unreachable)
+			ret = CL_UNREACHABLE;
+	} else if (retries)
+		snprintf(stream.info, CL_MSG_SIZE,
+		    "Transfer resumed %d time(s).", retries);
+	stream.info[CL_MSG_SIZE-1] = '\0';
+	stream.errmsg[CL_MSG_SIZE-1] = '\0';
+	cfg_strcat(info, stream.info);
+	cfg_strcat(errmsg, stream.errmsg);
+
+	return ret;
+}
+
+
+/**
+ * One segment of a segmented transfer.
+ */
+
+struct cl_segment {
+	const struct cl_plugin *plugin; //!< plugin handling the URI scheme
+	const struct cl_stream *probe;  //!< result of comp_load_probe()
+	const char *dest;               //!< pathname of local copy
+	int fd;                         //!< open descriptor of local copy
+	long long offset;               //!< first byte of segment
+	long long length;               //!< number of bytes in segment
+	volatile int *cancel;           //!< cancel flag of the request
+	volatile int *failed;           //!< set if any segment failed
+	volatile long long *loaded;     //!< bytes written by all segments,
+	                                //!< under \c lock
+	long long done;                 //!< bytes written, under \c lock
+	pthread_mutex_t *lock;          //!< protects \c done
+	pthread_cond_t *progress;       //!< signalled when \c done grows
+	int ret;                        //!< result of transfer
+	char errmsg[CL_MSG_SIZE];       //!< error message
+	int started;                    //!< thread has been created
+	pthread_t thread;               //!< thread handling the segment
+};
+
+
+/**
+ * Thread function transferring one segment. The data is written at its
+ * offset in the local copy. A failure stops all other segments. The
+ * progress is published in \c done for comp_load_follow().
+ *
+ * \param[in,out] arg  Pointer to segment.
+ * \return             Always \c NULL.
+ */
+
+static void *
+comp_load_segment(void *arg)
+{
+	struct cl_segment *seg = arg;
+	struct cl_stream stream;
+	char *buffer = NULL;
+	ssize_t count;
+	long long total = 0;
+	int retries = 0;
+
+	seg->ret = -1;
+	memset(&stream, 0, sizeof(stream));
+	stream.uri = seg->probe->uri;
+	stream.dest = seg->dest;
+	stream.dest_fd = seg->fd;
+	stream.size = -1;
+	stream.offset = seg->offset;
+	stream.length = seg->length;
+	stream.connect_timeout = seg->probe->connect_timeout;
+	stream.io_timeout = seg->probe->io_timeout;
+
+	if (seg->plugin->open(&stream))
+		goto out;
+
+	// all segments must come from the same version of the source
+	stream.validator[CL_VALIDATOR_SIZE-1] = '\0';
+	if (stream.size != seg->probe->size ||
+	    (strlen(stream.validator) &&
+	    strcmp(stream.validator, seg->probe->validator))) {
+		snprintf(stream.errmsg, CL_MSG_SIZE,
+		    "Source changed during transfer.");
+		goto out_plugin;
+	}
+
+	buffer = malloc(CL_BUFFER_SIZE);
+	MEM_ASSERT(buffer);
+
+	while (total < seg->length) {
+		if (*seg->cancel || *seg->failed) {
+			snprintf(stream.errmsg, CL_MSG_SIZE, "Cancelled.");
+			goto out_plugin;
+		}
+		count = comp_load_chunk(seg->plugin, &stream, buffer,
+		    seg->offset + total, seg->length - total, NULL, NULL);
+		if (count == -2)
+			goto out_plugin;
+		if (count <= 0) {
+			if (count == 0)
+				snprintf(stream.errmsg, CL_MSG_SIZE,
+				    "Unexpected end of file.");
+			seg->plugin->close(&stream);
+			stream.offset = seg->offset + total;
+			stream.length = seg->length - total;
+			if (comp_load_resume(seg->plugin, &stream, seg->probe,
+				&retries, seg->cancel, seg->failed))
+				goto out_free;
+			continue;
+		}
+		total += count;
+		pthread_mutex_lock(seg->lock);
+		seg->done = total;
+		*seg->loaded += count;
+		pthread_cond_broadcast(seg->progress);
+		pthread_mutex_unlock(seg->lock);
+	}
+	seg->ret = 0;
+
+ out_plugin:
+	seg->plugin->close(&stream);
+ out_free:
+	free(buffer);
+ out:
+	if (seg->ret) {
+		*seg->failed = 1;
+		stream.errmsg[CL_MSG_SIZE-1] = '\0';
+		strcpy(seg->errmsg, stream.errmsg);
+	}
+	pthread_mutex_lock(seg->lock);
+	pthread_cond_broadcast(seg->progress);
+	pthread_mutex_unlock(seg->lock);
+
+	return NULL;
+}
+
+
+/**
+ * Compute the digest of a segmented transfer while it is running. The
+ * segments are hashed in order, each as far as it has been written, so
+ * the data is read back from the page cache shortly after it arrived.
+ *
+ * \param[in]  seg     Started segments.
+ * \param[in]  count   Number of segments.
+ * \param[in]  dest    Pathname of local copy.
+ * \param[out] digest  SHA-256 digest of the source.
+ * \return     Zero on success, non-zero if a segment failed or the data
+ *             could not be hashed.
+ */
+
+static int
+comp_load_follow(struct cl_segment *seg, int count, const char *dest,
+    unsigned char *digest)
+{
+	struct sha256 sum;
+	char *buffer;
+	long long pos, avail;
+	ssize_t len;
+	int fd, i, ret = -1;
+
+	fd = open(dest, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	buffer = malloc(CL_BUFFER_SIZE);
+	MEM_ASSERT(buffer);
+	sha256_init(&sum);
+
+	for (i = 0; i < count; i++) {
+		for (pos = 0; pos < seg[i].length; pos += len) {
+			pthread_mutex_lock(seg[i].lock);
+			while (seg[i].done <= pos && !*seg[i].failed)
+				pthread_cond_wait(seg[i].progress, seg[i].lock);
+			avail = *seg[i].failed ? 0 : seg[i].done - pos;
+			pthread_mutex_unlock(seg[i].lock);
+			if (avail <= 0)
+				goto out;
+			if (avail > CL_BUFFER_SIZE)
+				avail = CL_BUFFER_SIZE;
+			len = pread(fd, buffer, avail, seg[i].offset + pos);
+			if (len < 0 && errno == EINTR)
+				len = 0;
+			else if (len <= 0 || sha256_update(&sum, buffer, len))
+				goto out;
+		}
+	}
+	ret = sha256_final(&sum, digest);
+
+ out:
+	sha256_release(&sum);
+	free(buffer);
+	close(fd);
+
+	return ret;
+}
+
+
+/**
+ * Copy file specified by a URI to a local file in parallel segments
+ * using an in-process loader plugin which supports partial opens.
+ *
+ * \param[in]   plugin  Plugin handling the URI scheme.
+ * \param[in]   probe   Result of comp_load_probe() with size and
+ *                      validator of the source.
+ * \param[in]   count   Number of segments.
+ * \param[in]   dest    Pathname of local copy
+ * \param[out]  digest  SHA-256 digest of the source or \c NULL if not
+ *                      needed.
+ * \param[out]  errmsg  Accumulation string for error messages.
+ * \param[in]   cancel  Transfer is aborted when set to non-zero.
+ * \param[out]  loaded  Bytes transferred, updated as the transfer
+ *                      proceeds.
+ * \return  On success zero is returned. On error the return value in
+ *          non-zero.
+ */
+
+static int
+comp_load_segmented(const struct cl_plugin *plugin,
+    const struct cl_stream *probe, int count, const char *dest,
+    unsigned char *digest, char **errmsg, volatile int *cancel,
+    volatile long long *loaded)
+{
+	pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t progress = PTHREAD_COND_INITIALIZER;
+	struct cl_segment *seg;
+	volatile int failed = 0;
+	int fd, i, first = -1, ret = 0, unhashed = 0;
+
+	fd = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		cfg_strprintf(errmsg, "Cannot create '%s' - %s.",
+		    dest, strerror(errno));
+		return -1;
+	}
+	errno = posix_fallocate(fd, 0, probe->size);
+	if (errno && ftruncate(fd, probe->size)) {
+		cfg_strprintf(errmsg, "Cannot write '%s' - %s.",
+		    dest, strerror(errno));
+		close(fd);
+		unlink(dest);
+		return -1;
+	}
+
+	seg = calloc(count, sizeof(*seg));
+	MEM_ASSERT(seg);
+	for (i = 0; i < count; i++) {
+		seg[i].plugin = plugin;
+		seg[i].probe = probe;
+		seg[i].dest = dest;
+		seg[i].fd = fd;
+		seg[i].offset = probe->size * i / count;
+		seg[i].length = probe->size * (i + 1) / count - seg[i].offset;
+		seg[i].cancel = cancel;
+		seg[i].failed = &failed;
+		seg[i].loaded = loaded;
+		seg[i].lock = &lock;
+		seg[i].progress = &progress;
+	}
+	dg_printf(DG_VERBOSE, "loading '%s' in %d segments\n", probe->uri,
+	    count);
+	for (i = 0; i < count; i++) {
+		if (!pthread_create(&seg[i].thread, NULL, comp_load_segment,
+			&seg[i]))
+			seg[i].started = 1;
+		else
+			comp_load_segment(&seg[i]);
+	}
+	// hash while the segments are transferred, stop them if it fails
+	if (digest && comp_load_follow(seg, count, dest, digest) &&
+	    !failed) {
+		unhashed = 1;
+		failed = 1;
+	}
+	for (i = 0; i < count; i++)
+		if (seg[i].started)
+			pthread_join(seg[i].thread, NULL);
+
+	// report the segment which caused the failure, not the ones it
+	// stopped
+	for (i = 0; i < count; i++)
+		if (seg[i].ret && (first < 0 ||
+		    !strcmp(seg[first].errmsg, "Cancelled.")))
+			first = i;
+	if (unhashed) {
+		cfg_strprintf(errmsg, "Cannot compute digest of '%s'.",
+		    probe->uri);
+		ret = -1;
+	} else if (first >= 0) {
+		cfg_strcat(errmsg, seg[first].errmsg);
+		ret = -1;
+	}
+
+	if (close(fd) && !ret) {
+		cfg_strprintf(errmsg, "Cannot write '%s' - %s.",
+		    dest, strerror(errno));
+		ret = -1;
+	}
+	if (ret)
+		unlink(dest);
+	free(seg);
+
+	return ret;
+}
+
+
+/**
+ * Wait for a loader module to exit. If the cancel flag is set, the
+ * process group of the module is terminated, and killed if it does not
+ * exit within #CL_KILL_DELAY milliseconds. A module which does not even
+ * exit then, e.g. because it hangs in a mount, is left behind.
+ *
+ * \param[in]  pid     Process id of the loader module.
+ * \param[out] status  Exit status of the module.
+ * \param[in]  cancel  Module is terminated when set to non-zero.
+ * \return     Zero if the module has exited, non-zero otherwise.
+ */
+
+static int
+comp_load_exec_wait(pid_t pid, int *status, volatile int *cancel)
+{
+	long delay = 1, waited = 0;
+	int signalled = 0;
+	pid_t ret;
+
+	while ((ret = waitpid(pid, status, WNOHANG)) == 0) {
+		if (*cancel) {
+			if (!signalled) {
+				kill(-pid, SIGTERM);
+				signalled = SIGTERM;
+			} else if (signalled == SIGTERM &&
+			    waited >= CL_KILL_DELAY) {
+				kill(-pid, SIGKILL);
+				signalled = SIGKILL;
+			} else if (waited >= 2 * CL_KILL_DELAY) {
+				syslog(LOG_WARNING, "loader module %d does not "
+				    "exit", (int) pid);
+				return -1;
+			}
+			waited += delay;
+		}
+		// exiting modules are noticed quickly, hanging ones are
+		// checked every #CL_CANCEL_POLL milliseconds
+		usleep(delay * 1000);
+		if (delay < CL_CANCEL_POLL)
+			delay *= 2;
+	}
+
+	return ret < 0 ? -1 : 0;
+}
+
+
+/**
+ * Copy file specified by a URI to a local file by executing the loader
+ * module executable <tt>cl_<scheme></tt>. The module runs in its own
+ * process group, so that it can be terminated together with the
+ * programs it started.
  *
+ * \param[in]   module  Pathname of loader module.
  * \param[in]   dest    Pathname of local copy
  * \param[in]   uri     URI of source file
- * \param[out]  info    Dynamically allocated buffer with informational
- *                      messages from loader module. If set to \p NULL no
- *                      memory is allocated.
- * \param[out]  errmsg  Dynamically allocated buffer with error messages
- *                      from loader module.If set to \p NULL no memory is
- *                      allocated.
- * \return  On success zero is returned. On error the return value in non-zero.
+ * \param[out]  info    Accumulation string for informational messages.
+ * \param[out]  errmsg  Accumulation string for error messages.
+ * \param[in]   cancel  Loader module is terminated when set to non-zero.
+ * \param[out]  loaded  Size of the local copy, updated as the module
+ *                      writes it.
+ * \return  On success zero is returned. #CL_UNREACHABLE if the module
+ *          exits with #CL_EXIT_UNREACHABLE, -1 on other errors.
  */
 
-int
-comp_load(const char *dest, const char *uri, char **info, char **errmsg)
+static int
+comp_load_exec(const char *module, const char *dest, const char *uri,
+    char **info, char **errmsg, volatile int *cancel,
+    volatile long long *loaded)
 {
-	char *colon_ptr = NULL, *uri_scheme = NULL, *module = NULL;
-	char *int_info = NULL, *int_errmsg = NULL, *defaultpath = NULL;
 	int fd_stdout[2], fd_stderr[2], read_flags = 0x0, ret;
+	extern char **environ;
+	char **env = environ;
+	struct uri parsed;
+	struct stat st;
 	pid_t pid;
 	fd_set read_set;
+	struct timeval timeout;
 
-	cfg_strinit(&module);
-	cfg_strinit(&int_info);
-	cfg_strinit(&int_errmsg);
-	cfg_strinit(&defaultpath);
-
-	// extract URI scheme to identify loader module
-	if (verify_uri_scheme(uri)) {
-		cfg_strcpy(&int_errmsg, "Invalid URI scheme.");
-		ret = -1;
-		goto cleanup;
-	}
-	colon_ptr = strchr(uri, ':');
-	cfg_strinit(&uri_scheme);
-	cfg_strncpy(&uri_scheme, uri, colon_ptr-uri);
-
-	// try to get our installation directory out of CFG_PATH environment
-	// variable, otherwise use default path
-	cfg_get_env_str(CFG_PATH, &defaultpath);
-	if (strlen(defaultpath) == 0) {
-		cfg_strcpy(&defaultpath, CFG_DEFAULTPATH);
+	// pass the parsed URI, modules then need not split it themselves;
+	// the environment is built before fork() as other threads may
+	// hold the malloc lock
+	if (!uri_parse(&parsed, uri)) {
+		if (!uri_check_device(&parsed))
+			uri_export(&parsed, uri, &env);
+		uri_free(&parsed);
 	}
-	cfg_strprintf(&module, "%s/%s/cl_%s",
-	    defaultpath, COMP_LOAD_MODULE_PATH, uri_scheme);
-	cfg_strfree(&uri_scheme);
 
 	// fork loader module
 	pipe(fd_stdout);
@@ -134,30 +1394,53 @@ comp_load(const char *dest, const char *uri, char **info, char **errmsg)
 	pid = fork();
 	if (pid == 0)
 	{
+		sigset_t unblocked;
+
+		// signals blocked in preload threads are unblocked for exec
+		sigemptyset(&unblocked);
+		sigprocmask(SIG_SETMASK, &unblocked, NULL);
+		setpgid(0, 0);
 		close(fd_stdout[0]);
 		close(fd_stderr[0]);
 		dup2(fd_stdout[1], 1);
 		dup2(fd_stderr[1], 2);
-		execl(module, module, dest, uri, NULL);
+		execle(module, module, dest, uri, NULL, env);
 		fprintf(stderr, "Error executing loader module '%s' - %s.",
 		    module, strerror(errno));
 		_exit(127);
 	}
+	// also in the parent, the group may be signalled before the
+	// child ran
+	if (pid > 0)
+		setpgid(pid, pid);
 	close(fd_stdout[1]);
 	close(fd_stderr[1]);
+	if (env != environ)
+		uri_export_free(env);
 
 	// read loader module output
 	FD_ZERO(&read_set);
 	FD_SET(fd_stdout[0], &read_set);
 	FD_SET(fd_stderr[0], &read_set);
 	do {
-		select(FD_SETSIZE, &read_set, NULL, NULL, NULL);
+		timeout.tv_sec = 0;
+		timeout.tv_usec = CL_CANCEL_POLL * 1000;
+		if (select(FD_SETSIZE, &read_set, NULL, NULL, &timeout) <= 0)
+			FD_ZERO(&read_set);
+		// progress of the module is seen in the size of its output
+		if (stat(dest, &st) == 0 && st.st_size != *loaded)
+			*loaded = st.st_size;
+		if (*cancel) {
+			// stop reading, the module may have left children
+			// holding the pipes open
+			break;
+		}
 		if (FD_ISSET(fd_stdout[0], &read_set)) {
-			if (read_to_string(fd_stdout[0], &int_info))
+			if (read_to_string(fd_stdout[0], info))
 				read_flags |= 0x01;
 		}
 		if (FD_ISSET(fd_stderr[0], &read_set)) {
-			if (read_to_string(fd_stderr[0], &int_errmsg))
+			if (read_to_string(fd_stderr[0], errmsg))
 				read_flags |= 0x02;
 		}
 		FD_ZERO(&read_set);
@@ -166,22 +1449,686 @@ comp_load(const char *dest, const char *uri, char **info, char **errmsg)
 		if (!(read_flags & 0x02))
 			FD_SET(fd_stderr[0], &read_set);
 	} while (read_flags != 0x03);
-	wait4(pid, &ret, 0, NULL);
-	if (WIFEXITED(ret) && WEXITSTATUS(ret) == 0)
+	close(fd_stdout[0]);
+	close(fd_stderr[0]);
+	if (pid <= 0 || comp_load_exec_wait(pid, &ret, cancel) || *cancel)
+		ret = -1;
+	else if (WIFEXITED(ret) && WEXITSTATUS(ret) == 0)
 		ret = 0;
+	else if (WIFEXITED(ret) && WEXITSTATUS(ret) == CL_EXIT_UNREACHABLE)
+		ret = CL_UNREACHABLE;
 	else
 		ret = -1;
+	// never leave partial output behind
+	if (ret)
+		unlink(dest);
+	if (*cancel)
+		cfg_strcpy(errmsg, "Cancelled.");
+
+	return ret;
+}
+
+
+/**
+ * Determine number of parallel segments for a transfer. Segmentation
+ * requires a plugin supporting partial opens and a source of known
+ * size holding at least two segments of the minimum size.
+ *
+ * \param[in]  req    Component load request.
+ * \param[in]  probe  Result of comp_load_probe().
+ * \return            Number of segments, one for a sequential transfer.
+ */
+
+static int
+comp_load_segments(const struct comp_request *req,
+    const struct cl_stream *probe)
+{
+	long long segment_size, count;
+	int segments;
+
+	segments = req->segments > 0 ? req->segments : CL_SEGMENTS_DEFAULT;
+	if (segments > CL_SEGMENTS_MAX)
+		segments = CL_SEGMENTS_MAX;
+	segment_size = req->segment_size > 0 ? req->segment_size :
+	    CL_SEGMENT_SIZE_DEFAULT;
+
+	if (!probe->ranges || probe->size <= 0)
+		return 1;
+	count = probe->size / segment_size;
+	if (count < segments)
+		segments = count;
+
+	return segments > 1 ? segments : 1;
+}
+
+
+/**
+ * Compare the digest of a local copy with the expected digest. A copy
+ * which does not match is removed.
+ *
+ * \param[in]  dest      Pathname of local copy.
+ * \param[in]  expected  Expected SHA-256 digest.
+ * \param[in]  digest    Digest computed during the transfer or \c NULL
+ *                       to compute it from \p dest.
+ * \param[out] errmsg    Accumulation string for error messages.
+ * \return     Zero if the digests match, non-zero otherwise.
+ */
+
+static int
+comp_load_verify(const char *dest, const unsigned char *expected,
+    const unsigned char *digest, char **errmsg)
+{
+	unsigned char computed[SHA256_SIZE];
+	char hex[2][SHA256_HEX_SIZE];
+
+	if (!digest) {
+		if (sha256_file(dest, computed)) {
+			cfg_strprintf(errmsg, "Cannot compute digest of "
+			    "'%s'.", dest);
+			unlink(dest);
+			return -1;
+		}
+		digest = computed;
+	}
+	sha256_format(expected, hex[0]);
+	sha256_format(digest, hex[1]);
+	if (memcmp(digest, expected, SHA256_SIZE)) {
+		cfg_strprintf(errmsg, "SHA-256 digest mismatch, expected %s, "
+		    "got %s.", hex[0], hex[1]);
+		unlink(dest);
+		return -1;
+	}
+	dg_printf(DG_VERBOSE, "sha256 of '%s' verified: %s\n", dest, hex[1]);
+
+	return 0;
+}
+
+
+/**
+ * Compare the size of a local copy with the expected size. A copy of
+ * different size is removed.
+ *
+ * \param[in]  dest    Pathname of local copy.
+ * \param[in]  size    Expected size in bytes.
+ * \param[out] errmsg  Accumulation string for error messages.
+ * \return     Zero if the sizes match, non-zero otherwise.
+ */
+
+static int
+comp_load_check_size(const char *dest, long long size, char **errmsg)
+{
+	struct stat st;
+
+	if (stat(dest, &st)) {
+		cfg_strprintf(errmsg, "Cannot access '%s' - %s.", dest,
+		    strerror(errno));
+		return -1;
+	}
+	if (st.st_size != size) {
+		cfg_strprintf(errmsg, "Size of '%s' is %lld bytes, expected "
+		    "%lld.", dest, (long long) st.st_size, size);
+		unlink(dest);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Access file specified by a URI and create a copy on a local filesystem.
+ * Sources which a plugin reports as locally readable are not copied,
+ * \p dest becomes a symbolic link to them instead, unless the request
+ * carries a digest. The digest is computed while the data is
+ * transferred. The transfer can be aborted by another thread by setting
+ * the cancel flag of the request, which also happens when one of its
+ * deadlines expires.
+ *
+ * \param[in,out] req  Component load request. Messages are accumulated
+ *                     in \c info and \c errmsg.
+ * \return  On success zero is returned. On error the return value in
+ *          non-zero.
+ */
+
+static int
+comp_load_cancellable(struct comp_request *req)
+{
+	const struct cl_plugin *plugin;
+	const char *dest = req->dest, *uri = req->uri;
+	char **info = &req->info, **errmsg = &req->errmsg;
+	volatile int *cancel = &req->cancel;
+	char *uri_scheme = NULL, *module = NULL;
+	char *defaultpath = NULL, *key = NULL;
+	unsigned char expected[SHA256_SIZE], digest[SHA256_SIZE];
+	char hex[SHA256_HEX_SIZE];
+	struct cl_stream probe;
+	size_t scheme_len;
+	int ret, segments, verify = 0;
+
+	if (req->sha256 && strlen(req->sha256)) {
+		if (sha256_parse(req->sha256, expected)) {
+			cfg_strprintf(errmsg, "Invalid SHA-256 digest '%s'.",
+			    req->sha256);
+			return -1;
+		}
+		verify = 1;
+	}
+
+	// extract URI scheme to identify loader module
+	scheme_len = uri_scheme_length(uri);
+	if (!scheme_len) {
+		cfg_strcpy(errmsg, "Invalid URI scheme.");
+		return -1;
+	}
+	cfg_strinit(&module);
+	cfg_strinit(&defaultpath);
+	cfg_strinit(&uri_scheme);
+	cfg_strncpy(&uri_scheme, uri, scheme_len);
+
+	// try to get our installation directory out of CFG_PATH environment
+	// variable, otherwise use default path
+	cfg_get_env_str(CFG_PATH, &defaultpath);
+	if (strlen(defaultpath) == 0) {
+		cfg_strcpy(&defaultpath, CFG_DEFAULTPATH);
+	}
+
+	// never write through a link into the component cache
+	unlink(dest);
+
+	// decompressed copies are cached apart from the original data,
+	// verified copies under their digest, so that a cached copy never
+	// needs to be hashed again
+	cfg_strinit(&key);
+	if (verify) {
+		sha256_format(expected, hex);
+		cfg_strprintf(&key, "sha256=%s ", hex);
+	}
+	if (req->decompress)
+		cfg_strcat(&key, "decompress:");
+	cfg_strcat(&key, uri);
+
+	// prefer in-process plugin, fall back to loader module executable;
+	// files inside images are read through the plugin of the image
+	plugin = cl_plugin_lookup(uri_scheme, defaultpath);
+	if (plugin)
+		plugin = ci_select(plugin, uri);
+	if (plugin) {
+		comp_load_probe(plugin, uri, &req->timeouts, &probe);
+		// no transfer is attempted if the server cannot be reached
+		if (plugin->abi_version >= 7 && probe.unreachable) {
+			probe.errmsg[CL_MSG_SIZE-1] = '\0';
+			cfg_strcat(errmsg, probe.errmsg);
+			ret = CL_UNREACHABLE;
+			goto fallback;
+		}
+		// a source of unexpected size fails before any transfer; the
+		// server answered, so no cached copy is used
+		if (req->size > 0 && probe.size > 0 &&
+		    probe.size != req->size) {
+			cfg_strprintf(errmsg, "Size of '%s' is %lld bytes, "
+			    "expected %lld.", uri, probe.size, req->size);
+			ret = -1;
+			goto out;
+		}
+		if (strlen(probe.local_path) && !req->decompress && !verify &&
+		    symlink(probe.local_path, dest) == 0) {
+			dg_printf(DG_VERBOSE, "using '%s' in place\n",
+			    probe.local_path);
+			ret = 0;
+			goto out;
+		}
+		if (cc_lookup(key, probe.validator, dest) == 0) {
+			ret = 0;
+			goto out;
+		}
+		// decompression needs the data in order
+		segments = req->decompress ? 1 :
+		    comp_load_segments(req, &probe);
+		ret = -1;
+		if (segments > 1) {
+			ret = comp_load_segmented(plugin, &probe, segments,
+			    dest, verify ? digest : NULL, errmsg, cancel,
+			    &req->loaded);
+			// e.g. server ignoring ranges, try one stream instead
+			if (ret && !*cancel) {
+				dg_printf(DG_VERBOSE, "segmented transfer of "
+				    "'%s' failed: %s\n", uri, *errmsg);
+				cfg_strcpy(errmsg, "");
+			}
+		}
+		if (ret && !*cancel)
+			ret = comp_load_plugin(plugin, &probe, dest,
+			    req->decompress, req->size, verify ? digest : NULL,
+			    info, errmsg, cancel, &req->loaded);
+		if (!ret && verify)
+			ret = comp_load_verify(dest, expected, digest, errmsg);
+		if (!ret)
+			cc_insert(key, probe.validator, dest);
+	} else {
+		cfg_strprintf(&module, "%s/%s/cl_%s",
+		    defaultpath, COMP_LOAD_MODULE_PATH, uri_scheme);
+		ret = comp_load_exec(module, dest, uri, info, errmsg, cancel,
+		    &req->loaded);
+		// loader module executables write the file themselves and may
+		// rewrite parts of it, so it is hashed after the transfer
+		if (!ret && verify)
+			ret = comp_load_verify(dest, expected, NULL, errmsg);
+		if (!ret && req->decompress)
+			ret = comp_load_decode_file(dest, errmsg);
+		if (!ret)
+			cc_insert(key, "", dest);
+	}
 
- cleanup:
-	if (info && strlen(int_info))
-		cfg_strinitcpy(info, int_info);
-	if (errmsg && strlen(int_errmsg))
-		cfg_strinitcpy(errmsg, int_errmsg);
+ fallback:
+	// server unreachable or not answering in time, fall back to an
+	// unvalidated cached copy; a source which answered with an error,
+	// e.g. because it has been withdrawn, is never replaced by it
+	if (ret && ((ret == CL_UNREACHABLE && !*cancel) || req->expired) &&
+	    cc_lookup_stale(key, dest) == 0) {
+		cfg_strcpy(errmsg, "");
+		cfg_strcat(info, "Source unavailable, using cached copy.");
+		ret = 0;
+	}
+	if (!ret && req->size > 0 && !req->decompress)
+		ret = comp_load_check_size(dest, req->size, errmsg);
+
+ out:
 	cfg_strfree(&module);
-	cfg_strfree(&int_info);
-	cfg_strfree(&int_errmsg);
 	cfg_strfree(&defaultpath);
+	cfg_strfree(&uri_scheme);
+	cfg_strfree(&key);
+
+	return ret;
+}
+
+
+/**
+ * Initialize component load request.
+ *
+ * \param[out] req       Request to initialize.
+ * \param[in]  name      Component name used in messages.
+ * \param[in]  dest      Pathname of local copy.
+ * \param[in]  uri       Dynamically allocated source URI. Ownership is
+ *                       passed to the request.
+ * \param[in]  required  Non-zero if failure of this request should
+ *                       cancel all other requests of the same set.
+ */
+
+void
+comp_request_init(struct comp_request *req, const char *name,
+    const char *dest, char *uri, int required)
+{
+	memset(req, 0, sizeof(*req));
+	req->name = name;
+	req->dest = dest;
+	req->uri = uri;
+	req->required = required;
+	cfg_strinit(&req->info);
+	cfg_strinit(&req->errmsg);
+}
+
+
+/**
+ * Free all memory allocated by a component load request.
+ *
+ * \param[in,out] req  Request to destroy.
+ */
+
+void
+comp_request_destroy(struct comp_request *req)
+{
+	cfg_strfree(&req->uri);
+	cfg_strfree(&req->sha256);
+	cfg_strfree(&req->info);
+	cfg_strfree(&req->errmsg);
+}
+
+
+/**
+ * Thread function processing a single component load request.
+ *
+ * \param[in,out] arg  Pointer to component load request.
+ * \return             Always \c NULL.
+ */
+
+static void *
+comp_load_thread(void *arg)
+{
+	struct comp_request *req = arg;
+	int i;
+
+	req->ret = comp_load_cancellable(req);
+
+	// a failed required component makes all others useless, also if
+	// it has been cancelled by one of its deadlines
+	if (req->ret && req->required && (!req->cancel || req->expired))
+		for (i = 0; i < req->set_size; i++)
+			if (&req->set[i] != req)
+				req->set[i].cancel = 1;
+
+	pthread_mutex_lock(&cl_finish_lock);
+	req->finished = 1;
+	pthread_cond_broadcast(&cl_finish);
+	pthread_mutex_unlock(&cl_finish_lock);
+
+	return NULL;
+}
+
+
+/**
+ * Return seconds of the monotonic clock.
+ */
+
+static time_t
+comp_load_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+
+/**
+ * Check the deadlines of a running request and cancel it if one has
+ * expired. Called with \c cl_finish_lock held.
+ *
+ * \param[in,out] req  Started request.
+ * \param[in]     now  Current time of the monotonic clock.
+ */
+
+static void
+comp_load_watch(struct comp_request *req, time_t now)
+{
+	const struct cl_timeouts *t = &req->timeouts;
+	long long loaded = req->loaded;
+
+	if (req->cancel)
+		return;
+	if (loaded != req->watched) {
+		req->watched = loaded;
+		req->progress = now;
+	}
+
+	if (t->total && now - req->start >= t->total)
+		req->expired = CL_EXPIRED_TOTAL;
+	else if (t->connect && !loaded && now - req->start >= t->connect)
+		req->expired = CL_EXPIRED_CONNECT;
+	else if (t->stall && (loaded || !t->connect) &&
+	    now - req->progress >= t->stall)
+		req->expired = CL_EXPIRED_STALL;
+	else
+		return;
+
+	dg_printf(DG_VERBOSE, "deadline of '%s' expired after %lld bytes\n",
+	    req->uri, loaded);
+	req->cancel = 1;
+}
+
+
+/**
+ * Wait for the threads of a set of requests while checking their
+ * deadlines. The error message of a request cancelled by a deadline
+ * is replaced by the reason.
+ *
+ * \param[in,out] req    Array of started requests.
+ * \param[in]     count  Number of requests.
+ */
+
+static void
+comp_load_join(struct comp_request *req, int count)
+{
+	struct timeval now;
+	struct timespec until;
+	int i, running, watched;
+
+	pthread_mutex_lock(&cl_finish_lock);
+	do {
+		running = watched = 0;
+		for (i = 0; i < count; i++) {
+			if (!req[i].started || req[i].finished)
+				continue;
+			running = 1;
+			if (req[i].timeouts.connect || req[i].timeouts.stall ||
+			    req[i].timeouts.total) {
+				comp_load_watch(&req[i], comp_load_now());
+				watched = 1;
+			}
+		}
+		if (running && !watched)
+			pthread_cond_wait(&cl_finish, &cl_finish_lock);
+		else if (running) {
+			gettimeofday(&now, NULL);
+			until.tv_sec = now.tv_sec;
+			until.tv_nsec = (now.tv_usec + CL_CANCEL_POLL * 1000) *
+			    1000L;
+			until.tv_sec += until.tv_nsec / 1000000000L;
+			until.tv_nsec %= 1000000000L;
+			pthread_cond_timedwait(&cl_finish, &cl_finish_lock,
+			    &until);
+		}
+	} while (running);
+	pthread_mutex_unlock(&cl_finish_lock);
+
+	for (i = 0; i < count; i++) {
+		if (req[i].started)
+			pthread_join(req[i].thread, NULL);
+		req[i].started = 0;
+		if (!req[i].ret)
+			continue;
+		switch (req[i].expired) {
+		case CL_EXPIRED_CONNECT:
+			cfg_strprintf(&req[i].errmsg, "No data received "
+			    "within %d seconds.", req[i].timeouts.connect);
+			break;
+		case CL_EXPIRED_STALL:
+			cfg_strprintf(&req[i].errmsg, "No progress for %d "
+			    "seconds.", req[i].timeouts.stall);
+			break;
+		case CL_EXPIRED_TOTAL:
+			cfg_strprintf(&req[i].errmsg, "Not completed within "
+			    "%d seconds.", req[i].timeouts.total);
+			break;
+		case CL_EXPIRED_NONE:
+			break;
+		}
+	}
+}
+
+
+/**
+ * Start concurrent loading of a set of components. Requests are
+ * processed in the background until collected by comp_load_wait().
+ * Their deadlines are completed from the settings of their URI schemes
+ * and start to run now.
+ *
+ * \param[in,out] req    Array of initialized requests.
+ * \param[in]     count  Number of requests.
+ */
+
+void
+comp_load_start(struct comp_request *req, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		req[i].set = req;
+		req[i].set_size = count;
+		req[i].loaded = 0;
+		req[i].finished = 0;
+		req[i].expired = CL_EXPIRED_NONE;
+		req[i].watched = 0;
+		req[i].start = req[i].progress = comp_load_now();
+		comp_load_deadlines(&req[i]);
+	}
+	for (i = 0; i < count; i++) {
+		if (!pthread_create(&req[i].thread, NULL, comp_load_thread,
+			&req[i]))
+			req[i].started = 1;
+		else
+			comp_load_thread(&req[i]);
+	}
+}
+
+
+/**
+ * Cancel all requests of a set. The requests still have to be
+ * collected by comp_load_wait().
+ *
+ * \param[in,out] req    Array of requests.
+ * \param[in]     count  Number of requests.
+ */
+
+void
+comp_load_cancel(struct comp_request *req, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		req[i].cancel = 1;
+}
+
+
+/**
+ * Wait for completion of a set of component load requests. On success
+ * \c NULL is returned. If one or more required components failed, a
+ * dynamically allocated error message with one line per failed
+ * component is returned. Components cancelled because of another
+ * failure are not reported.
+ *
+ * \param[in,out] req    Array of started requests.
+ * \param[in]     count  Number of requests.
+ * \return               In case of error dynamically allocated error
+ *                       message.
+ */
+
+char *
+comp_load_wait(struct comp_request *req, int count)
+{
+	char *msg = NULL, *line = NULL;
+	int i, failed = 0;
+
+	comp_load_join(req, count);
+
+	cfg_strinit(&msg);
+	cfg_strinit(&line);
+	for (i = 0; i < count; i++) {
+		if (!req[i].ret || !req[i].required)
+			continue;
+		failed = 1;
+		if (req[i].cancel && !req[i].expired)
+			continue;
+		cfg_strprintf(&line, "%sError loading %s - %s",
+		    strlen(msg) ? "\n" : "", req[i].name, req[i].errmsg);
+		cfg_strcat(&msg, line);
+	}
+	cfg_strfree(&line);
+
+	if (!failed) {
+		cfg_strfree(&msg);
+		return NULL;
+	}
+	if (!strlen(msg))
+		cfg_strcpy(&msg, "Loading of boot components cancelled.");
+
+	return msg;
+}
+
+
+/**
+ * Access file specified by a URI and create a copy on a local filesystem.
+ * The deadlines configured for the URI scheme apply.
+ *
+ * \param[in]   dest    Pathname of local copy
+ * \param[in]   uri     URI of source file
+ * \param[out]  info    Dynamically allocated buffer with informational
+ *                      messages from loader module. If set to \p NULL no
+ *                      memory is allocated.
+ * \param[out]  errmsg  Dynamically allocated buffer with error messages
+ *                      from loader module.If set to \p NULL no memory is
+ *                      allocated.
+ * \return  On success zero is returned. On error the return value in non-zero.
+ */
+
+int
+comp_load(const char *dest, const char *uri, char **info, char **errmsg)
+{
+	struct comp_request req;
+	char *int_uri = NULL;
+	int ret;
+
+	cfg_strinitcpy(&int_uri, uri);
+	comp_request_init(&req, uri, dest, int_uri, 1);
+
+	comp_load_start(&req, 1);
+	comp_load_join(&req, 1);
+	ret = req.ret;
+
+	if (info && strlen(req.info))
+		cfg_strinitcpy(info, req.info);
+	if (errmsg && strlen(req.errmsg))
+		cfg_strinitcpy(errmsg, req.errmsg);
+	comp_request_destroy(&req);
 
 	return ret;
 }
 
+
+/**
+ * Stop the session broker of a loader module executable, which keeps
+ * authenticated sessions for the transfers of one boot attempt. The
+ * broker closes the connection after it has closed its sessions.
+ *
+ * \param[in] path  Pathname of the socket of the broker.
+ */
+
+static void
+comp_load_stop_broker(const char *path)
+{
+	struct sockaddr_un addr;
+	struct pollfd pfd;
+	char c;
+	int fd;
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+	    send(fd, CL_BROKER_QUIT, sizeof(CL_BROKER_QUIT),
+	    MSG_NOSIGNAL) == sizeof(CL_BROKER_QUIT)) {
+		shutdown(fd, SHUT_WR);
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, CL_BROKER_WAIT * 1000) > 0)
+			while (recv(fd, &c, 1, 0) > 0);
+		dg_printf(DG_VERBOSE, "stopped session broker %s\n", path);
+	}
+	close(fd);
+}
+
+
+/**
+ * Release resources kept by loader plugins across transfers, e.g. idle
+ * network connections. Called before the new kernel is started and
+ * after each boot attempt.
+ */
+
+void
+comp_load_release(void)
+{
+	int i;
+
+	// images are read through other plugins, close them first
+	ci_release();
+	pthread_mutex_lock(&cl_registry_lock);
+	for (i = 0; i < cl_registry_count; i++)
+		if (cl_registry[i].plugin &&
+		    cl_registry[i].plugin->abi_version >= 3 &&
+		    cl_registry[i].plugin->release)
+			cl_registry[i].plugin->release();
+	pthread_mutex_unlock(&cl_registry_lock);
+	comp_load_stop_broker(CL_SCP_BROKER_SOCKET);
+}
@@ -0,0 +1,241 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_load.h
+ * \brief In-process component loader plugin interface
+ *
+ * A component loader plugin is a shared object named
+ * <tt>cl_<scheme>.so</tt> in the loader module directory. It exports a
+ * function named #CL_PLUGIN_ENTRY which returns a description of the
+ * plugin. The core opens a stream for a URI, reads it chunk by chunk
+ * and writes the data to the local destination file without forking.
+ * Large files of sources supporting partial opens are split into
+ * segments which are transferred over parallel streams.
+ *
+ * Transfers are bounded by deadlines which are configured per URI
+ * scheme and per request. A transfer which receives no data, stalls or
+ * takes too long in total is cancelled.
+ *
+ * $Id$
+ */
+
+
+#ifndef _COMP_LOAD_H_
+#define _COMP_LOAD_H_
+
+#include <sys/types.h>
+#include <pthread.h>
+
+#define CL_PLUGIN_ABI_VERSION 7                 //!< current plugin ABI version
+#define CL_PLUGIN_ABI_MIN     1                 //!< oldest supported ABI version
+#define CL_PLUGIN_ENTRY       "cl_plugin_entry" //!< plugin entry symbol
+#define CL_MSG_SIZE           512               //!< size of message buffers
+#define CL_VALIDATOR_SIZE     128               //!< size of validator buffer
+#define CL_PATH_SIZE          1024              //!< size of local path buffer
+#define CL_SEGMENTS_DEFAULT   4                 //!< default parallel segments
+#define CL_SEGMENTS_MAX       16                //!< maximum parallel segments
+#define CL_SEGMENT_SIZE_DEFAULT (16LL << 20)    //!< default minimum segment
+                                                //!< size in bytes
+#define CL_SCP_BROKER_SOCKET  "/tmp/sysload-scp.sock" //!< session broker
+                                                    //!< of cl_scp
+#define CL_BROKER_QUIT        "quit"            //!< stops a session broker
+#define CL_EXIT_UNREACHABLE   75                //!< exit status of loader
+                                                //!< module executables which
+                                                //!< cannot reach the source
+
+
+/**
+ * State of a single transfer. Allocated and initialized by the core,
+ * filled in by the plugin.
+ */
+
+struct cl_stream {
+	const char *uri;            //!< source URI
+	const char *dest;           //!< pathname of local copy
+	int dest_fd;                //!< open descriptor of local copy
+	long long size;             //!< total size or -1 if unknown
+	void *priv;                 //!< plugin private data
+	char info[CL_MSG_SIZE];     //!< informational message for the user
+	char errmsg[CL_MSG_SIZE];   //!< error message for the user
+	/* ABI version 2 */
+	char validator[CL_VALIDATOR_SIZE]; //!< identifies source version
+	/* ABI version 4 */
+	long long offset;           //!< first byte to transfer
+	long long length;           //!< bytes to transfer or -1 for all
+	int ranges;                 //!< source supports offset and length
+	/* ABI version 5 */
+	char local_path[CL_PATH_SIZE]; //!< pathname under which the source
+	                               //!< can be read directly or empty
+	/* ABI version 6 */
+	int connect_timeout;        //!< seconds a connection attempt may
+	                            //!< take, 0 for no limit
+	int io_timeout;             //!< seconds a single read or write may
+	                            //!< block, 0 for no limit
+	/* ABI version 7 */
+	int unreachable;            //!< source could not be contacted
+};
+
+
+/**
+ * Plugin description returned by the plugin entry function.
+ */
+
+struct cl_plugin {
+	int abi_version;            //!< must be #CL_PLUGIN_ABI_VERSION
+	const char *scheme;         //!< implemented URI scheme
+
+	/**
+	 * Open source specified by \c stream->uri. Since ABI version 4
+	 * a plugin which sets \c stream->ranges in \c probe must start
+	 * at \c stream->offset and stop after \c stream->length bytes.
+	 * \c stream->size is always the size of the whole source.
+	 * Since ABI version 6 connections and single reads should fail
+	 * after \c stream->connect_timeout and \c stream->io_timeout
+	 * seconds, so that a cancelled transfer does not stay blocked.
+	 * Since ABI version 7 a plugin sets \c stream->unreachable in
+	 * \c open and \c probe if the server could not be contacted at
+	 * all, e.g. name resolution or connection failed. Only then may
+	 * the core use a cached copy instead of the source.
+	 *
+	 * \return Zero on success, non-zero on error (\c stream->errmsg set).
+	 */
+	int (*open)(struct cl_stream *stream);
+
+	/**
+	 * Read next chunk of data.
+	 *
+	 * \return Number of bytes read, zero at end of data, negative
+	 *         value on error (\c stream->errmsg set).
+	 */
+	ssize_t (*read)(struct cl_stream *stream, void *buf, size_t count);
+
+	/**
+	 * Release all resources allocated by \c open. Always called after
+	 * a successful \c open.
+	 */
+	void (*close)(struct cl_stream *stream);
+
+	/* ABI version 2 */
+
+	/**
+	 * Optional. Determine \c stream->validator and \c stream->size
+	 * without transferring the data. The validator must change
+	 * whenever the content of the source changes, e.g. size and
+	 * modification time or an entity tag. An empty validator
+	 * prevents caching. Since ABI version 5 \c stream->local_path
+	 * may be set if the source is a regular file which stays
+	 * readable under this name; no copy is made then.
+	 *
+	 * \return Zero on success, non-zero on error.
+	 */
+	int (*probe)(struct cl_stream *stream);
+
+	/* ABI version 3 */
+
+	/**
+	 * Optional. Release resources kept across transfers, e.g. idle
+	 * network connections. Called before the new kernel is started
+	 * and when a boot attempt has finished.
+	 */
+	void (*release)(void);
+
+	/* ABI version 5 */
+
+	/**
+	 * Optional. Transfer up to \c count bytes from the current
+	 * position of the open stream directly to \c fd at \c offset,
+	 * e.g. with \c copy_file_range(). Used instead of \c read.
+	 *
+	 * \return Number of bytes transferred, zero at end of data,
+	 *         negative value on error (\c stream->errmsg set).
+	 */
+	ssize_t (*copy)(struct cl_stream *stream, int fd, long long offset,
+	    size_t count);
+};
+
+typedef const struct cl_plugin *(*cl_plugin_entry_t)(void);
+
+
+/**
+ * Deadlines of a transfer in seconds, 0 for no limit.
+ */
+
+struct cl_timeouts {
+	int connect;                //!< until the first byte is written
+	int stall;                  //!< without progress
+	int total;                  //!< for the whole transfer
+};
+
+
+/**
+ * Deadline which cancelled a transfer.
+ */
+
+enum cl_expired {
+	CL_EXPIRED_NONE,            //!< no deadline expired
+	CL_EXPIRED_CONNECT,         //!< no data received
+	CL_EXPIRED_STALL,           //!< no progress
+	CL_EXPIRED_TOTAL,           //!< transfer took too long
+};
+
+
+/**
+ * Component load request for concurrent loading. A set of requests is
+ * started with comp_load_start() and collected with comp_load_wait().
+ * If a required component fails, all other requests of the same set
+ * are cancelled. Deadlines of a request left at zero are taken from
+ * the settings of its URI scheme when the request is started.
+ */
+
+struct comp_request {
+	const char *name;               //!< component name for messages
+	const char *dest;               //!< pathname of local copy
+	char *uri;                      //!< dynamically allocated source URI
+	int required;                   //!< failure cancels other requests
+	volatile int cancel;            //!< set to abort the transfer
+	int ret;                        //!< result of comp_load()
+	char *info;                     //!< informational messages
+	char *errmsg;                   //!< error messages
+	int started;                    //!< thread has been created
+	pthread_t thread;               //!< thread handling the request
+	struct comp_request *set;       //!< first request of the set
+	int set_size;                   //!< number of requests in the set
+	int segments;                   //!< parallel segments, 0 for default
+	long long segment_size;         //!< minimum segment size in bytes,
+	                                //!< 0 for default
+	int decompress;                 //!< decompress gzip, xz and zstd
+	                                //!< sources while loading
+	char *sha256;                   //!< dynamically allocated expected
+	                                //!< SHA-256 digest in hex or NULL
+	long long size;                 //!< expected size of the source in
+	                                //!< bytes, 0 if unknown
+	struct cl_timeouts timeouts;    //!< deadlines of the transfer
+	volatile long long loaded;      //!< bytes written so far
+	volatile int finished;          //!< thread has completed
+	volatile enum cl_expired expired; //!< deadline which cancelled
+	                                  //!< the transfer
+	long long watched;              //!< \c loaded at last progress
+	time_t start;                   //!< start time, monotonic
+	time_t progress;                //!< time of last progress
+};
+
+int comp_load_register(const struct cl_plugin *plugin);
+void comp_load_set_timeouts(const char *scheme,
+    const struct cl_timeouts *timeouts);
+void comp_request_init(struct comp_request *req, const char *name,
+    const char *dest, char *uri, int required);
+void comp_request_destroy(struct comp_request *req);
+void comp_load_start(struct comp_request *req, int count);
+void comp_load_cancel(struct comp_request *req, int count);
+char *comp_load_wait(struct comp_request *req, int count);
+void comp_load_release(void);
+int comp_load_check_decoders(const char *format, char **errmsg);
+ssize_t comp_load_copy_buffered(struct cl_stream *stream,
+    ssize_t (*read)(struct cl_stream *, void *, size_t), char **buffer,
+    size_t *buffer_size, int fd, long long offset, size_t count);
+
+#endif /* #ifndef _COMP_LOAD_H_ */
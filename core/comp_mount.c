@@ -0,0 +1,740 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_mount.c
+ * \brief Mount sessions for loading components from disk devices
+ *
+ * Built-in loader plugins for the dasd, zfcp and block URI schemes. The
+ * device of a URI is set online when the first component is loaded from
+ * it. Filesystems which the built-in reader (see fsread.c) understands
+ * are read directly from the device in large extent-sized requests,
+ * other filesystems are mounted read-only and the loaded files are used
+ * in place, no copy is made. All further components of the same device
+ * and partition are served from the same session. A session is set up
+ * under its own lock, so that loads from other devices do not wait for
+ * the device to come online or the filesystem to be mounted. Sessions
+ * are released by cm_release(), which is called through the plugin
+ * release function at the end of each boot attempt and before the new
+ * kernel is started.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/sysmacros.h>
+#include "loader.h"
+#include "bootmap.h"
+#include "comp_load.h"
+#include "comp_mount.h"
+#include "fsread.h"
+#include "debug.h"
+#include "uri.h"
+
+#define CM_SYS_DEV_BLOCK "/sys/dev/block" //!< block devices by number
+
+
+/**
+ * This structure describes one mounted filesystem.
+ */
+
+struct cm_session {
+	char *key;                  //!< device and partition, see cm_key()
+	char *mountpoint;           //!< directory the filesystem is mounted on
+	struct fs *fs;              //!< filesystem read without mounting
+	int fd;                     //!< open descriptor of device for fs
+	char *disk;                 //!< device node of disk, NULL for block
+	char *part;                 //!< device node of partition or NULL
+	char *busid;                //!< bus ID for dasd and zfcp
+	char *wwpn;                 //!< WWPN for zfcp
+	char *lun;                  //!< LUN for zfcp
+	int mounted;                //!< filesystem was mounted by us
+	int online;                 //!< device was set online by us
+	int opened;                 //!< session has been set up
+	pthread_mutex_t lock;       //!< held while the session is set up
+};
+
+
+/**
+ * Private data of an open stream.
+ */
+
+struct cm_priv {
+	int fd;                     //!< open descriptor of file
+	long long remaining;        //!< bytes left to read or -1 for all
+	struct fs *fs;              //!< filesystem of file or NULL
+	struct fs_file file;        //!< file read with fs
+	uint64_t pos;               //!< position in file read with fs
+	char *buffer;               //!< buffer of cm_copy()
+	size_t buffer_size;         //!< size of buffer
+};
+
+static struct cm_session cm_sessions[CM_MAX_SESSIONS];
+static int cm_count = 0;
+static int cm_serial = 0;               //!< number of last mount point
+static pthread_mutex_t cm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Create device node for a partition of a disk.
+ *
+ * \param[in]  disk       Device node of disk.
+ * \param[in]  partition  Partition number.
+ * \param[out] part       Dynamically allocated device node of partition.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+cm_partition_node(const char *disk, const char *partition, char **part)
+{
+	char *errmsg = NULL, *path = NULL, buffer[16];
+	int maj, min, found = 0;
+	struct dirent *dirent;
+	struct stat st;
+	DIR *dir;
+
+	if (stat(disk, &st) || !S_ISBLK(st.st_mode)) {
+		cfg_strprintf(&errmsg, "No block device '%s'.", disk);
+		return errmsg;
+	}
+
+	// partitions are subdirectories of the disk in sysfs
+	cfg_strprintf(&path, "%s/%u:%u", CM_SYS_DEV_BLOCK,
+	    major(st.st_rdev), minor(st.st_rdev));
+	dir = opendir(path);
+	while (dir && !found && (dirent = readdir(dir))) {
+		if (dirent->d_name[0] == '.')
+			continue;
+		cfg_strprintf(&path, "%s/%u:%u/%s/partition", CM_SYS_DEV_BLOCK,
+		    major(st.st_rdev), minor(st.st_rdev), dirent->d_name);
+		if (read_file(path, buffer, sizeof(buffer)) <= 0 ||
+		    strcmp(buffer, partition))
+			continue;
+		cfg_strprintf(&path, "%s/%u:%u/%s/dev", CM_SYS_DEV_BLOCK,
+		    major(st.st_rdev), minor(st.st_rdev), dirent->d_name);
+		found = read_file(path, buffer, sizeof(buffer)) > 0 &&
+		    sscanf(buffer, "%i:%i", &maj, &min) == 2;
+	}
+	if (dir)
+		closedir(dir);
+	cfg_strfree(&path);
+	if (!found) {
+		cfg_strprintf(&errmsg, "No partition %s on '%s'.",
+		    partition, disk);
+		return errmsg;
+	}
+
+	cfg_strinit(part);
+	cfg_strprintf(part, "%s-part%s", disk, partition);
+	unlink(*part);
+	if (mknod(*part, 0660 | S_IFBLK, makedev(maj, min))) {
+		cfg_strprintf(&errmsg, "Error creating device node for "
+		    "partition %s on '%s' - %s", partition, disk,
+		    strerror(errno));
+		cfg_strfree(part);
+	}
+
+	return errmsg;
+}
+
+
+/**
+ * Find mount point of a device which is mounted already.
+ *
+ * \param[in]  dev         Device node.
+ * \param[out] mountpoint  Dynamically allocated mount point.
+ * \return     Zero if the device is mounted, non-zero otherwise.
+ */
+
+static int
+cm_find_mount(const char *dev, char **mountpoint)
+{
+	char line[1024], device[512], dir[512];
+	int ret = -1;
+	FILE *file;
+
+	file = fopen("/proc/mounts", "r");
+	if (!file)
+		return -1;
+	while (ret && fgets(line, sizeof(line), file))
+		if (sscanf(line, "%511s %511s", device, dir) == 2 &&
+		    !strcmp(device, dev)) {
+			cfg_strinitcpy(mountpoint, dir);
+			ret = 0;
+		}
+	fclose(file);
+
+	return ret;
+}
+
+
+/**
+ * Build session key of a URI. The filesystem type is not part of it, so
+ * URIs with and without type share the mount.
+ *
+ * \param[in]  uri  Parsed URI.
+ * \param[out] key  Dynamically allocated key.
+ */
+
+static void
+cm_key(const struct uri *uri, char **key)
+{
+	const char *partition = uri->partition ? uri->partition : "";
+
+	if (!strcmp(partition, "0"))
+		partition = "";
+	cfg_strinit(key);
+	cfg_strprintf(key, "%s:%s:%s:%s:%s:%s", uri->scheme,
+	    uri->busid ? uri->busid : "", uri->wwpn ? uri->wwpn : "",
+	    uri->lun ? uri->lun : "", uri->device ? uri->device : "",
+	    partition);
+}
+
+
+/**
+ * Release one session: unmount the filesystem and set the device
+ * offline if they were set up by us. The key is kept, so that the
+ * session can be set up again. Must be called with the lock of the
+ * session held or while no components are loaded.
+ *
+ * \param[in,out] session  Session to release.
+ */
+
+static void
+cm_session_release(struct cm_session *session)
+{
+	char *cmd = NULL;
+
+	if (session->fs) {
+		fs_close(session->fs);
+		close(session->fd);
+		session->fs = NULL;
+	}
+	if (session->mounted) {
+		cfg_strprintf(&cmd, "umount %s", session->mountpoint);
+		cfg_system(cmd);
+		rmdir(session->mountpoint);
+		cfg_strfree(&cmd);
+	}
+	if (session->part)
+		unlink(session->part);
+	if (session->online && session->wwpn)
+		set_fcp_disk_offline(session->busid, session->wwpn,
+		    session->lun);
+	else if (session->online)
+		set_dasd_offline(session->busid);
+	else if (session->disk)
+		unlink(session->disk);
+
+	session->mounted = session->online = session->opened = 0;
+	cfg_strfree(&session->mountpoint);
+	cfg_strfree(&session->disk);
+	cfg_strfree(&session->part);
+	cfg_strfree(&session->busid);
+	cfg_strfree(&session->wwpn);
+	cfg_strfree(&session->lun);
+}
+
+
+/**
+ * Open filesystem of a device with the built-in reader.
+ *
+ * \param[in,out] session  Session to set up.
+ * \param[in]     dev      Device node.
+ * \param[in]     fstype   Filesystem type from URI or NULL.
+ * \return        Zero on success, non-zero if the filesystem has to be
+ *                mounted.
+ */
+
+static int
+cm_fs_open(struct cm_session *session, const char *dev, const char *fstype)
+{
+	struct fs_source source;
+	char *errmsg;
+
+	if (fstype && strlen(fstype) && strcmp(fstype, "ext2") &&
+	    strcmp(fstype, "ext3") && strcmp(fstype, "ext4") &&
+	    strcmp(fstype, "iso9660"))
+		return -1;
+
+	session->fd = open(dev, O_RDONLY);
+	if (session->fd < 0)
+		return -1;
+	source.read = fs_read_fd;
+	source.priv = &session->fd;
+	errmsg = fs_open(&session->fs, &source);
+	if (errmsg) {
+		dg_printf(DG_VERBOSE, "mounting '%s': %s\n", dev, errmsg);
+		free(errmsg);
+		close(session->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Set device of URI online and open its filesystem with the built-in
+ * reader or mount it. Must be called with the lock of the session held.
+ *
+ * \param[in,out] session  Session to set up.
+ * \param[in]  uri      Parsed and checked URI.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+cm_session_open(struct cm_session *session, const struct uri *uri)
+{
+	char *errmsg = NULL, *cmd = NULL;
+	const char *dev;
+	int serial;
+
+	// set device online
+	if (uri->wwpn) {
+		cfg_strinitcpy(&session->busid, uri->busid);
+		cfg_strinitcpy(&session->wwpn, uri->wwpn);
+		cfg_strinitcpy(&session->lun, uri->lun);
+		session->online = !fcp_disk_is_online(uri->busid, uri->wwpn,
+		    uri->lun);
+		errmsg = set_fcp_disk_online(uri->busid, uri->wwpn, uri->lun,
+		    &session->disk);
+	} else if (uri->busid) {
+		cfg_strinitcpy(&session->busid, uri->busid);
+		session->online = !dasd_is_online(uri->busid);
+		errmsg = set_dasd_online(uri->busid, &session->disk);
+	}
+	if (errmsg) {
+		// nothing to undo, the device node has not been created
+		session->online = 0;
+		return errmsg;
+	}
+	dev = uri->device ? uri->device : session->disk;
+	if (uri->partition && strlen(uri->partition) &&
+	    strcmp(uri->partition, "0")) {
+		errmsg = cm_partition_node(dev, uri->partition,
+		    &session->part);
+		if (errmsg)
+			return errmsg;
+		dev = session->part;
+	}
+
+	// use existing mount of the device, e.g. of block URIs
+	if (!cm_find_mount(dev, &session->mountpoint))
+		return NULL;
+	if (!cm_fs_open(session, dev, uri->fstype))
+		return NULL;
+
+	pthread_mutex_lock(&cm_lock);
+	serial = ++cm_serial;
+	pthread_mutex_unlock(&cm_lock);
+	cfg_strinit(&session->mountpoint);
+	cfg_strprintf(&session->mountpoint, "%s/%d", CM_MOUNT_DIR, serial);
+	cfg_strinit(&cmd);
+	if (uri->fstype && strlen(uri->fstype))
+		cfg_strprintf(&cmd, "mkdir -p %s && mount -o ro -t %s %s %s",
+		    session->mountpoint, uri->fstype, dev,
+		    session->mountpoint);
+	else
+		cfg_strprintf(&cmd, "mkdir -p %s && mount -o ro %s %s",
+		    session->mountpoint, dev, session->mountpoint);
+	if (cfg_system(cmd)) {
+		cfg_strcpy(&errmsg, "Error mounting filesystem.");
+		rmdir(session->mountpoint);
+	} else
+		session->mounted = 1;
+	cfg_strfree(&cmd);
+
+	return errmsg;
+}
+
+
+/**
+ * Map URI to a pathname in the filesystem of its session. The session
+ * is set up if it does not exist yet or if setting it up failed before.
+ * Only the lookup is done with \p cm_lock held, the session is set up
+ * with its own lock, which makes loads from the same device wait for it.
+ *
+ * \param[in,out] stream  Stream with URI.
+ * \param[out]    fs      Filesystem read without mounting or NULL.
+ * \param[out]    path    Dynamically allocated pathname, in \p fs if
+ *                        set, otherwise in the mounted filesystem.
+ * \return                Zero on success, non-zero on error
+ *                        (\c stream->errmsg set).
+ */
+
+static int
+cm_path(struct cl_stream *stream, struct fs **fs, char **path)
+{
+	struct cm_session *session = NULL;
+	const char *check;
+	char *key, *errmsg = NULL;
+	struct uri uri;
+	int n;
+
+	if (uri_parse(&uri, stream->uri) || !uri.authority) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "Invalid URI.");
+		return -1;
+	}
+	check = uri_check_device(&uri);
+	if (check) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", check);
+		uri_free(&uri);
+		return -1;
+	}
+
+	cm_key(&uri, &key);
+	pthread_mutex_lock(&cm_lock);
+	for (n = 0; n < cm_count; n++)
+		if (!strcmp(cm_sessions[n].key, key))
+			session = &cm_sessions[n];
+	if (!session && cm_count == CM_MAX_SESSIONS)
+		cfg_strcpy(&errmsg, "Too many devices.");
+	else if (!session) {
+		session = &cm_sessions[cm_count++];
+		memset(session, 0, sizeof(*session));
+		session->key = key;
+		key = NULL;
+		pthread_mutex_init(&session->lock, NULL);
+	}
+	pthread_mutex_unlock(&cm_lock);
+
+	if (session) {
+		pthread_mutex_lock(&session->lock);
+		if (!session->opened) {
+			errmsg = cm_session_open(session, &uri);
+			if (errmsg)
+				cm_session_release(session);
+			else
+				session->opened = 1;
+		}
+		if (session->opened) {
+			*fs = session->fs;
+			cfg_strinit(path);
+			cfg_strprintf(path, "%s%s", session->fs ? "" :
+			    session->mountpoint, uri.path);
+		}
+		pthread_mutex_unlock(&session->lock);
+	}
+	cfg_strfree(&key);
+	uri_free(&uri);
+
+	if (errmsg) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+		free(errmsg);
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Set size and validator of stream from file status.
+ *
+ * \param[in,out] stream  Stream to update.
+ * \param[in]     st      Status of file.
+ */
+
+static void
+cm_set_validator(struct cl_stream *stream, const struct stat *st)
+{
+	stream->size = st->st_size;
+	snprintf(stream->validator, CL_VALIDATOR_SIZE, "%llx-%lx-%lx.%lx",
+	    (unsigned long long) st->st_ino, (unsigned long) st->st_size,
+	    (unsigned long) st->st_mtim.tv_sec,
+	    (unsigned long) st->st_mtim.tv_nsec);
+}
+
+
+/**
+ * Set size and validator of stream from a file read without mounting.
+ *
+ * \param[in,out] stream  Stream to update.
+ * \param[in]     file    File found by fs_lookup().
+ */
+
+static void
+cm_set_fs_validator(struct cl_stream *stream, const struct fs_file *file)
+{
+	stream->size = file->size;
+	snprintf(stream->validator, CL_VALIDATOR_SIZE, "%llx-%llx-%lx",
+	    (unsigned long long) file->ino, (unsigned long long) file->size,
+	    (unsigned long) file->mtime);
+}
+
+
+/**
+ * Set up session of URI and report the file, in place if it is on a
+ * mounted filesystem.
+ *
+ * \param[in,out] stream  Stream to probe.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+cm_probe(struct cl_stream *stream)
+{
+	struct fs_file file;
+	struct stat st;
+	struct fs *fs;
+	char *path, *errmsg;
+	int ret = -1;
+
+	if (cm_path(stream, &fs, &path))
+		return -1;
+	if (fs) {
+		errmsg = fs_lookup(fs, path, &file);
+		if (errmsg) {
+			snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+			free(errmsg);
+		} else {
+			cm_set_fs_validator(stream, &file);
+			stream->ranges = 1;
+			fs_file_free(&file);
+			ret = 0;
+		}
+	} else if (stat(path, &st) || !S_ISREG(st.st_mode))
+		snprintf(stream->errmsg, CL_MSG_SIZE, "No such file.");
+	else {
+		cm_set_validator(stream, &st);
+		stream->ranges = 1;
+		if (strlen(path) < CL_PATH_SIZE)
+			strcpy(stream->local_path, path);
+		ret = 0;
+	}
+	cfg_strfree(&path);
+
+	return ret;
+}
+
+
+/**
+ * Open file named by URI, positioned at \c stream->offset.
+ *
+ * \param[in,out] stream  Stream to open.
+ * \return                Zero on success, non-zero on error.
+ */
+
+static int
+cm_open(struct cl_stream *stream)
+{
+	struct cm_priv *priv;
+	struct stat st;
+	struct fs *fs;
+	char *path, *errmsg;
+
+	if (cm_path(stream, &fs, &path))
+		return -1;
+
+	priv = malloc(sizeof(*priv));
+	MEM_ASSERT(priv);
+	memset(priv, 0, sizeof(*priv));
+	priv->remaining = stream->length;
+	if (fs) {
+		errmsg = fs_lookup(fs, path, &priv->file);
+		cfg_strfree(&path);
+		if (errmsg) {
+			snprintf(stream->errmsg, CL_MSG_SIZE, "%s", errmsg);
+			free(errmsg);
+			free(priv);
+			return -1;
+		}
+		cm_set_fs_validator(stream, &priv->file);
+		priv->fs = fs;
+		priv->fd = -1;
+		priv->pos = stream->offset > 0 ? stream->offset : 0;
+		stream->priv = priv;
+		return 0;
+	}
+
+	priv->fd = open(path, O_RDONLY);
+	cfg_strfree(&path);
+	if (priv->fd < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "No such file.");
+		free(priv);
+		return -1;
+	}
+	if (fstat(priv->fd, &st) == 0 && S_ISREG(st.st_mode))
+		cm_set_validator(stream, &st);
+	if (stream->offset > 0 &&
+	    lseek(priv->fd, stream->offset, SEEK_SET) < 0) {
+		snprintf(stream->errmsg, CL_MSG_SIZE, "%s", strerror(errno));
+		close(priv->fd);
+		free(priv);
+		return -1;
+	}
+
+	stream->priv = priv;
+	return 0;
+}
+
+
+/**
+ * Read next chunk of file.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[out]    buf     Destination buffer.
+ * \param[in]     count   Size of destination buffer.
+ * \return                Number of bytes read, zero at end of file,
+ *                        negative value on error.
+ */
+
+static ssize_t
+cm_read(struct cl_stream *stream, void *buf, size_t count)
+{
+	struct cm_priv *priv = stream->priv;
+	ssize_t ret;
+
+	if (priv->remaining >= 0 && count > priv->remaining)
+		count = priv->remaining;
+	if (count == 0)
+		return 0;
+	if (priv->fs) {
+		ret = fs_read(priv->fs, &priv->file, buf, count, priv->pos);
+		if (ret < 0)
+			snprintf(stream->errmsg, CL_MSG_SIZE,
+			    "Error reading device.");
+		else
+			priv->pos += ret;
+	} else {
+		do {
+			ret = read(priv->fd, buf, count);
+		} while (ret < 0 && errno == EINTR);
+		if (ret < 0)
+			snprintf(stream->errmsg, CL_MSG_SIZE, "%s",
+			    strerror(errno));
+	}
+
+	if (ret > 0 && priv->remaining > 0)
+		priv->remaining -= ret;
+
+	return ret;
+}
+
+
+/**
+ * Transfer next chunk of file to the local copy. Unlike the read buffer
+ * of the core, the buffer has the size of the chunk, so files read
+ * without mounting are read in requests of up to one chunk.
+ *
+ * \param[in,out] stream  Open stream.
+ * \param[in]     fd      Descriptor of local copy.
+ * \param[in]     offset  Position in local copy.
+ * \param[in]     count   Maximum number of bytes.
+ * \return                Number of bytes transferred, zero at end of
+ *                        file, negative value on error.
+ */
+
+static ssize_t
+cm_copy(struct cl_stream *stream, int fd, long long offset, size_t count)
+{
+	struct cm_priv *priv = stream->priv;
+
+	return comp_load_copy_buffered(stream, cm_read, &priv->buffer,
+	    &priv->buffer_size, fd, offset, count);
+}
+
+
+/**
+ * Close file.
+ *
+ * \param[in,out] stream  Open stream.
+ */
+
+static void
+cm_close(struct cl_stream *stream)
+{
+	struct cm_priv *priv = stream->priv;
+
+	if (priv->fs)
+		fs_file_free(&priv->file);
+	else
+		close(priv->fd);
+	free(priv->buffer);
+	free(priv);
+	stream->priv = NULL;
+}
+
+
+static const struct cl_plugin cm_plugins[] = {
+	{
+		.abi_version = CL_PLUGIN_ABI_VERSION,
+		.scheme      = "dasd",
+		.open        = cm_open,
+		.read        = cm_read,
+		.close       = cm_close,
+		.probe       = cm_probe,
+		.release     = cm_release,
+		.copy        = cm_copy,
+	}, {
+		.abi_version = CL_PLUGIN_ABI_VERSION,
+		.scheme      = "zfcp",
+		.open        = cm_open,
+		.read        = cm_read,
+		.close       = cm_close,
+		.probe       = cm_probe,
+		.release     = cm_release,
+		.copy        = cm_copy,
+	}, {
+		.abi_version = CL_PLUGIN_ABI_VERSION,
+		.scheme      = "block",
+		.open        = cm_open,
+		.read        = cm_read,
+		.close       = cm_close,
+		.probe       = cm_probe,
+		.release     = cm_release,
+		.copy        = cm_copy,
+	},
+};
+
+
+/**
+ * Register the built-in plugins for the dasd, zfcp and block schemes.
+ */
+
+void
+cm_init(void)
+{
+	int n;
+
+	for (n = 0; n < sizeof(cm_plugins) / sizeof(cm_plugins[0]); n++)
+		comp_load_register(&cm_plugins[n]);
+}
+
+
+/**
+ * End all sessions: unmount all filesystems, then set the devices
+ * offline which were set online for them. Files loaded from the
+ * sessions are no longer accessible afterwards. Must not be called
+ * while components are loaded.
+ */
+
+void
+cm_release(void)
+{
+	struct cm_session *session;
+
+	pthread_mutex_lock(&cm_lock);
+	while (cm_count > 0) {
+		session = &cm_sessions[--cm_count];
+		if (session->opened)
+			cm_session_release(session);
+		cfg_strfree(&session->key);
+		pthread_mutex_destroy(&session->lock);
+	}
+	pthread_mutex_unlock(&cm_lock);
+}
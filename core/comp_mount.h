@@ -0,0 +1,24 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file comp_mount.h
+ * \brief Mount sessions for loading components from disk devices
+ *
+ * $Id$
+ */
+
+
+#ifndef _COMP_MOUNT_H_
+#define _COMP_MOUNT_H_
+
+#define CM_MOUNT_DIR "/var/sysload/session" //!< base of mount points
+#define CM_MAX_SESSIONS 8                   //!< mounts per boot attempt
+
+void cm_init(void);
+void cm_release(void);
+
+#endif /* #ifndef _COMP_MOUNT_H_ */
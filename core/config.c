@@ -293,6 +293,12 @@ void cfg_bentry_init(struct cfg_bentry *bentry)
 	cfg_strinit(&(bentry->insfile));
 	cfg_strinit(&(bentry->bootmap));
 	cfg_strinit(&(bentry->pause));
+	cfg_strinit(&(bentry->kernel_sha256));
+	cfg_strinit(&(bentry->initrd_sha256));
+	cfg_strinit(&(bentry->parmfile_sha256));
+	cfg_strinit(&(bentry->insfile_sha256));
+	cfg_strinit(&(bentry->sha256sums));
+	cfg_strinit(&(bentry->manifest));
 }
 
 
@@ -314,6 +320,12 @@ void cfg_bentry_destroy(struct cfg_bentry *bentry)
 	cfg_strfree(&(bentry->insfile));
 	cfg_strfree(&(bentry->bootmap));
 	cfg_strfree(&(bentry->pause));
+	cfg_strfree(&(bentry->kernel_sha256));
+	cfg_strfree(&(bentry->initrd_sha256));
+	cfg_strfree(&(bentry->parmfile_sha256));
+	cfg_strfree(&(bentry->insfile_sha256));
+	cfg_strfree(&(bentry->sha256sums));
+	cfg_strfree(&(bentry->manifest));
 }
 
 
@@ -343,6 +355,12 @@ void cfg_bentry_copy(struct cfg_bentry *dest, const struct cfg_bentry *src)
 	// copy non string members
 	dest->locked = src->locked;
 	dest->action = src->action;
+	dest->segments = src->segments;
+	dest->segment_size = src->segment_size;
+	dest->decompress = src->decompress;
+	dest->connect_timeout = src->connect_timeout;
+	dest->stall_timeout = src->stall_timeout;
+	dest->load_timeout = src->load_timeout;
 
 	// copy string members
 	cfg_strcpy(&dest->title, src->title);
@@ -355,6 +373,12 @@ void cfg_bentry_copy(struct cfg_bentry *dest, const struct cfg_bentry *src)
 	cfg_strcpy(&dest->insfile, src->insfile);
 	cfg_strcpy(&dest->bootmap, src->bootmap);
 	cfg_strcpy(&dest->pause, src->pause);
+	cfg_strcpy(&dest->kernel_sha256, src->kernel_sha256);
+	cfg_strcpy(&dest->initrd_sha256, src->initrd_sha256);
+	cfg_strcpy(&dest->parmfile_sha256, src->parmfile_sha256);
+	cfg_strcpy(&dest->insfile_sha256, src->insfile_sha256);
+	cfg_strcpy(&dest->sha256sums, src->sha256sums);
+	cfg_strcpy(&dest->manifest, src->manifest);
 }
 
 
@@ -435,6 +459,7 @@ void cfg_print(struct cfg_toplevel *config)
 	int n;
 
 	dg_printf(DG_VERBOSE, "  timeout=%d\n", config->timeout);
+	dg_printf(DG_VERBOSE, "  preload=%d\n", config->preload);
 	dg_printf(DG_VERBOSE, "  default=%d\n", config->boot_default);
 	dg_printf(DG_VERBOSE, "  password='%s'\n", config->password);
 	for (n = 0; n < config->ui_count; n++) {
@@ -467,6 +492,38 @@ void cfg_print(struct cfg_toplevel *config)
 		    "    pause='%s'\n", config->bentry_list[n].pause);
 		dg_printf(DG_VERBOSE,
 		    "    action=%d\n", config->bentry_list[n].action);
+		dg_printf(DG_VERBOSE,
+		    "    segments=%d\n", config->bentry_list[n].segments);
+		dg_printf(DG_VERBOSE,
+		    "    segment_size=%d\n",
+		    config->bentry_list[n].segment_size);
+		dg_printf(DG_VERBOSE,
+		    "    decompress=%d\n", config->bentry_list[n].decompress);
+		dg_printf(DG_VERBOSE,
+		    "    connect_timeout=%d\n",
+		    config->bentry_list[n].connect_timeout);
+		dg_printf(DG_VERBOSE,
+		    "    stall_timeout=%d\n",
+		    config->bentry_list[n].stall_timeout);
+		dg_printf(DG_VERBOSE,
+		    "    load_timeout=%d\n", config->bentry_list[n].load_timeout);
+		dg_printf(DG_VERBOSE,
+		    "    kernel_sha256='%s'\n",
+		    config->bentry_list[n].kernel_sha256);
+		dg_printf(DG_VERBOSE,
+		    "    initrd_sha256='%s'\n",
+		    config->bentry_list[n].initrd_sha256);
+		dg_printf(DG_VERBOSE,
+		    "    parmfile_sha256='%s'\n",
+		    config->bentry_list[n].parmfile_sha256);
+		dg_printf(DG_VERBOSE,
+		    "    insfile_sha256='%s'\n",
+		    config->bentry_list[n].insfile_sha256);
+		dg_printf(DG_VERBOSE,
+		    "    sha256sums='%s'\n",
+		    config->bentry_list[n].sha256sums);
+		dg_printf(DG_VERBOSE,
+		    "    manifest='%s'\n", config->bentry_list[n].manifest);
 	}
 }
 
@@ -524,6 +581,24 @@ void cfg_bentry_print(struct cfg_bentry *bentry)
 		print_if_available("parmfile", bentry->parmfile);
 		print_if_available("insfile", bentry->insfile);
 		print_if_available("bootmap", bentry->bootmap);
+		print_if_available("manifest", bentry->manifest);
+		if (bentry->segments)
+			printf("segments %d\n", bentry->segments);
+		if (bentry->segment_size)
+			printf("segment_size %d\n", bentry->segment_size);
+		if (bentry->decompress)
+			printf("decompress\n");
+		if (bentry->connect_timeout)
+			printf("connect_timeout %d\n", bentry->connect_timeout);
+		if (bentry->stall_timeout)
+			printf("stall_timeout %d\n", bentry->stall_timeout);
+		if (bentry->load_timeout)
+			printf("load_timeout %d\n", bentry->load_timeout);
+		print_if_available("kernel_sha256", bentry->kernel_sha256);
+		print_if_available("initrd_sha256", bentry->initrd_sha256);
+		print_if_available("parmfile_sha256", bentry->parmfile_sha256);
+		print_if_available("insfile_sha256", bentry->insfile_sha256);
+		print_if_available("sha256sums", bentry->sha256sums);
 	}
 	printf("}\n");
 	return;
@@ -722,6 +797,23 @@ void cfg_set_env(struct cfg_toplevel *config)
 		cfg_set_env_int_i(CFG_LOCKED, i, bentry_i->locked);
 		cfg_set_env_str_i(CFG_PAUSE, i, bentry_i->pause);
 		cfg_set_env_int_i(CFG_ACTION, i, bentry_i->action);
+		cfg_set_env_int_i(CFG_SEGMENTS, i, bentry_i->segments);
+		cfg_set_env_int_i(CFG_SEGMENT_SIZE, i, bentry_i->segment_size);
+		cfg_set_env_int_i(CFG_DECOMPRESS, i, bentry_i->decompress);
+		cfg_set_env_int_i(CFG_CONNECT_TIMEOUT, i,
+		    bentry_i->connect_timeout);
+		cfg_set_env_int_i(CFG_STALL_TIMEOUT, i, bentry_i->stall_timeout);
+		cfg_set_env_int_i(CFG_LOAD_TIMEOUT, i, bentry_i->load_timeout);
+		cfg_set_env_str_i(CFG_KERNEL_SHA256, i,
+		    bentry_i->kernel_sha256);
+		cfg_set_env_str_i(CFG_INITRD_SHA256, i,
+		    bentry_i->initrd_sha256);
+		cfg_set_env_str_i(CFG_PARMFILE_SHA256, i,
+		    bentry_i->parmfile_sha256);
+		cfg_set_env_str_i(CFG_INSFILE_SHA256, i,
+		    bentry_i->insfile_sha256);
+		cfg_set_env_str_i(CFG_SHA256SUMS, i, bentry_i->sha256sums);
+		cfg_set_env_str_i(CFG_MANIFEST, i, bentry_i->manifest);
 	}
 }
 
@@ -758,6 +850,27 @@ void cfg_get_env(struct cfg_toplevel *config)
 		cfg_get_env_int_i(CFG_LOCKED, i, &(bentry_i->locked));
 		cfg_get_env_str_i(CFG_PAUSE, i, &(bentry_i->pause));
 		cfg_get_env_int_i(CFG_ACTION, i, (int*)&(bentry_i->action));
+		cfg_get_env_int_i(CFG_SEGMENTS, i, &(bentry_i->segments));
+		cfg_get_env_int_i(CFG_SEGMENT_SIZE, i,
+		    &(bentry_i->segment_size));
+		cfg_get_env_int_i(CFG_DECOMPRESS, i, &(bentry_i->decompress));
+		cfg_get_env_int_i(CFG_CONNECT_TIMEOUT, i,
+		    &(bentry_i->connect_timeout));
+		cfg_get_env_int_i(CFG_STALL_TIMEOUT, i,
+		    &(bentry_i->stall_timeout));
+		cfg_get_env_int_i(CFG_LOAD_TIMEOUT, i,
+		    &(bentry_i->load_timeout));
+		cfg_get_env_str_i(CFG_KERNEL_SHA256, i,
+		    &(bentry_i->kernel_sha256));
+		cfg_get_env_str_i(CFG_INITRD_SHA256, i,
+		    &(bentry_i->initrd_sha256));
+		cfg_get_env_str_i(CFG_PARMFILE_SHA256, i,
+		    &(bentry_i->parmfile_sha256));
+		cfg_get_env_str_i(CFG_INSFILE_SHA256, i,
+		    &(bentry_i->insfile_sha256));
+		cfg_get_env_str_i(CFG_SHA256SUMS, i,
+		    &(bentry_i->sha256sums));
+		cfg_get_env_str_i(CFG_MANIFEST, i, &(bentry_i->manifest));
 		cfg_add_bentry(config, bentry_i);
 	}
 }
@@ -61,6 +61,18 @@
 #define CFG_LOCKED       "LOCKED"
 #define CFG_PAUSE        "PAUSE"
 #define CFG_ACTION       "ACTION"
+#define CFG_SEGMENTS     "SEGMENTS"
+#define CFG_SEGMENT_SIZE "SEGMENT_SIZE"
+#define CFG_DECOMPRESS   "DECOMPRESS"
+#define CFG_CONNECT_TIMEOUT "CONNECT_TIMEOUT"
+#define CFG_STALL_TIMEOUT   "STALL_TIMEOUT"
+#define CFG_LOAD_TIMEOUT    "LOAD_TIMEOUT"
+#define CFG_KERNEL_SHA256   "KERNEL_SHA256"
+#define CFG_INITRD_SHA256   "INITRD_SHA256"
+#define CFG_PARMFILE_SHA256 "PARMFILE_SHA256"
+#define CFG_INSFILE_SHA256  "INSFILE_SHA256"
+#define CFG_SHA256SUMS      "SHA256SUMS"
+#define CFG_MANIFEST     "MANIFEST"
 
 #define CFG_PATH         "PATH"             //!< to set the sysload base path from
                                             //!< environment (export SYSLOAD_PATH=...)
@@ -86,6 +98,7 @@ enum boot_action {
 	KERNEL_BOOT,
 	INSFILE_BOOT,
 	BOOTMAP_BOOT,
+	MANIFEST_BOOT,
 	REBOOT,
 	HALT,
 	SHELL,
@@ -119,10 +132,34 @@ struct cfg_bentry {
 	char *bootmap;  //!< boot table URI
 	int locked;     //!< entry is locked
 	char *pause;    //!< display message and wait for user input
+	int segments;   //!< parallel segments per component, 0 for default
+	int segment_size; //!< minimum segment size in MB, 0 for default
+	int decompress; //!< decompress compressed components
+	int connect_timeout; //!< seconds until first data, 0 for default
+	int stall_timeout;   //!< seconds without progress, 0 for default
+	int load_timeout;    //!< seconds per component, 0 for default
+	char *kernel_sha256;   //!< SHA-256 digest of kernel image
+	char *initrd_sha256;   //!< SHA-256 digest of initrd image
+	char *parmfile_sha256; //!< SHA-256 digest of parmfile
+	char *insfile_sha256;  //!< SHA-256 digest of insfile
+	char *sha256sums;      //!< URI of file with SHA-256 digests
+	char *manifest; //!< boot manifest URI
 	enum boot_action action; //!< boot action
 };
 
 
+/**
+ * Speculative loading of the default boot entry while the user
+ * interfaces are shown.
+ */
+
+enum preload_mode {
+	PRELOAD_OFF,        //!< no preload
+	PRELOAD_COMPONENTS, //!< load components of default entry
+	PRELOAD_KEXEC,      //!< also load kernel of default entry into memory
+};
+
+
 /**
  * This structure describes all toplevel configuration settings.
  */
@@ -131,6 +168,7 @@ struct cfg_toplevel {
 	int boot_default; //!< default boot entry
 	int timeout;      //!< timeout in seconds before booting default entry
 	char *password;   //!< password to access locked boot entries
+	enum preload_mode preload; //!< preload of default entry
 	struct cfg_userinterface *ui_list; //!< list of user interface
 	                                   //!< instances
 	int ui_count;     //!< number of user interface instance entries
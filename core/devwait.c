@@ -0,0 +1,269 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file devwait.c
+ * \brief Waiting for devices to become ready
+ *
+ * Channel devices, FCP ports and LUNs come online asynchronously. Instead
+ * of sleeping a fixed time after each step, the condition which marks the
+ * end of the step is checked whenever the kernel reports a uevent, and
+ * at increasing intervals in case a change comes without one, until it
+ * holds or the upper bound for the bring-up of the device has passed.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include "sysload.h"
+#include "devwait.h"
+
+
+#define DEVWAIT_POLL_MIN 5      //!< first recheck interval in milliseconds
+#define DEVWAIT_POLL_MAX 100    //!< longest recheck interval in milliseconds
+
+static int devwait_timeout = DEVWAIT_TIMEOUT;
+
+
+/**
+ * Set the upper bound for bringing up one device.
+ *
+ * \param[in] seconds  Upper bound in seconds, zero for the default.
+ */
+
+void
+devwait_set_timeout(int seconds)
+{
+	devwait_timeout = seconds > 0 ? seconds : DEVWAIT_TIMEOUT;
+}
+
+
+/**
+ * Return the upper bound for bringing up one device.
+ *
+ * \return  Upper bound in seconds.
+ */
+
+int
+devwait_get_timeout(void)
+{
+	return devwait_timeout;
+}
+
+
+/**
+ * Start waiting for a device: open the uevent socket and set the
+ * deadline. Must be called before the device is configured. Without a
+ * uevent socket, e.g. if netlink is not available, the conditions are
+ * only checked periodically.
+ *
+ * \param[out] wait  Wait state.
+ */
+
+void
+devwait_start(struct devwait *wait)
+{
+	struct sockaddr_nl addr;
+
+	clock_gettime(CLOCK_MONOTONIC, &wait->end);
+	wait->end.tv_sec += devwait_timeout;
+
+	wait->fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC |
+	    SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (wait->fd == -1)
+		return;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_pid = 0;
+	addr.nl_groups = 1;
+	if (bind(wait->fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		dg_printf(DG_VERBOSE, "devwait: no uevents - %s\n",
+		    strerror(errno));
+		close(wait->fd);
+		wait->fd = -1;
+	}
+}
+
+
+/**
+ * Wait until \p ready reports that the device is ready or the deadline
+ * of \p wait has passed.
+ *
+ * \param[in,out] wait   Wait state.
+ * \param[in]     ready  Condition to wait for.
+ * \param[in]     arg    Argument passed to \p ready.
+ * \return        Zero if the condition holds, -1 on timeout.
+ */
+
+int
+devwait_until(struct devwait *wait, devwait_ready_t ready, const void *arg)
+{
+	char buffer[4096];
+	struct pollfd pfd;
+	struct timespec now;
+	long left, interval = DEVWAIT_POLL_MIN;
+
+	while (!ready(arg)) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left = (wait->end.tv_sec - now.tv_sec) * 1000 +
+			(wait->end.tv_nsec - now.tv_nsec) / 1000000;
+		if (left <= 0)
+			return -1;
+		if (interval > left)
+			interval = left;
+
+		if (wait->fd != -1) {
+			pfd.fd = wait->fd;
+			pfd.events = POLLIN;
+			// events only tell that something changed, the
+			// condition is checked again anyway
+			if (poll(&pfd, 1, interval) > 0)
+				while (recv(wait->fd, buffer, sizeof(buffer),
+					0) > 0);
+		} else
+			poll(NULL, 0, interval);
+
+		interval *= 2;
+		if (interval > DEVWAIT_POLL_MAX)
+			interval = DEVWAIT_POLL_MAX;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Sysfs attribute and the value it is waited for.
+ */
+
+struct devwait_attr {
+	const char *path;       //!< path of attribute
+	const char *value;      //!< expected value or NULL for existence
+};
+
+
+/**
+ * Check a sysfs attribute. A trailing newline is ignored.
+ *
+ * \param[in] arg  Pointer to struct devwait_attr.
+ * \return         Non-zero if the attribute has the expected value.
+ */
+
+static int
+devwait_attr_ready(const void *arg)
+{
+	const struct devwait_attr *attr = arg;
+	char buffer[64];
+	ssize_t len;
+	int fd;
+
+	fd = open(attr->path, O_RDONLY);
+	if (fd == -1)
+		return 0;
+	if (!attr->value) {
+		close(fd);
+		return 1;
+	}
+	len = cfg_read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (len <= 0)
+		return 0;
+	if (buffer[len-1] == '\n')
+		len--;
+	buffer[len] = '\0';
+
+	return !strcmp(buffer, attr->value);
+}
+
+
+/**
+ * Wait until a sysfs attribute exists and, if \p value is given, has
+ * that value.
+ *
+ * \param[in,out] wait   Wait state.
+ * \param[in]     path   Path of attribute.
+ * \param[in]     value  Expected value or NULL.
+ * \return        Zero if the attribute is ready, -1 on timeout.
+ */
+
+int
+devwait_for_attr(struct devwait *wait, const char *path, const char *value)
+{
+	struct devwait_attr attr = { path, value };
+
+	return devwait_until(wait, devwait_attr_ready, &attr);
+}
+
+
+/**
+ * Glob pattern and the buffer receiving its first match.
+ */
+
+struct devwait_glob {
+	char *pattern;          //!< pattern to be matched
+	char *filename;         //!< buffer for first match
+	size_t size;            //!< size of buffer
+};
+
+
+/**
+ * Check whether a glob pattern matches.
+ *
+ * \param[in] arg  Pointer to struct devwait_glob.
+ * \return         Non-zero if the pattern matches a file.
+ */
+
+static int
+devwait_glob_ready(const void *arg)
+{
+	const struct devwait_glob *glob = arg;
+
+	return cfg_glob_filename(glob->pattern, glob->filename, glob->size);
+}
+
+
+/**
+ * Wait until a glob pattern matches a file, e.g. the block device of a
+ * disk which was just set online.
+ *
+ * \param[in,out] wait      Wait state.
+ * \param[in]     pattern   Pattern to be matched.
+ * \param[out]    filename  Buffer for first match.
+ * \param[in]     size      Size of \p filename.
+ * \return        Zero if the pattern matches, -1 on timeout.
+ */
+
+int
+devwait_for_glob(struct devwait *wait, const char *pattern, char *filename,
+    size_t size)
+{
+	struct devwait_glob glob = { (char *) pattern, filename, size };
+
+	return devwait_until(wait, devwait_glob_ready, &glob);
+}
+
+
+/**
+ * Stop waiting for a device.
+ *
+ * \param[in,out] wait  Wait state.
+ */
+
+void
+devwait_end(struct devwait *wait)
+{
+	if (wait->fd != -1)
+		close(wait->fd);
+	wait->fd = -1;
+}
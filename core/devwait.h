@@ -0,0 +1,52 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file devwait.h
+ * \brief Waiting for devices to become ready
+ *
+ * $Id$
+ */
+
+#ifndef _DEVWAIT_H_
+#define _DEVWAIT_H_
+
+#include <stddef.h>
+#include <time.h>
+
+#define DEVWAIT_TIMEOUT 10      //!< default upper bound in seconds
+
+/**
+ * State of a wait for a device. The uevent socket is opened before the
+ * device is configured, so that no event is missed.
+ */
+
+struct devwait {
+	int fd;                 //!< uevent netlink socket or -1
+	struct timespec end;    //!< deadline of the bring-up
+};
+
+/**
+ * Condition a wait ends on.
+ *
+ * \param[in] arg  Argument passed to devwait_until().
+ * \return         Non-zero if the device is ready.
+ */
+
+typedef int (*devwait_ready_t)(const void *arg);
+
+void devwait_set_timeout(int seconds);
+int devwait_get_timeout(void);
+void devwait_start(struct devwait *wait);
+int devwait_until(struct devwait *wait, devwait_ready_t ready,
+    const void *arg);
+int devwait_for_attr(struct devwait *wait, const char *path,
+    const char *value);
+int devwait_for_glob(struct devwait *wait, const char *pattern,
+    char *filename, size_t size);
+void devwait_end(struct devwait *wait);
+
+#endif /* #ifndef _DEVWAIT_H_ */
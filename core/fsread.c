@@ -0,0 +1,1037 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file fsread.c
+ * \brief Read-only access to ext2/3/4 and ISO9660 filesystems
+ *
+ * Resolves a pathname to the list of extents occupied by the file on
+ * the device, so components can be loaded from a disk without mounting
+ * it. Supported are ext2, ext3 and ext4 (block maps and extent trees,
+ * no inline data, no encryption, no journal replay) as well as ISO9660
+ * with Rock Ridge names and symbolic links. All on-disk values are
+ * little endian and decoded byte by byte, so the code works on s390.
+ *
+ * $Id$
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "loader.h"
+#include "fsread.h"
+
+#define FS_TYPE_EXT 1               //!< ext2, ext3 or ext4
+#define FS_TYPE_ISO 2               //!< ISO9660
+
+#define EXT_SUPER_OFFSET 1024       //!< position of superblock
+#define EXT_SUPER_MAGIC  0xef53     //!< s_magic
+#define EXT_ROOT_INO     2          //!< inode of root directory
+#define EXT_INODE_SIZE   256        //!< inode bytes evaluated
+#define EXT_EXTENTS_FL   0x80000    //!< inode uses extent tree
+#define EXT_EXTENT_MAGIC 0xf30a     //!< eh_magic
+#define EXT_MAX_DEPTH    5          //!< depth limit of extent tree
+#define EXT_INCOMPAT_64BIT 0x80     //!< 64 bit group descriptors
+
+/**
+ * Incompatible ext features the reader understands: filetype, extents,
+ * 64bit, mmp, flex_bg, ea_inode, csum_seed and large_dir.
+ */
+#define EXT_INCOMPAT_SUPP 0x67c2
+
+#define ISO_SECTOR_SIZE  2048       //!< size of volume descriptors
+#define ISO_PVD_OFFSET   (16 * ISO_SECTOR_SIZE) //!< primary descriptor
+#define ISO_FLAG_DIR     0x02       //!< directory record is directory
+#define ISO_FLAG_MULTI   0x80       //!< file continues in next record
+
+#define FS_MODE_DIR 1               //!< node is a directory
+#define FS_MODE_REG 2               //!< node is a regular file
+#define FS_MODE_LNK 3               //!< node is a symbolic link
+
+
+/**
+ * Description of an open filesystem.
+ */
+
+struct fs {
+	struct fs_source source;    //!< device the filesystem is on
+	int type;                   //!< FS_TYPE_EXT or FS_TYPE_ISO
+	uint32_t block_size;        //!< bytes per block
+
+	// ext
+	uint32_t first_data_block;  //!< block of superblock
+	uint32_t inodes_per_group;  //!< inodes in each block group
+	uint32_t inode_size;        //!< bytes per inode
+	uint32_t desc_size;         //!< bytes per group descriptor
+
+	// ISO9660
+	uint64_t root_offset;       //!< position of root directory
+	uint64_t root_size;         //!< size of root directory
+	int susp_skip;              //!< bytes skipped in system use area
+	int rock_ridge;             //!< Rock Ridge entries present
+};
+
+
+/**
+ * A file, directory or symbolic link found during lookup.
+ */
+
+struct fs_node {
+	int mode;                   //!< FS_MODE_*
+	uint64_t ino;               //!< inode number or location
+	uint64_t size;              //!< size in bytes
+	long mtime;                 //!< modification time
+	unsigned char inode[EXT_INODE_SIZE]; //!< raw ext inode
+	uint64_t offset;            //!< ISO9660 extent position
+	char *link;                 //!< ISO9660 Rock Ridge link target
+};
+
+
+static inline uint32_t
+le16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+
+static inline uint32_t
+le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+/**
+ * Read bytes from the device of a filesystem.
+ *
+ * \param[in]  fs      Filesystem.
+ * \param[out] buf     Destination buffer.
+ * \param[in]  count   Number of bytes.
+ * \param[in]  offset  Position on the device.
+ * \return     Zero on success, non-zero on error.
+ */
+
+static int
+fs_dev_read(struct fs *fs, void *buf, size_t count, uint64_t offset)
+{
+	return fs->source.read(fs->source.priv, buf, count, offset);
+}
+
+
+/**
+ * Append a piece of a file to its extent list, merging it with the last
+ * extent if both are contiguous.
+ *
+ * \param[in,out] file    File to extend.
+ * \param[in]     start   Byte offset in the file.
+ * \param[in]     length  Number of bytes.
+ * \param[in]     offset  Byte offset on the device.
+ */
+
+static void
+fs_add_extent(struct fs_file *file, uint64_t start, uint64_t length,
+    uint64_t offset)
+{
+	struct fs_extent *last;
+
+	if (file->extents > 0) {
+		last = &file->extent[file->extents - 1];
+		if (last->start + last->length == start &&
+		    last->offset + last->length == offset) {
+			last->length += length;
+			return;
+		}
+	}
+	if ((file->extents & (file->extents - 1)) == 0) {
+		file->extent = realloc(file->extent, (file->extents ?
+		    2 * file->extents : 1) * sizeof(*file->extent));
+		MEM_ASSERT(file->extent);
+	}
+	file->extent[file->extents].start = start;
+	file->extent[file->extents].length = length;
+	file->extent[file->extents].offset = offset;
+	file->extents++;
+}
+
+
+/**
+ * Append characters which are not terminated to a dynamically allocated
+ * string.
+ *
+ * \param[in,out] dest  Pointer to initialized destination string.
+ * \param[in]     src   Characters to append.
+ * \param[in]     len   Number of characters.
+ */
+
+static void
+fs_strncat(char **dest, const unsigned char *src, size_t len)
+{
+	char buffer[256];
+
+	if (len >= sizeof(buffer))
+		len = sizeof(buffer) - 1;
+	memcpy(buffer, src, len);
+	buffer[len] = '\0';
+	cfg_strcat(dest, buffer);
+}
+
+
+/*
+ * ext2, ext3 and ext4
+ */
+
+
+/**
+ * Read an inode.
+ *
+ * \param[in]  fs    Filesystem.
+ * \param[in]  ino   Inode number.
+ * \param[out] node  Node to fill in.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+ext_read_inode(struct fs *fs, uint64_t ino, struct fs_node *node)
+{
+	unsigned char desc[64];
+	uint64_t group, table;
+	uint32_t index, mode, size;
+	char *errmsg = NULL;
+
+	if (ino == 0) {
+		cfg_strprintf(&errmsg, "Invalid inode number.");
+		return errmsg;
+	}
+	group = (ino - 1) / fs->inodes_per_group;
+	index = (ino - 1) % fs->inodes_per_group;
+	if (fs_dev_read(fs, desc, fs->desc_size >= 64 ? 64 : 32,
+	    (uint64_t) (fs->first_data_block + 1) * fs->block_size +
+	    group * fs->desc_size)) {
+		cfg_strprintf(&errmsg, "Error reading group descriptor %llu.",
+		    (unsigned long long) group);
+		return errmsg;
+	}
+	table = le32(desc + 8);
+	if (fs->desc_size >= 64)
+		table |= (uint64_t) le32(desc + 40) << 32;
+
+	size = fs->inode_size < EXT_INODE_SIZE ?
+	    fs->inode_size : EXT_INODE_SIZE;
+	memset(node, 0, sizeof(*node));
+	if (fs_dev_read(fs, node->inode, size, table * fs->block_size +
+	    (uint64_t) index * fs->inode_size)) {
+		cfg_strprintf(&errmsg, "Error reading inode %llu.",
+		    (unsigned long long) ino);
+		return errmsg;
+	}
+
+	mode = le16(node->inode) & 0170000;
+	node->mode = mode == 0040000 ? FS_MODE_DIR :
+	    mode == 0100000 ? FS_MODE_REG : mode == 0120000 ? FS_MODE_LNK : 0;
+	node->ino = ino;
+	node->size = le32(node->inode + 4) |
+	    (uint64_t) le32(node->inode + 108) << 32;
+	node->mtime = le32(node->inode + 16);
+
+	return NULL;
+}
+
+
+/**
+ * Add the extents of one level of an ext4 extent tree.
+ *
+ * \param[in]     fs     Filesystem.
+ * \param[in]     data   Extent header followed by entries.
+ * \param[in]     size   Number of bytes available in \p data.
+ * \param[in]     depth  Number of levels above.
+ * \param[in,out] file   File to add extents to.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+ext_map_extents(struct fs *fs, const unsigned char *data, size_t size,
+    int depth, struct fs_file *file)
+{
+	uint32_t entries, n, len;
+	uint64_t block, start, end, limit;
+	const unsigned char *e;
+	unsigned char *child;
+	char *errmsg = NULL;
+
+	entries = le16(data + 2);
+	if (le16(data) != EXT_EXTENT_MAGIC || depth > EXT_MAX_DEPTH ||
+	    12 + entries * 12 > size) {
+		cfg_strprintf(&errmsg, "Corrupt extent tree in inode %llu.",
+		    (unsigned long long) file->ino);
+		return errmsg;
+	}
+
+	for (n = 0; n < entries && !errmsg; n++) {
+		e = data + 12 + n * 12;
+		if (le16(data + 6) == 0) {
+			// leaf, uninitialized extents read as zeros
+			len = le16(e + 4);
+			if (len > 32768)
+				continue;
+			block = le32(e);
+			start = (uint64_t) le16(e + 6) << 32 | le32(e + 8);
+			// fs_read() relies on sorted extents within the file
+			end = file->extents ? file->extent[file->extents-1].start
+			    + file->extent[file->extents-1].length : 0;
+			limit = (file->size + fs->block_size - 1) /
+			    fs->block_size * fs->block_size;
+			if (block * fs->block_size < end ||
+			    (block + len) * fs->block_size > limit) {
+				cfg_strprintf(&errmsg, "Corrupt extent tree "
+				    "in inode %llu.",
+				    (unsigned long long) file->ino);
+				break;
+			}
+			fs_add_extent(file, block * fs->block_size,
+			    (uint64_t) len * fs->block_size,
+			    start * fs->block_size);
+		} else {
+			block = (uint64_t) le16(e + 8) << 32 | le32(e + 4);
+			child = malloc(fs->block_size);
+			MEM_ASSERT(child);
+			if (fs_dev_read(fs, child, fs->block_size,
+			    block * fs->block_size))
+				cfg_strprintf(&errmsg, "Error reading extent "
+				    "block %llu.", (unsigned long long) block);
+			else
+				errmsg = ext_map_extents(fs, child,
+				    fs->block_size, depth + 1, file);
+			free(child);
+		}
+	}
+
+	return errmsg;
+}
+
+
+/**
+ * Add the blocks referenced by an indirect block of an ext2/3 block map.
+ *
+ * \param[in]     fs      Filesystem.
+ * \param[in]     block   Indirect block, zero for a hole.
+ * \param[in]     level   1 for indirect, 2 for double indirect etc.
+ * \param[in,out] lblock  Next logical block of the file.
+ * \param[in,out] file    File to add extents to.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+ext_map_indirect(struct fs *fs, uint32_t block, int level, uint64_t *lblock,
+    struct fs_file *file)
+{
+	uint32_t per_block = fs->block_size / 4, n, next;
+	uint64_t span = 1;
+	unsigned char *data;
+	char *errmsg = NULL;
+	int i;
+
+	for (i = 0; i < level; i++)
+		span *= per_block;
+	if (block == 0) {
+		*lblock += span;
+		return NULL;
+	}
+
+	data = malloc(fs->block_size);
+	MEM_ASSERT(data);
+	if (fs_dev_read(fs, data, fs->block_size,
+	    (uint64_t) block * fs->block_size)) {
+		cfg_strprintf(&errmsg, "Error reading indirect block %lu.",
+		    (unsigned long) block);
+		free(data);
+		return errmsg;
+	}
+	for (n = 0; n < per_block && !errmsg &&
+	    *lblock * fs->block_size < file->size; n++) {
+		next = le32(data + 4 * n);
+		if (level > 1)
+			errmsg = ext_map_indirect(fs, next, level - 1, lblock,
+			    file);
+		else {
+			if (next)
+				fs_add_extent(file, *lblock * fs->block_size,
+				    fs->block_size,
+				    (uint64_t) next * fs->block_size);
+			(*lblock)++;
+		}
+	}
+	free(data);
+
+	return errmsg;
+}
+
+
+/**
+ * Build the extent list of an ext inode.
+ *
+ * \param[in]     fs    Filesystem.
+ * \param[in]     node  Inode.
+ * \param[in,out] file  File with \c ino and \c size set.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+ext_map(struct fs *fs, const struct fs_node *node, struct fs_file *file)
+{
+	const unsigned char *iblock = node->inode + 40;
+	char *errmsg = NULL;
+	uint64_t lblock;
+	uint32_t block;
+	int n;
+
+	if (le32(node->inode + 32) & EXT_EXTENTS_FL)
+		return ext_map_extents(fs, iblock, 60, 0, file);
+
+	for (lblock = 0; lblock < 12; lblock++) {
+		block = le32(iblock + 4 * lblock);
+		if (block)
+			fs_add_extent(file, lblock * fs->block_size,
+			    fs->block_size, (uint64_t) block * fs->block_size);
+	}
+	for (n = 1; n <= 3 && !errmsg && lblock * fs->block_size < file->size;
+	    n++)
+		errmsg = ext_map_indirect(fs, le32(iblock + 44 + 4 * n), n,
+		    &lblock, file);
+
+	return errmsg;
+}
+
+
+/*
+ * ISO9660
+ */
+
+
+/**
+ * Decode a directory record into a node. Rock Ridge names are returned
+ * in \p name, symbolic link targets in \c node->link.
+ *
+ * \param[in]  fs      Filesystem.
+ * \param[in]  record  Directory record.
+ * \param[out] node    Node to fill in.
+ * \param[out] name    Dynamically allocated Rock Ridge name or NULL.
+ */
+
+static void
+iso_decode(struct fs *fs, const unsigned char *record, struct fs_node *node,
+    char **name)
+{
+	const unsigned char *su, *end, *c;
+	int namelen = record[32], flags, separator = 0;
+	struct tm tm;
+
+	memset(node, 0, sizeof(*node));
+	node->offset = (uint64_t) le32(record + 2) * fs->block_size;
+	node->ino = node->offset;
+	node->size = le32(record + 10);
+	node->mode = record[25] & ISO_FLAG_DIR ? FS_MODE_DIR : FS_MODE_REG;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = record[18];
+	tm.tm_mon = record[19] - 1;
+	tm.tm_mday = record[20];
+	tm.tm_hour = record[21];
+	tm.tm_min = record[22];
+	tm.tm_sec = record[23];
+	node->mtime = timegm(&tm) - (signed char) record[24] * 15 * 60;
+
+	*name = NULL;
+	if (!fs->rock_ridge)
+		return;
+	su = record + 33 + namelen + !(namelen & 1) + fs->susp_skip;
+	end = record + record[0];
+	while (su + 4 <= end && su[2] >= 4 && su + su[2] <= end) {
+		if (su[0] == 'N' && su[1] == 'M' && su[2] >= 5 &&
+		    !(su[4] & 0x06)) {
+			if (!*name)
+				cfg_strinit(name);
+			fs_strncat(name, su + 5, su[2] - 5);
+		} else if (su[0] == 'S' && su[1] == 'L' && su[2] >= 5) {
+			// components: flags, length, content
+			node->mode = FS_MODE_LNK;
+			if (!node->link)
+				cfg_strinit(&node->link);
+			for (c = su + 5; c + 2 <= su + su[2] &&
+			    c + 2 + c[1] <= su + su[2]; c += 2 + c[1]) {
+				flags = c[0];
+				if (separator)
+					cfg_strcat(&node->link, "/");
+				if (flags & 0x08)
+					cfg_strcat(&node->link, "/");
+				else if (flags & 0x02)
+					cfg_strcat(&node->link, ".");
+				else if (flags & 0x04)
+					cfg_strcat(&node->link, "..");
+				else
+					fs_strncat(&node->link, c + 2, c[1]);
+				// continued components are joined directly
+				separator = !(flags & 0x09);
+			}
+		}
+		su += su[2];
+	}
+}
+
+
+/**
+ * Compare name of an ISO9660 directory record without Rock Ridge name
+ * to a path component. Case and the version suffix are ignored.
+ *
+ * \param[in]  id      File identifier.
+ * \param[in]  idlen   Length of identifier.
+ * \param[in]  name    Path component.
+ * \return     Zero if the names match.
+ */
+
+static int
+iso_namecmp(const char *id, int idlen, const char *name)
+{
+	int n;
+
+	for (n = 0; n < idlen && id[n] != ';'; n++)
+		;
+	if (n > 0 && id[n - 1] == '.')
+		n--;
+	if (strlen(name) != n)
+		return 1;
+
+	return strncasecmp(id, name, n);
+}
+
+
+/*
+ * Common functions
+ */
+
+
+/**
+ * Build the extent list of a node.
+ *
+ * \param[in]  fs    Filesystem.
+ * \param[in]  node  Node.
+ * \param[out] file  File to fill in.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+fs_map(struct fs *fs, const struct fs_node *node, struct fs_file *file)
+{
+	char *errmsg;
+
+	memset(file, 0, sizeof(*file));
+	file->ino = node->ino;
+	file->size = node->size;
+	file->mtime = node->mtime;
+	if (fs->type == FS_TYPE_ISO) {
+		if (file->size)
+			fs_add_extent(file, 0, file->size, node->offset);
+		return NULL;
+	}
+	errmsg = ext_map(fs, node, file);
+	if (errmsg)
+		fs_file_free(file);
+
+	return errmsg;
+}
+
+
+/**
+ * Find an entry in a directory.
+ *
+ * \param[in]  fs    Filesystem.
+ * \param[in]  dir   Directory node.
+ * \param[in]  name  Name of entry.
+ * \param[out] node  Node of entry.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+fs_dir_lookup(struct fs *fs, const struct fs_node *dir, const char *name,
+    struct fs_node *node)
+{
+	unsigned char *data, *p, *end;
+	char *errmsg, *rrname;
+	uint32_t len, reclen;
+	uint64_t ino = 0;
+	struct fs_file file;
+	int found = 0, multi = 0;
+
+	if (dir->mode != FS_MODE_DIR) {
+		errmsg = NULL;
+		cfg_strprintf(&errmsg, "Not a directory.");
+		return errmsg;
+	}
+	if (dir->size > (64 << 20)) {
+		errmsg = NULL;
+		cfg_strprintf(&errmsg, "Directory too large.");
+		return errmsg;
+	}
+	errmsg = fs_map(fs, dir, &file);
+	if (errmsg)
+		return errmsg;
+	data = malloc(dir->size + 1);
+	MEM_ASSERT(data);
+	if (fs_read(fs, &file, data, dir->size, 0) != dir->size) {
+		cfg_strprintf(&errmsg, "Error reading directory.");
+		goto out;
+	}
+	end = data + dir->size;
+	len = strlen(name);
+
+	if (fs->type == FS_TYPE_EXT) {
+		// linear scan, also valid for hashed directories
+		for (p = data; p + 8 <= end; p += reclen) {
+			reclen = le16(p + 4);
+			if (reclen < 8 || p + reclen > end)
+				break;
+			if (le32(p) && p[6] == len && 8 + len <= reclen &&
+			    !memcmp(p + 8, name, len)) {
+				ino = le32(p);
+				found = 1;
+				break;
+			}
+		}
+		if (found)
+			errmsg = ext_read_inode(fs, ino, node);
+		goto out;
+	}
+
+	// ISO9660: records do not cross sector boundaries
+	for (p = data; p < end && !found; p += reclen) {
+		reclen = p[0];
+		if (reclen == 0) {
+			reclen = ISO_SECTOR_SIZE -
+			    (p - data) % ISO_SECTOR_SIZE;
+			continue;
+		}
+		if (reclen < 34 || p + reclen > end || 33 + p[32] > reclen)
+			break;
+		// only the final record of a multi-extent file is matched
+		if (p[25] & ISO_FLAG_MULTI) {
+			multi = 1;
+			continue;
+		}
+		iso_decode(fs, p, node, &rrname);
+		if (p[32] == 1 && (p[33] == 0 || p[33] == 1))
+			found = (p[33] == 0 && !strcmp(name, ".")) ||
+			    (p[33] == 1 && !strcmp(name, ".."));
+		else if (rrname)
+			found = !strcmp(rrname, name);
+		else
+			found = !iso_namecmp((const char *) p + 33, p[32],
+			    name);
+		cfg_strfree(&rrname);
+		if (found && multi)
+			cfg_strprintf(&errmsg, "Multi-extent files are not "
+			    "supported.");
+		if (!found || errmsg)
+			cfg_strfree(&node->link);
+		multi = 0;
+	}
+
+out:
+	free(data);
+	fs_file_free(&file);
+	if (!errmsg && !found)
+		cfg_strprintf(&errmsg, "No such file.");
+
+	return errmsg;
+}
+
+
+/**
+ * Read target of a symbolic link.
+ *
+ * \param[in]  fs      Filesystem.
+ * \param[in]  node    Link node.
+ * \param[out] target  Dynamically allocated link target.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+fs_readlink(struct fs *fs, const struct fs_node *node, char **target)
+{
+	char *errmsg = NULL, *data;
+	struct fs_file file;
+
+	if (fs->type == FS_TYPE_ISO) {
+		cfg_strinitcpy(target, node->link ? node->link : "");
+		return NULL;
+	}
+	if (node->size >= 4096) {
+		cfg_strprintf(&errmsg, "Symbolic link too long.");
+		return errmsg;
+	}
+	// fast symbolic links are stored in the inode itself
+	if (node->size < 60 && !(le32(node->inode + 32) & EXT_EXTENTS_FL)) {
+		cfg_strinit(target);
+		fs_strncat(target, node->inode + 40, node->size);
+		return NULL;
+	}
+	errmsg = fs_map(fs, node, &file);
+	if (errmsg)
+		return errmsg;
+	data = malloc(node->size + 1);
+	MEM_ASSERT(data);
+	if (fs_read(fs, &file, data, node->size, 0) != node->size)
+		cfg_strprintf(&errmsg, "Error reading symbolic link.");
+	else {
+		data[node->size] = '\0';
+		cfg_strinitcpy(target, data);
+	}
+	free(data);
+	fs_file_free(&file);
+
+	return errmsg;
+}
+
+
+/**
+ * Get node of root directory.
+ *
+ * \param[in]  fs    Filesystem.
+ * \param[out] node  Node of root directory.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+static char *
+fs_root(struct fs *fs, struct fs_node *node)
+{
+	if (fs->type == FS_TYPE_EXT)
+		return ext_read_inode(fs, EXT_ROOT_INO, node);
+
+	memset(node, 0, sizeof(*node));
+	node->mode = FS_MODE_DIR;
+	node->offset = fs->root_offset;
+	node->ino = fs->root_offset;
+	node->size = fs->root_size;
+
+	return NULL;
+}
+
+
+/**
+ * Detect ext2/3/4.
+ *
+ * \param[in,out] fs  Filesystem with source set.
+ * \return        Zero if found, -1 if no ext filesystem, 1 if an ext
+ *                filesystem uses unsupported features.
+ */
+
+static int
+ext_probe(struct fs *fs)
+{
+	unsigned char sb[1024];
+	uint32_t incompat;
+
+	if (fs_dev_read(fs, sb, sizeof(sb), EXT_SUPER_OFFSET) ||
+	    le16(sb + 56) != EXT_SUPER_MAGIC)
+		return -1;
+
+	incompat = le32(sb + 76) ? le32(sb + 96) : 0;
+	if (incompat & ~EXT_INCOMPAT_SUPP || le32(sb + 24) > 6)
+		return 1;
+
+	fs->type = FS_TYPE_EXT;
+	fs->block_size = 1024 << le32(sb + 24);
+	fs->first_data_block = le32(sb + 20);
+	fs->inodes_per_group = le32(sb + 40);
+	fs->inode_size = le32(sb + 76) ? le16(sb + 88) : 128;
+	fs->desc_size = incompat & EXT_INCOMPAT_64BIT ? le16(sb + 254) : 32;
+	if (fs->desc_size < 32)
+		fs->desc_size = 32;
+	if (fs->inodes_per_group == 0 || fs->inode_size < 128)
+		return 1;
+
+	return 0;
+}
+
+
+/**
+ * Detect ISO9660.
+ *
+ * \param[in,out] fs  Filesystem with source set.
+ * \return        Zero if found, -1 otherwise.
+ */
+
+static int
+iso_probe(struct fs *fs)
+{
+	unsigned char pvd[ISO_SECTOR_SIZE], *root, dot[256], *su;
+
+	if (fs_dev_read(fs, pvd, sizeof(pvd), ISO_PVD_OFFSET) ||
+	    pvd[0] != 1 || memcmp(pvd + 1, "CD001", 5))
+		return -1;
+
+	fs->type = FS_TYPE_ISO;
+	fs->block_size = le16(pvd + 128);
+	if (fs->block_size == 0)
+		fs->block_size = ISO_SECTOR_SIZE;
+	root = pvd + 156;
+	fs->root_offset = (uint64_t) le32(root + 2) * fs->block_size;
+	fs->root_size = le32(root + 10);
+
+	// Rock Ridge: "SP" entry in the "." record of the root directory
+	if (fs_dev_read(fs, dot, sizeof(dot), fs->root_offset) == 0 &&
+	    dot[0] >= 34 + 7 && dot[32] == 1) {
+		su = dot + 34;
+		if (su[0] == 'S' && su[1] == 'P' && su[4] == 0xbe &&
+		    su[5] == 0xef) {
+			fs->rock_ridge = 1;
+			fs->susp_skip = su[6];
+		}
+	}
+
+	return 0;
+}
+
+
+/**
+ * Open a filesystem for reading. The type is detected from the data on
+ * the device.
+ *
+ * \param[out] fs      Dynamically allocated filesystem.
+ * \param[in]  source  Device holding the filesystem.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+fs_open(struct fs **fs, const struct fs_source *source)
+{
+	char *errmsg = NULL;
+	int ret;
+
+	*fs = malloc(sizeof(**fs));
+	MEM_ASSERT(*fs);
+	memset(*fs, 0, sizeof(**fs));
+	(*fs)->source = *source;
+
+	ret = ext_probe(*fs);
+	if (ret > 0)
+		cfg_strprintf(&errmsg, "Unsupported ext filesystem features.");
+	else if (ret < 0 && iso_probe(*fs))
+		cfg_strprintf(&errmsg, "Unknown filesystem type.");
+	if (errmsg) {
+		free(*fs);
+		*fs = NULL;
+	}
+
+	return errmsg;
+}
+
+
+/**
+ * Copy an open filesystem to read it through another source, e.g. the
+ * same device with parameters of a different caller. Nothing is read.
+ *
+ * \param[in] fs      Filesystem opened by fs_open().
+ * \param[in] source  Device to read the copy from.
+ * \return            Copy, to be closed with fs_close().
+ */
+
+struct fs *
+fs_dup(const struct fs *fs, const struct fs_source *source)
+{
+	struct fs *copy;
+
+	copy = malloc(sizeof(*copy));
+	MEM_ASSERT(copy);
+	*copy = *fs;
+	copy->source = *source;
+
+	return copy;
+}
+
+
+/**
+ * Close a filesystem.
+ *
+ * \param[in] fs  Filesystem opened by fs_open() or fs_dup().
+ */
+
+void
+fs_close(struct fs *fs)
+{
+	free(fs);
+}
+
+
+/**
+ * Look up a regular file by its absolute pathname. Symbolic links are
+ * followed.
+ *
+ * \param[in]  fs    Filesystem.
+ * \param[in]  path  Pathname.
+ * \param[out] file  File description, to be freed with fs_file_free().
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+fs_lookup(struct fs *fs, const char *path, struct fs_file *file)
+{
+	char *errmsg, *work = NULL, *name, *rest, *target = NULL;
+	struct fs_node dir, node;
+	int links = 0;
+
+	errmsg = fs_root(fs, &dir);
+	if (errmsg)
+		return errmsg;
+	cfg_strinitcpy(&work, path);
+	rest = work;
+
+	while (!errmsg) {
+		while (*rest == '/')
+			rest++;
+		if (*rest == '\0') {
+			if (dir.mode != FS_MODE_REG)
+				cfg_strprintf(&errmsg, "No such file.");
+			break;
+		}
+		name = rest;
+		rest = strchr(name, '/');
+		if (rest)
+			*rest++ = '\0';
+		else
+			rest = name + strlen(name);
+
+		errmsg = fs_dir_lookup(fs, &dir, name, &node);
+		if (errmsg)
+			break;
+		if (node.mode != FS_MODE_LNK) {
+			cfg_strfree(&node.link);
+			dir = node;
+			continue;
+		}
+
+		// restart with link target followed by rest of path
+		if (++links > FS_MAX_SYMLINKS) {
+			cfg_strfree(&node.link);
+			cfg_strprintf(&errmsg, "Too many symbolic links.");
+			break;
+		}
+		errmsg = fs_readlink(fs, &node, &target);
+		cfg_strfree(&node.link);
+		if (errmsg)
+			break;
+		cfg_strcat(&target, "/");
+		cfg_strcat(&target, rest);
+		cfg_strcpy(&work, target);
+		cfg_strfree(&target);
+		rest = work;
+		if (*rest == '/')
+			errmsg = fs_root(fs, &dir);
+	}
+
+	if (!errmsg)
+		errmsg = fs_map(fs, &dir, file);
+	cfg_strfree(&work);
+
+	return errmsg;
+}
+
+
+/**
+ * Free a file description returned by fs_lookup().
+ *
+ * \param[in,out] file  File description.
+ */
+
+void
+fs_file_free(struct fs_file *file)
+{
+	free(file->extent);
+	file->extent = NULL;
+	file->extents = 0;
+}
+
+
+/**
+ * Read data of a file. Each extent touched is read with a single
+ * request to the device, so large buffers give large reads.
+ *
+ * \param[in]  fs     Filesystem.
+ * \param[in]  file   File returned by fs_lookup().
+ * \param[out] buf    Destination buffer.
+ * \param[in]  count  Size of destination buffer.
+ * \param[in]  pos    Position in the file.
+ * \return     Number of bytes read, zero at end of file, -1 on error.
+ */
+
+ssize_t
+fs_read(struct fs *fs, const struct fs_file *file, void *buf, size_t count,
+    uint64_t pos)
+{
+	const struct fs_extent *e;
+	uint64_t from, to;
+	int lo = 0, hi = file->extents, mid;
+
+	if (pos >= file->size)
+		return 0;
+	if (count > file->size - pos)
+		count = file->size - pos;
+	memset(buf, 0, count);
+
+	// first extent ending behind pos
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		e = &file->extent[mid];
+		if (e->start + e->length <= pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (e = file->extent + lo; e < file->extent + file->extents &&
+	    e->start < pos + count; e++) {
+		from = e->start > pos ? e->start : pos;
+		to = e->start + e->length < pos + count ?
+		    e->start + e->length : pos + count;
+		if (to <= from)
+			continue;
+		if (fs_dev_read(fs, (char *) buf + (from - pos), to - from,
+		    e->offset + (from - e->start)))
+			return -1;
+	}
+
+	return count;
+}
+
+
+/**
+ * Read function of struct fs_source for a device opened as a file.
+ *
+ * \param[in]  priv    Pointer to the file descriptor.
+ * \param[out] buf     Destination buffer.
+ * \param[in]  count   Number of bytes.
+ * \param[in]  offset  Position on the device.
+ * \return     Zero on success, -1 on error or end of device.
+ */
+
+int
+fs_read_fd(void *priv, void *buf, size_t count, uint64_t offset)
+{
+	int fd = *(int *) priv;
+	ssize_t ret;
+
+	while (count > 0) {
+		ret = pread(fd, buf, count, offset);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf = (char *) buf + ret;
+		count -= ret;
+		offset += ret;
+	}
+
+	return 0;
+}
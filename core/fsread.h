@@ -0,0 +1,75 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file fsread.h
+ * \brief Read-only access to ext2/3/4 and ISO9660 filesystems
+ *
+ * $Id$
+ */
+
+
+#ifndef _FSREAD_H_
+#define _FSREAD_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FS_MAX_SYMLINKS 8       //!< symbolic links followed per lookup
+
+
+/**
+ * This structure describes the device holding a filesystem. The read
+ * function must be safe to call from several threads at once.
+ */
+
+struct fs_source {
+	/**
+	 * Read exactly \c count bytes at byte \c offset of the device.
+	 *
+	 * \return Zero on success, non-zero on error.
+	 */
+	int (*read)(void *priv, void *buf, size_t count, uint64_t offset);
+	void *priv;                 //!< passed to read
+};
+
+
+/**
+ * One contiguous piece of a file on the device. Parts of a file which
+ * are not covered by an extent read as zeros.
+ */
+
+struct fs_extent {
+	uint64_t start;             //!< byte offset in file
+	uint64_t length;            //!< number of bytes
+	uint64_t offset;            //!< byte offset on device
+};
+
+
+/**
+ * This structure describes a file found by fs_lookup().
+ */
+
+struct fs_file {
+	uint64_t ino;               //!< inode number or location
+	uint64_t size;              //!< size in bytes
+	long mtime;                 //!< modification time
+	struct fs_extent *extent;   //!< extents sorted by file offset
+	int extents;                //!< number of extents
+};
+
+struct fs;
+
+char *fs_open(struct fs **fs, const struct fs_source *source);
+struct fs *fs_dup(const struct fs *fs, const struct fs_source *source);
+void fs_close(struct fs *fs);
+char *fs_lookup(struct fs *fs, const char *path, struct fs_file *file);
+void fs_file_free(struct fs_file *file);
+ssize_t fs_read(struct fs *fs, const struct fs_file *file, void *buf,
+    size_t count, uint64_t pos);
+int fs_read_fd(void *priv, void *buf, size_t count, uint64_t offset);
+
+#endif /* #ifndef _FSREAD_H_ */
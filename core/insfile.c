@@ -171,6 +171,9 @@ char *action_insfile_boot(struct cfg_bentry *boot)
   char *tmp_msg = NULL;
   char *local_name = NULL;
   char *filename = NULL;
+  char *name = NULL;
+  char *sums = NULL;
+  struct comp_request req;
   FILE *insfile = NULL; /*!< insfile to read from */
   char input[CFG_STR_MAX_LEN] = ""; /* input line from insfile */
   char input_name[CFG_STR_MAX_LEN] = "";
@@ -182,18 +185,34 @@ char *action_insfile_boot(struct cfg_bentry *boot)
   cfg_strinit(&local_name);
   cfg_strinit(&cmdline);
   cfg_strinit(&filename);
+  cfg_strinit(&name);
+
+  tmp_msg = load_sha256sums(boot, &sums);
+  if (tmp_msg) {
+    cfg_strcpy(&msg, tmp_msg);
+    cfg_strfree(&tmp_msg);
+    goto cleanup;
+  }
 
   // get the insfile
   if (strlen(boot->insfile)) {
     tmp_uri = prefix_root(boot->root, boot->insfile);
-    if (comp_load(SYSLOAD_FILENAME_INSFILE, tmp_uri, NULL, &tmp_msg)) {
-	    cfg_strprintf(&msg, "Error loading insfile '%s' - %s",
-		tmp_uri, tmp_msg);
+    comp_request_init(&req, "insfile", SYSLOAD_FILENAME_INSFILE, tmp_uri, 1);
+    set_timeouts(&req, 1, boot);
+    tmp_msg = find_sha256(sums, req.uri, boot->insfile_sha256, &req.sha256);
+    if (!tmp_msg) {
+      comp_load_start(&req, 1);
+      tmp_msg = comp_load_wait(&req, 1);
+    }
+    if (!tmp_msg)
+      get_uri_path(&uri_path, req.uri);
+    comp_request_destroy(&req);
+    tmp_uri = NULL;
+    if (tmp_msg) {
+      cfg_strcpy(&msg, tmp_msg);
+      cfg_strfree(&tmp_msg);
       goto cleanup;
     }
-
-    get_uri_path(&uri_path, tmp_uri);
-    cfg_strfree(&tmp_uri);
   }
 
   // get filenames from insfile
@@ -216,9 +235,21 @@ char *action_insfile_boot(struct cfg_bentry *boot)
 
 	cfg_strprintf(&local_name, "/tmp/file_%d", linecount);
 
-	if (comp_load(local_name, tmp_uri, NULL, &tmp_msg)) {
-		cfg_strprintf(&msg, "Error loading insfile component '%s' - %s",
-		    filename, tmp_msg);
+	cfg_strprintf(&name, "insfile component '%s'", filename);
+	comp_request_init(&req, name, local_name, tmp_uri, 1);
+	req.decompress = boot->decompress;
+	set_timeouts(&req, 1, boot);
+	// components are only verified by a sha256sums file
+	tmp_msg = find_sha256(sums, req.uri, "", &req.sha256);
+	if (!tmp_msg) {
+	  comp_load_start(&req, 1);
+	  tmp_msg = comp_load_wait(&req, 1);
+	}
+	comp_request_destroy(&req);
+	tmp_uri = NULL;
+	if (tmp_msg) {
+	  cfg_strcpy(&msg, tmp_msg);
+	  cfg_strfree(&tmp_msg);
 	  goto cleanup;
 	}
 
@@ -267,6 +298,8 @@ char *action_insfile_boot(struct cfg_bentry *boot)
   cfg_strfree(&local_name);
   cfg_strfree(&cmdline);
   cfg_strfree(&filename);
+  cfg_strfree(&name);
+  cfg_strfree(&sums);
 
   unlink(SYSLOAD_FILENAME_KERNEL);
   unlink(SYSLOAD_FILENAME_INITRD);
@@ -31,6 +31,7 @@ enum ins_component_type {
   INS_LAST //!< must be the last entry of this enum!
 };
 
+void get_uri_path(char **uri_path, const char *uri);
 char *action_insfile_boot(struct cfg_bentry *boot);
 
 #endif /* #ifndef _INSFILE_H_ */
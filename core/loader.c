@@ -17,7 +17,6 @@
 
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -25,10 +24,29 @@
 #include <unistd.h>
 #include <errno.h>
 #include <signal.h>
+#include <sys/syscall.h>
+#include <sys/reboot.h>
+#include <linux/reboot.h>
+#include <linux/kexec.h>
 #include "sysload.h"
 #include "insfile.h"
+#include "manifest.h"
 #include "bootmap.h"
 #include "debug.h"
+#include "comp_cache.h"
+#include "uri.h"
+#include "sha256.h"
+#include "preload.h"
+
+#ifndef KEXEC_FILE_NO_INITRAMFS
+#define KEXEC_FILE_NO_INITRAMFS 0x00000004
+#endif
+#ifndef KEXEC_FILE_UNLOAD
+#define KEXEC_FILE_UNLOAD 0x00000001
+#endif
+
+
+static int kexec_native;        //!< image loaded by kexec_file_load
 
 
 /**
@@ -45,7 +63,6 @@ char *
 prefix_root(const char *root, const char *uri)
 {
 	char *final_uri;
-	const char *colon_ptr, *ptr;
 	size_t uri_len = strlen(uri);
 
 	cfg_strinit(&final_uri);
@@ -59,26 +76,11 @@ prefix_root(const char *root, const char *uri)
 		return final_uri;
 	}
 
-	cfg_strprintf(&final_uri, "%s%s", root, uri);
-
-	// valid URIs it must contain a ':'
-	colon_ptr = strchr(uri, ':');
-	if (!colon_ptr)
-		return final_uri;
-
-	// valid URIs must start with a alphabetic character
-	if (!islower(uri[0]) && !isupper(uri[0]))
-		return final_uri;
-
-	// all remaining characters before ':' must be either alphabetic
-	// characters or digits or '+' or '-' or '.'
-	for (ptr = uri+1; ptr < colon_ptr; ptr++) {
-		if (!islower(*ptr) && !isupper(*ptr) && !isdigit(*ptr) &&
-		    *ptr != '+' && *ptr != '-' && *ptr != '.')
-			return final_uri;
-	}
-
-	cfg_strcpy(&final_uri, uri);
+	// complete URIs are used as they are
+	if (uri_scheme_length(uri))
+		cfg_strcpy(&final_uri, uri);
+	else
+		cfg_strprintf(&final_uri, "%s%s", root, uri);
 	return final_uri;
 }
 
@@ -147,6 +149,192 @@ compose_commandline(char **final_cmdline, const char *parmfile,
 }
 
 
+/**
+ * Load the file with SHA-256 digests named by the \c sha256sums
+ * statement of a boot entry. On success \p NULL will be returned. On
+ * error a dynamically allocated error message is returned.
+ *
+ * \param[in]  boot  Pointer to boot entry.
+ * \param[out] sums  Uninitialized string receiving the contents of the
+ *                   file, empty if the boot entry names no such file.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+load_sha256sums(struct cfg_bentry *boot, char **sums)
+{
+	char *msg = NULL, *tmp_msg = NULL, *uri, line[CFG_STR_MAX_LEN];
+	FILE *file;
+
+	cfg_strinit(sums);
+	if (!strlen(boot->sha256sums))
+		return NULL;
+
+	uri = prefix_root(boot->root, boot->sha256sums);
+	if (comp_load(SYSLOAD_FILENAME_SHA256SUMS, uri, NULL, &tmp_msg)) {
+		cfg_strinit(&msg);
+		cfg_strprintf(&msg, "Error loading SHA-256 digests '%s' - %s",
+		    uri, tmp_msg ? tmp_msg : "");
+		cfg_strfree(&tmp_msg);
+		cfg_strfree(&uri);
+		return msg;
+	}
+	cfg_strfree(&uri);
+
+	file = fopen(SYSLOAD_FILENAME_SHA256SUMS, "r");
+	if (!file) {
+		cfg_strinit(&msg);
+		cfg_strprintf(&msg, "Unable to open local copy of SHA-256 "
+		    "digests '%s' - %s", SYSLOAD_FILENAME_SHA256SUMS,
+		    strerror(errno));
+		return msg;
+	}
+	while (fgets(line, sizeof(line), file))
+		cfg_strcat(sums, line);
+	fclose(file);
+	unlink(SYSLOAD_FILENAME_SHA256SUMS);
+
+	return NULL;
+}
+
+
+/**
+ * Apply the deadlines of a boot entry to component load requests.
+ * Deadlines not set in the boot entry are taken from the settings of
+ * the URI scheme when the requests are started.
+ *
+ * \param[in,out] req    Array of initialized requests.
+ * \param[in]     count  Number of requests.
+ * \param[in]     boot   Pointer to boot entry.
+ */
+
+void
+set_timeouts(struct comp_request *req, int count, const struct cfg_bentry *boot)
+{
+	int n;
+
+	for (n = 0; n < count; n++) {
+		req[n].timeouts.connect = boot->connect_timeout;
+		req[n].timeouts.stall = boot->stall_timeout;
+		req[n].timeouts.total = boot->load_timeout;
+	}
+}
+
+
+/**
+ * Return the part of a pathname after the last slash.
+ *
+ * \param[in] path  Pathname.
+ * \param[in] len   Length of \p path.
+ * \return          Pointer into \p path.
+ */
+
+static const char *
+base_name(const char *path, size_t len)
+{
+	const char *ptr;
+
+	for (ptr = path + len; ptr > path; ptr--)
+		if (ptr[-1] == '/')
+			break;
+	return ptr;
+}
+
+
+/**
+ * Determine the SHA-256 digest a component must match. A digest given
+ * in the boot entry is used as it is. Otherwise the digest is looked up
+ * in the contents of a file loaded by load_sha256sums(), in the format
+ * of \c sha256sum (\c "<digest>  <name>") or in BSD format
+ * (\c "SHA256 (<name>) = <digest>"). Lines are matched by the last
+ * part of the name, which is compared with the last part of the path of
+ * the component URI (the fragment for files inside images). On success
+ * \p NULL will be returned. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param[in]  sums    Contents of file with digests, may be empty.
+ * \param[in]  uri     URI of component.
+ * \param[in]  digest  Digest given in the boot entry, may be empty.
+ * \param[out] result  Dynamically allocated digest or \c NULL if the
+ *                     component is not verified.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+find_sha256(const char *sums, const char *uri, const char *digest,
+    char **result)
+{
+	unsigned char bin[SHA256_SIZE];
+	const char *line, *end, *name, *end_name, *hash, *base;
+	char *msg = NULL;
+	struct uri parsed;
+	size_t name_len, base_len;
+
+	*result = NULL;
+	if (strlen(digest)) {
+		cfg_strinitcpy(result, digest);
+		return NULL;
+	}
+	if (!strlen(sums))
+		return NULL;
+
+	if (uri_parse(&parsed, uri) == 0) {
+		name = parsed.fragment && parsed.fragment[0] == '/' ?
+		    parsed.fragment : parsed.path;
+		base = base_name(name, strlen(name));
+		base_len = strlen(base);
+	} else {
+		parsed.buffer = NULL;
+		base = base_name(uri, strlen(uri));
+		base_len = strlen(base);
+	}
+
+	for (line = sums; *line; line = *end ? end + 1 : end) {
+		end = strchr(line, '\n');
+		if (!end)
+			end = line + strlen(line);
+		line += strspn(line, " \t");
+		if (strncmp(line, "SHA256 (", 8) == 0) {
+			name = line + 8;
+			hash = strstr(name, ") = ");
+			if (!hash || hash > end)
+				continue;
+			name_len = hash - name;
+			hash += 4;
+		} else {
+			hash = line;
+			name = line + 2 * SHA256_SIZE;
+			if (end - line <= 2 * SHA256_SIZE)
+				continue;
+			name += strspn(name, " \t");
+			if (*name == '*')
+				name++;
+			name_len = end - name;
+		}
+		while (name_len > 0 && strchr(" \t\r", name[name_len - 1]))
+			name_len--;
+		if (sha256_parse(hash, bin))
+			continue;
+		end_name = name + name_len;
+		name = base_name(name, name_len);
+		if (end_name - name == base_len &&
+		    strncmp(name, base, base_len) == 0) {
+			cfg_strinit(result);
+			cfg_strncpy(result, hash, 2 * SHA256_SIZE);
+			break;
+		}
+	}
+	if (!*result) {
+		cfg_strinit(&msg);
+		cfg_strprintf(&msg, "No SHA-256 digest for '%s'.", uri);
+	}
+	if (parsed.buffer)
+		uri_free(&parsed);
+
+	return msg;
+}
+
+
 /**
  * Replacement for \p system() where command line arguments can be
  * passed via string array \p argv . The value returned is -1 on
@@ -181,9 +369,14 @@ systemv(const char *path, char *const argv[])
 		return -1;
 	}
 	if (pid == 0) {
+		sigset_t unblocked;
+
 		signal(SIGQUIT, SIG_DFL);
 		signal(SIGINT, SIG_DFL);
 		signal(SIGCHLD, SIG_DFL);
+		// signals blocked in preload threads are unblocked for exec
+		sigemptyset(&unblocked);
+		sigprocmask(SIG_SETMASK, &unblocked, NULL);
 
 		execv(path, argv);
 		fprintf(stderr, "exec '%s' failed - %s;\n", path,
@@ -204,9 +397,60 @@ systemv(const char *path, char *const argv[])
 
 
 /**
- * By using kexec tool load new kernel image and switch to new kernel.
- * On success function does not return. On error a dynamically
- * allocated error message is returned.
+ * Load new kernel image with the \p kexec_file_load system call. The
+ * kernel reads the images from open descriptors of the local copies
+ * into its own memory, no process is started.
+ *
+ * \param[in] kernel    Pathname to kernel image.
+ * \param[in] initrd    Pathname to initrd image, empty for none.
+ * \param[in] cmdline   Kernel command line.
+ * \return    Zero on success, non-zero if the system call is not
+ *            available or refused the images.
+ */
+
+static int
+kexec_file(const char *kernel, const char *initrd, const char *cmdline)
+{
+#ifdef SYS_kexec_file_load
+	unsigned long flags = 0;
+	int kernel_fd, initrd_fd = -1;
+	long ret;
+
+	kernel_fd = open(kernel, O_RDONLY | O_CLOEXEC);
+	if (kernel_fd < 0)
+		return -1;
+	if (strlen(initrd)) {
+		initrd_fd = open(initrd, O_RDONLY | O_CLOEXEC);
+		if (initrd_fd < 0) {
+			close(kernel_fd);
+			return -1;
+		}
+	} else
+		flags |= KEXEC_FILE_NO_INITRAMFS;
+
+	ret = syscall(SYS_kexec_file_load, kernel_fd, initrd_fd,
+	    strlen(cmdline) + 1, cmdline, flags);
+	if (ret)
+		dg_printf(DG_VERBOSE, "kexec_file_load failed - %s\n",
+		    strerror(errno));
+
+	close(kernel_fd);
+	if (initrd_fd >= 0)
+		close(initrd_fd);
+
+	return ret ? -1 : 0;
+#else
+	return -1;
+#endif
+}
+
+
+/**
+ * Load new kernel image into memory. The image is loaded by the
+ * \p kexec_file_load system call where possible and by the kexec tool
+ * otherwise. The loaded image is started by kexec_execute() or
+ * discarded by kexec_unload(). On error a dynamically allocated error
+ * message is returned.
  *
  * \param[in] kernel    Pathname to kernel image.
  * \param[in] initrd    Pathname to initrd image.
@@ -215,18 +459,26 @@ systemv(const char *path, char *const argv[])
  */
 
 char *
-kexec(const char *kernel, const char *initrd, const char *cmdline)
+kexec_load(const char *kernel, const char *initrd, const char *cmdline)
 {
-	char *msg, *kernel_arg, *initrd_arg, *cmdline_arg;
+	char *msg = NULL, *initrd_arg, *cmdline_arg, *kernel_arg;
 	char *argv[10];
 	int index = 0, status;
 
-	cfg_strinit(&msg);
+	if (kexec_file(kernel, initrd, cmdline) == 0) {
+		// the kernel holds its own copy, free the local copies
+		unlink(kernel);
+		if (strlen(initrd))
+			unlink(initrd);
+		kexec_native = 1;
+		return NULL;
+	}
+	kexec_native = 0;
+
 	cfg_strinit(&kernel_arg);
 	cfg_strinit(&initrd_arg);
 	cfg_strinit(&cmdline_arg);
 
-	// load kernel into memory
 	argv[index++] = SYSLOAD_KEXEC_CMD;
 	argv[index++] = "-l";
 	if (strlen(initrd)) {
@@ -242,30 +494,180 @@ kexec(const char *kernel, const char *initrd, const char *cmdline)
 	argv[index] = NULL;
 	status = systemv(argv[0], argv);
 	if (status) {
+		cfg_strinit(&msg);
 		cfg_strprintf(&msg, "kexec load failed with return code %i.",
 		    status);
-		goto cleanup;
 	}
 
-	// execute new kernel
+	cfg_strfree(&kernel_arg);
+	cfg_strfree(&initrd_arg);
+	cfg_strfree(&cmdline_arg);
+
+	return msg;
+}
+
+
+/**
+ * Switch to the kernel loaded by kexec_load(). On success function
+ * does not return. On error a dynamically allocated error message is
+ * returned.
+ *
+ * \return    Dynamically allocated error message.
+ */
+
+char *
+kexec_execute(void)
+{
+	char *msg, *argv[3];
+	int status;
+
+	cc_release();
+	comp_load_release();
+	if (kexec_native) {
+		reboot(LINUX_REBOOT_CMD_KEXEC);
+		dg_printf(DG_VERBOSE, "kexec reboot failed - %s\n",
+		    strerror(errno));
+	}
+
 	argv[0] = SYSLOAD_KEXEC_CMD;
 	argv[1] = "-e";
 	argv[2] = NULL;
 	status = systemv(argv[0], argv);
 
 	// if we are still here something is wrong
+	cfg_strinit(&msg);
 	cfg_strprintf(&msg, "kexec execute failed with return code %i.",
 	    status);
 
- cleanup:
-	cfg_strfree(&kernel_arg);
-	cfg_strfree(&initrd_arg);
-	cfg_strfree(&cmdline_arg);
+	return msg;
+}
+
+
+/**
+ * Discard the kernel loaded by kexec_load().
+ */
+
+void
+kexec_unload(void)
+{
+	char *argv[3];
+
+#ifdef SYS_kexec_file_load
+	if (kexec_native &&
+	    syscall(SYS_kexec_file_load, -1, -1, 0, NULL,
+		KEXEC_FILE_UNLOAD) == 0)
+		return;
+#endif
+	argv[0] = SYSLOAD_KEXEC_CMD;
+	argv[1] = "-u";
+	argv[2] = NULL;
+	systemv(argv[0], argv);
+}
+
+
+/**
+ * Load new kernel image and switch to new kernel. On success function
+ * does not return. On error a dynamically allocated error message is
+ * returned.
+ *
+ * \param[in] kernel    Pathname to kernel image.
+ * \param[in] initrd    Pathname to initrd image.
+ * \param[in] cmdline   Kernel command line.
+ * \return    In case of error dynamically allocated error message.
+ */
+
+char *
+kexec(const char *kernel, const char *initrd, const char *cmdline)
+{
+	char *msg;
+
+	msg = kexec_load(kernel, initrd, cmdline);
+	if (msg)
+		return msg;
+
+	return kexec_execute();
+}
+
+
+/**
+ * Set up the component load requests of a regular kernel boot entry.
+ * On success \p NULL will be returned. On error a dynamically allocated
+ * error message is returned.
+ *
+ * \param[in]     boot   Pointer to boot entry.
+ * \param[in]     sums   Contents of file with digests as returned by
+ *                       load_sha256sums().
+ * \param[out]    req    Array of #KERNEL_BOOT_COMPONENTS requests.
+ * \param[in,out] count  Number of initialized requests in \p req, to be
+ *                       destroyed by the caller also on error.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+char *
+kernel_boot_requests(struct cfg_bentry *boot, const char *sums,
+    struct comp_request *req, int *count)
+{
+	const char *sha256[KERNEL_BOOT_COMPONENTS];
+	char *msg = NULL;
+	int n;
+
+	if (strlen(boot->kernel)>0) {
+		sha256[*count] = boot->kernel_sha256;
+		comp_request_init(&req[(*count)++], "kernel image",
+		    SYSLOAD_FILENAME_KERNEL,
+		    prefix_root(boot->root, boot->kernel), 1);
+	} else {
+		cfg_strinitcpy(&msg,  "No kernel specified.");
+		return msg;
+	}
+	if (strlen(boot->initrd)>0) {
+		sha256[*count] = boot->initrd_sha256;
+		comp_request_init(&req[(*count)++], "initrd image",
+		    SYSLOAD_FILENAME_INITRD,
+		    prefix_root(boot->root, boot->initrd), 1);
+	}
+	if (strlen(boot->parmfile)>0) {
+		sha256[*count] = boot->parmfile_sha256;
+		comp_request_init(&req[(*count)++], "parmfile",
+		    SYSLOAD_FILENAME_PARMFILE,
+		    prefix_root(boot->root, boot->parmfile), 1);
+	}
+	for (n = 0; n < *count; n++) {
+		req[n].segments = boot->segments;
+		req[n].segment_size = (long long) boot->segment_size << 20;
+		req[n].decompress = boot->decompress;
+		msg = find_sha256(sums, req[n].uri, sha256[n], &req[n].sha256);
+		if (msg)
+			break;
+	}
+	set_timeouts(req, *count, boot);
 
 	return msg;
 }
 
 
+/**
+ * Compose the kernel command line of a regular kernel boot entry after
+ * its components have been loaded. On success \p NULL will be returned.
+ * On error a dynamically allocated error message is returned.
+ *
+ * \param[in]  boot     Pointer to boot entry.
+ * \param[out] cmdline  Uninitialized string receiving the command line.
+ * \return     In case of error dynamically allocated error message.
+ */
+
+char *
+kernel_boot_cmdline(struct cfg_bentry *boot, char **cmdline)
+{
+	if (strlen(boot->parmfile)>0)
+		return compose_commandline(cmdline, SYSLOAD_FILENAME_PARMFILE,
+		    boot->cmdline);
+
+	cfg_strinitcpy(cmdline, boot->cmdline);
+	return NULL;
+}
+
+
 /**
  * Regular kernel boot method: copy files to local filesystem and call
  * \p kexec to boot new kernel. On success function does not return.
@@ -278,48 +680,26 @@ kexec(const char *kernel, const char *initrd, const char *cmdline)
 static char *
 action_kernel_boot(struct cfg_bentry *boot)
 {
-	char *msg = NULL, *tmp_uri = NULL, *tmp_msg = NULL, *cmdline = NULL;
+	char *msg = NULL, *cmdline = NULL, *sums = NULL;
+	struct comp_request req[KERNEL_BOOT_COMPONENTS];
+	int count = 0, n;
 
-	if (strlen(boot->kernel)>0) {
-		tmp_uri = prefix_root(boot->root, boot->kernel);
-		if (comp_load(SYSLOAD_FILENAME_KERNEL, tmp_uri, NULL,
-			&tmp_msg)) {
-			cfg_strprintf(&msg, "Error loading kernel image - %s",
-			    tmp_msg);
-			goto cleanup;
-		}
-		cfg_strfree(&tmp_uri);
-	} else {
-		cfg_strinitcpy(&msg,  "No kernel specified.");
+	msg = load_sha256sums(boot, &sums);
+	if (msg)
+		goto cleanup;
+	msg = kernel_boot_requests(boot, sums, req, &count);
+	if (msg)
 		goto cleanup;
-	}
 
-	if (strlen(boot->initrd)>0) {
-		tmp_uri = prefix_root(boot->root, boot->initrd);
-		if (comp_load(SYSLOAD_FILENAME_INITRD, tmp_uri, NULL,
-			&tmp_msg)) {
-			cfg_strprintf(&msg, "Error loading initrd image - %s",
-			    tmp_msg);
-			goto cleanup;
-		}
-		cfg_strfree(&tmp_uri);
-	}
+	// load all components concurrently
+	comp_load_start(req, count);
+	msg = comp_load_wait(req, count);
+	if (msg)
+		goto cleanup;
 
-	if (strlen(boot->parmfile)>0) {
-		tmp_uri = prefix_root(boot->root, boot->parmfile);
-		if (comp_load(SYSLOAD_FILENAME_PARMFILE, tmp_uri, NULL,
-			&tmp_msg)) {
-			cfg_strprintf(&msg, "Error loading parmfile - %s",
-			    tmp_msg);
-			goto cleanup;
-		}
-		msg = compose_commandline(&cmdline, SYSLOAD_FILENAME_PARMFILE,
-		    boot->cmdline);
-		if (msg)
-			goto cleanup;
-		cfg_strfree(&tmp_uri);
-	} else
-		cfg_strinitcpy(&cmdline, boot->cmdline);
+	msg = kernel_boot_cmdline(boot, &cmdline);
+	if (msg)
+		goto cleanup;
 
 	if (strlen(boot->initrd))
 		msg = kexec(SYSLOAD_FILENAME_KERNEL, SYSLOAD_FILENAME_INITRD, cmdline);
@@ -328,8 +708,9 @@ action_kernel_boot(struct cfg_bentry *boot)
 	cfg_strfree(&cmdline);
 
  cleanup:
-	cfg_strfree(&tmp_msg);
-	cfg_strfree(&tmp_uri);
+	for (n = 0; n < count; n++)
+		comp_request_destroy(&req[n]);
+	cfg_strfree(&sums);
 	unlink(SYSLOAD_FILENAME_KERNEL);
 	unlink(SYSLOAD_FILENAME_INITRD);
 	unlink(SYSLOAD_FILENAME_PARMFILE);
@@ -479,6 +860,10 @@ loader(struct cfg_bentry *boot)
 	char *msg = NULL;
 
 	DG_ENTER( DG_VERBOSE);
+	// a speculative preload of this entry leaves only the final step
+	if (preload_claim(boot, &msg))
+		DG_RETURN( DG_VERBOSE, msg);
+
 	// fork to function handling request
 	// on success handler functions do not return
 	switch (boot->action) {
@@ -494,6 +879,10 @@ loader(struct cfg_bentry *boot)
 		msg = action_bootmap_boot(boot);
 		break;
 
+	case MANIFEST_BOOT:
+		msg = action_manifest_boot(boot);
+		break;
+
 	case REBOOT:
 		msg = action_reboot();
 		break;
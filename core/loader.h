@@ -37,12 +37,32 @@
 //!< filename for local parmfile copy
 #define SYSLOAD_FILENAME_INSFILE  "/tmp/file.ins"
 //!< filename for local insfile copy
+#define SYSLOAD_FILENAME_SHA256SUMS "/tmp/sha256sums"
+//!< filename for local copy of SHA-256 digests
+#define SYSLOAD_FILENAME_MANIFEST "/tmp/manifest"
+//!< filename for local copy of boot manifest
+#define KERNEL_BOOT_COMPONENTS 3
+//!< kernel image, initrd image and parmfile
+
+struct comp_request;
 
 
 char *loader(struct cfg_bentry *boot);
 char *prefix_root(const char *root, const char *uri);
 char *compose_commandline(char **final_cmdline, const char *parmfile,
 			  const char *cmdline);
+char *load_sha256sums(struct cfg_bentry *boot, char **sums);
+char *find_sha256(const char *sums, const char *uri, const char *digest,
+		  char **result);
+void set_timeouts(struct comp_request *req, int count,
+		  const struct cfg_bentry *boot);
+char *kernel_boot_requests(struct cfg_bentry *boot, const char *sums,
+			   struct comp_request *req, int *count);
+char *kernel_boot_cmdline(struct cfg_bentry *boot, char **cmdline);
+char *kexec_load(const char *kernel, const char *initrd,
+		 const char *cmdline);
+char *kexec_execute(void);
+void kexec_unload(void);
 char *kexec(const char *kernel, const char *initrd, const char *cmdline);
 char *action_insfile_boot(struct cfg_bentry *boot);
 char *action_bootmap_boot(struct cfg_bentry *boot);
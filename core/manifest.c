@@ -0,0 +1,303 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file manifest.c
+ * \brief Boot method for components listed in a boot manifest
+ *
+ * A boot manifest lists the components of a boot entry, one per line:
+ *
+ *   <component> <URI> [size=<bytes>] [sha256=<digest>]
+ *               [compression=none|gzip|xz|zstd]
+ *
+ * Component is one of \c kernel, \c initrd and \c parmfile. Relative
+ * URIs are resolved against the location of the manifest. Empty lines
+ * and lines starting with '#' are ignored.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "sysload.h"
+#include "insfile.h"
+#include "manifest.h"
+#include "sha256.h"
+
+
+/**
+ * Component which may be listed in a boot manifest.
+ */
+
+struct manifest_component {
+	const char *keyword;            //!< component name in manifest
+	const char *name;               //!< component name for messages
+	const char *dest;               //!< pathname of local copy
+};
+
+static const struct manifest_component
+manifest_components[MANIFEST_COMPONENTS] = {
+	{ "kernel", "kernel image", SYSLOAD_FILENAME_KERNEL },
+	{ "initrd", "initrd image", SYSLOAD_FILENAME_INITRD },
+	{ "parmfile", "parmfile", SYSLOAD_FILENAME_PARMFILE },
+};
+
+
+/**
+ * Apply one attribute of a manifest line to a component load request.
+ * Unknown attributes are ignored so that manifests may carry additional
+ * information.
+ *
+ * \param[in,out] req   Component load request.
+ * \param[in]     attr  Attribute in the form \c key=value.
+ * \param[out]    msg   Uninitialized string receiving an error message.
+ * \return        Zero on success, non-zero on error.
+ */
+
+static int
+manifest_attribute(struct comp_request *req, const char *attr, char **msg)
+{
+	unsigned char digest[SHA256_SIZE];
+	const char *value;
+	char *end;
+
+	value = strchr(attr, '=');
+	if (!value) {
+		cfg_strinit(msg);
+		cfg_strprintf(msg, "Invalid attribute '%s'", attr);
+		return -1;
+	}
+	value++;
+
+	if (strncmp(attr, "size=", 5) == 0) {
+		errno = 0;
+		req->size = strtoll(value, &end, 10);
+		if (errno || *end || end == value || req->size <= 0) {
+			cfg_strinit(msg);
+			cfg_strprintf(msg, "Invalid size '%s'", value);
+			return -1;
+		}
+	} else if (strncmp(attr, "sha256=", 7) == 0) {
+		if (sha256_parse(value, digest)) {
+			cfg_strinit(msg);
+			cfg_strprintf(msg, "Invalid SHA-256 digest '%s'",
+			    value);
+			return -1;
+		}
+		cfg_strfree(&req->sha256);
+		cfg_strinitcpy(&req->sha256, value);
+	} else if (strncmp(attr, "compression=", 12) == 0) {
+		if (strcmp(value, "none") == 0)
+			req->decompress = 0;
+		else if (strcmp(value, "gzip") == 0 ||
+		    strcmp(value, "xz") == 0 || strcmp(value, "zstd") == 0) {
+			cfg_strinit(msg);
+			if (comp_load_check_decoders(value, msg))
+				return -1;
+			cfg_strfree(msg);
+			req->decompress = 1;
+		} else {
+			cfg_strinit(msg);
+			cfg_strprintf(msg, "Unknown compression '%s'", value);
+			return -1;
+		}
+	} else
+		dg_printf(DG_VERBOSE, "manifest: ignoring attribute '%s'\n",
+		    attr);
+
+	return 0;
+}
+
+
+/**
+ * Parse a boot manifest into component load requests. On success
+ * \p NULL will be returned. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param[in]     path   Pathname of local copy of the manifest.
+ * \param[in]     base   URI prefix for relative component URIs.
+ * \param[in]     boot   Boot entry providing defaults for the requests.
+ * \param[out]    req    Array of #MANIFEST_COMPONENTS requests.
+ * \param[in,out] count  Number of initialized requests in \p req.
+ * \return        In case of error dynamically allocated error message.
+ */
+
+static char *
+manifest_read(const char *path, const char *base,
+    const struct cfg_bentry *boot, struct comp_request *req, int *count)
+{
+	const struct manifest_component *comp;
+	char line[CFG_STR_MAX_LEN], *token, *save, *msg = NULL, *tmp_msg;
+	FILE *file;
+	int lineno = 0, i;
+
+	file = fopen(path, "r");
+	if (!file) {
+		cfg_strinit(&msg);
+		cfg_strprintf(&msg, "Unable to open local copy of manifest "
+		    "'%s' - %s", path, strerror(errno));
+		return msg;
+	}
+
+	while (!msg && fgets(line, sizeof(line), file)) {
+		lineno++;
+		token = strtok_r(line, " \t\r\n", &save);
+		if (!token || token[0] == '#')
+			continue;
+
+		comp = NULL;
+		for (i = 0; i < MANIFEST_COMPONENTS; i++)
+			if (strcmp(token, manifest_components[i].keyword) == 0)
+				comp = &manifest_components[i];
+		if (!comp) {
+			cfg_strinit(&msg);
+			cfg_strprintf(&msg, "Unknown component '%s' in "
+			    "manifest line %d.", token, lineno);
+			break;
+		}
+		for (i = 0; i < *count; i++)
+			if (req[i].dest == comp->dest) {
+				cfg_strinit(&msg);
+				cfg_strprintf(&msg, "Duplicate component '%s' "
+				    "in manifest line %d.", token, lineno);
+			}
+		token = strtok_r(NULL, " \t\r\n", &save);
+		if (!msg && !token) {
+			cfg_strinit(&msg);
+			cfg_strprintf(&msg, "Missing URI in manifest line "
+			    "%d.", lineno);
+		}
+		if (msg)
+			break;
+
+		comp_request_init(&req[*count], comp->name, comp->dest,
+		    prefix_root(base, token), 1);
+		req[*count].segments = boot->segments;
+		req[*count].segment_size = (long long) boot->segment_size << 20;
+		req[*count].decompress = boot->decompress;
+		set_timeouts(&req[*count], 1, boot);
+		while ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+			if (manifest_attribute(&req[*count], token, &tmp_msg)) {
+				cfg_strinit(&msg);
+				cfg_strprintf(&msg, "%s in manifest line %d.",
+				    tmp_msg, lineno);
+				cfg_strfree(&tmp_msg);
+				break;
+			}
+		}
+		(*count)++;
+	}
+	fclose(file);
+
+	return msg;
+}
+
+
+/**
+ * Order component load requests by decreasing expected size, so that
+ * the largest transfers are started first.
+ */
+
+static int
+manifest_compare(const void *a, const void *b)
+{
+	const struct comp_request *ra = a, *rb = b;
+
+	if (ra->size != rb->size)
+		return ra->size < rb->size ? 1 : -1;
+	return 0;
+}
+
+
+/**
+ * Manifest boot method: load the boot manifest, then load all components
+ * listed in it concurrently and call \p kexec to boot the new kernel.
+ * Sizes listed in the manifest are used to reserve space for the local
+ * copies and to reject sources of wrong size before their transfer,
+ * digests are verified while each component is loaded. On success
+ * function does not return. On error a dynamically allocated error
+ * message is returned.
+ *
+ * \param boot  Pointer to boot entry.
+ * \return      Dynamically allocated error message.
+ */
+
+char *
+action_manifest_boot(struct cfg_bentry *boot)
+{
+	struct comp_request manifest, req[MANIFEST_COMPONENTS];
+	char *msg = NULL, *cmdline = NULL, *sums = NULL, *base = NULL;
+	const char *kernel = NULL, *initrd = "", *parmfile = NULL;
+	int count = 0, n;
+
+	comp_request_init(&manifest, "boot manifest",
+	    SYSLOAD_FILENAME_MANIFEST, prefix_root(boot->root, boot->manifest),
+	    1);
+	set_timeouts(&manifest, 1, boot);
+	comp_load_start(&manifest, 1);
+	msg = comp_load_wait(&manifest, 1);
+	if (!msg) {
+		get_uri_path(&base, manifest.uri);
+		msg = manifest_read(SYSLOAD_FILENAME_MANIFEST, base, boot, req,
+		    &count);
+	}
+	comp_request_destroy(&manifest);
+	unlink(SYSLOAD_FILENAME_MANIFEST);
+	if (msg)
+		goto cleanup;
+
+	// components without digest may be listed in a sha256sums file
+	msg = load_sha256sums(boot, &sums);
+	if (msg)
+		goto cleanup;
+	for (n = 0; n < count; n++) {
+		if (!req[n].sha256)
+			msg = find_sha256(sums, req[n].uri, "", &req[n].sha256);
+		if (msg)
+			goto cleanup;
+		if (strcmp(req[n].dest, SYSLOAD_FILENAME_KERNEL) == 0)
+			kernel = req[n].dest;
+		else if (strcmp(req[n].dest, SYSLOAD_FILENAME_INITRD) == 0)
+			initrd = req[n].dest;
+		else
+			parmfile = req[n].dest;
+	}
+	if (!kernel) {
+		cfg_strinitcpy(&msg, "No kernel specified in manifest.");
+		goto cleanup;
+	}
+
+	qsort(req, count, sizeof(req[0]), manifest_compare);
+	comp_load_start(req, count);
+	msg = comp_load_wait(req, count);
+	if (msg)
+		goto cleanup;
+
+	if (parmfile) {
+		msg = compose_commandline(&cmdline, parmfile, boot->cmdline);
+		if (msg)
+			goto cleanup;
+	} else
+		cfg_strinitcpy(&cmdline, boot->cmdline);
+
+	msg = kexec(kernel, initrd, cmdline);
+	cfg_strfree(&cmdline);
+
+ cleanup:
+	for (n = 0; n < count; n++)
+		comp_request_destroy(&req[n]);
+	cfg_strfree(&sums);
+	cfg_strfree(&base);
+	unlink(SYSLOAD_FILENAME_KERNEL);
+	unlink(SYSLOAD_FILENAME_INITRD);
+	unlink(SYSLOAD_FILENAME_PARMFILE);
+
+	return msg;
+}
@@ -0,0 +1,23 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file manifest.h
+ * \brief Boot method for components listed in a boot manifest
+ *
+ * $Id$
+ */
+
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+
+#include "config.h"
+
+#define MANIFEST_COMPONENTS 3   //!< kernel, initrd and parmfile
+
+char *action_manifest_boot(struct cfg_bentry *boot);
+
+#endif /* #ifndef _MANIFEST_H_ */
@@ -43,6 +43,7 @@ parser_init(struct parser_context *context)
 	cfg_strinit(&context->filename);
 	cfg_strinit(&context->errmsg);
 	cfg_strinitcpy(&context->boot_default, "0");
+	cfg_strinit(&context->timeout_scheme);
 
 	// initialize member structures
 	context->system_depth = 0;
@@ -51,6 +52,7 @@ parser_init(struct parser_context *context)
 	context->bentry = cfg_bentry_new();
 	context->netconf = nb_conf_new();
 	context->modconf = mb_conf_new();
+	context->cacheconf = cc_conf_new();
 }
 
 
@@ -68,13 +70,16 @@ parser_destroy(struct parser_context *context)
 	cfg_strfree(&context->filename);
 	cfg_strfree(&context->errmsg);
 	cfg_strfree(&context->boot_default);
+	cfg_strfree(&context->timeout_scheme);
 
 	// destroy member structures
 	nb_conf_destroy(context->netconf);
 	mb_conf_destroy(context->modconf);
+	cc_conf_destroy(context->cacheconf);
 	cfg_bentry_destroy(context->bentry);
 	nb_conf_free(&context->netconf);
 	mb_conf_free(&context->modconf);
+	cc_conf_free(&context->cacheconf);
 	cfg_bentry_free(&context->bentry);
 }
 
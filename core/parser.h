@@ -21,6 +21,8 @@
 #include "config.h"
 #include "netbase.h"
 #include "modbase.h"
+#include "comp_cache.h"
+#include "comp_load.h"
 #include "sysload.h"
 
 #define MAX_SYSTEM_DEPTH 999
@@ -99,6 +101,9 @@ struct parser_context {
   struct cfg_bentry *bentry;     //!< temp. bentry info collected by parser
   struct nb_conf *netconf;       //!< temp. netconf info collected by parser
   struct mb_conf *modconf;   //!< temp. module info collected by parser
+  struct cc_conf *cacheconf; //!< temp. cache info collected by parser
+  char *timeout_scheme;      //!< temp. URI scheme of setup timeouts
+  struct cl_timeouts timeouts; //!< temp. deadlines of setup timeouts
 };
 
 extern struct parser_context *parser_global_context;
@@ -22,6 +22,8 @@
 #include "parser.h"
 #include "debug.h"
 #include "netbase.h"
+#include "devwait.h"
+#include "scsi_index.h"
 #include "sysload.h"
 
 int yyparse(void);
@@ -218,8 +220,8 @@ void parser_setup_dasd(const char *busid)
 	cfg_strinit(&defaultpath);
 	cfg_get_defaultpath(&defaultpath);
 	cfg_strprintf(&cmd,
-	    "%s/%s/setup_dasd %s", 
-	    defaultpath, SETUP_MODULE_PATH,
+	    "SYSLOAD_DEVICE_TIMEOUT=%d %s/%s/setup_dasd %s", 
+	    devwait_get_timeout(), defaultpath, SETUP_MODULE_PATH,
 	    busid);
 	
 	if (strlen(busid) != 8)
@@ -248,8 +250,8 @@ void parser_setup_zfcp(
 	cfg_strinit(&defaultpath);
 	cfg_get_defaultpath(&defaultpath);
 	cfg_strprintf(&cmd,
-	    "%s/%s/setup_zfcp %s %s %s", 
-	    defaultpath, SETUP_MODULE_PATH,
+	    "SYSLOAD_DEVICE_TIMEOUT=%d %s/%s/setup_zfcp %s %s %s", 
+	    devwait_get_timeout(), defaultpath, SETUP_MODULE_PATH,
 	    busid, wwpn, lun);
 	
 	if ((strlen(busid) != 8) ||
@@ -259,6 +261,8 @@ void parser_setup_zfcp(
 		    "invalid parameter in %s\n", cmd);
 	
 	cfg_system( cmd);
+	// make the new disk known to later lookups and loader modules
+	scsi_index_refresh();
 	
 	cfg_strfree(&defaultpath);
 	cfg_strfree(&cmd);
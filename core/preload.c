@@ -0,0 +1,296 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file preload.c
+ * \brief Speculative loading of the default boot entry
+ *
+ * While the user interfaces are shown, the components of the default
+ * boot entry are loaded in a background thread and, if configured, the
+ * new kernel is loaded into memory. If that entry is selected or the
+ * timeout expires, only the final kexec step remains. If another entry
+ * is selected, the speculative work is cancelled and discarded.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include "sysload.h"
+#include "preload.h"
+
+
+/**
+ * State of the speculative load. Only one entry is preloaded at a time.
+ */
+
+struct preload {
+	pthread_mutex_t lock;           //!< protects cancelled and req
+	pthread_t thread;               //!< thread loading the entry
+	int started;                    //!< thread has been created
+	int joined;                     //!< thread has been joined
+	int cancelled;                  //!< entry was not selected
+	int kexec;                      //!< load kernel into memory as well
+	int loaded;                     //!< kernel loaded by kexec_load()
+	struct cfg_bentry boot;         //!< copy of preloaded entry
+	struct comp_request req[KERNEL_BOOT_COMPONENTS]; //!< requests
+	int count;                      //!< number of initialized requests
+	char *cmdline;                  //!< composed kernel command line
+	char *msg;                      //!< error message of the thread
+};
+
+static struct preload preload = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+
+/**
+ * Thread function loading the components of the preloaded entry.
+ *
+ * \param[in] arg  Unused.
+ * \return         Always \c NULL.
+ */
+
+static void *
+preload_thread(void *arg)
+{
+	char *sums = NULL, *msg;
+	int loading = 0, cancelled;
+
+	msg = load_sha256sums(&preload.boot, &sums);
+	pthread_mutex_lock(&preload.lock);
+	if (!msg && preload.cancelled)
+		cfg_strinitcpy(&msg, "Cancelled.");
+	if (!msg)
+		msg = kernel_boot_requests(&preload.boot, sums, preload.req,
+		    &preload.count);
+	if (!msg) {
+		comp_load_start(preload.req, preload.count);
+		loading = 1;
+	}
+	pthread_mutex_unlock(&preload.lock);
+	cfg_strfree(&sums);
+
+	if (loading)
+		msg = comp_load_wait(preload.req, preload.count);
+	if (!msg)
+		msg = kernel_boot_cmdline(&preload.boot, &preload.cmdline);
+	pthread_mutex_lock(&preload.lock);
+	cancelled = preload.cancelled;
+	pthread_mutex_unlock(&preload.lock);
+	if (!msg && preload.kexec && !cancelled) {
+		msg = kexec_load(SYSLOAD_FILENAME_KERNEL,
+		    strlen(preload.boot.initrd) ? SYSLOAD_FILENAME_INITRD : "",
+		    preload.cmdline);
+		if (!msg)
+			preload.loaded = 1;
+	}
+	preload.msg = msg;
+
+	return NULL;
+}
+
+
+/**
+ * Wait for the preload thread, optionally cancelling it first.
+ *
+ * \param[in] cancel  Cancel transfers still in progress.
+ */
+
+static void
+preload_join(int cancel)
+{
+	if (preload.joined)
+		return;
+	if (cancel) {
+		pthread_mutex_lock(&preload.lock);
+		preload.cancelled = 1;
+		comp_load_cancel(preload.req, preload.count);
+		pthread_mutex_unlock(&preload.lock);
+	}
+	pthread_join(preload.thread, NULL);
+	preload.joined = 1;
+}
+
+
+/**
+ * Free all resources of a joined preload and remove its local copies.
+ */
+
+static void
+preload_reset(void)
+{
+	int n;
+
+	for (n = 0; n < preload.count; n++)
+		comp_request_destroy(&preload.req[n]);
+	cfg_strfree(&preload.cmdline);
+	cfg_strfree(&preload.msg);
+	cfg_bentry_destroy(&preload.boot);
+	unlink(SYSLOAD_FILENAME_KERNEL);
+	unlink(SYSLOAD_FILENAME_INITRD);
+	unlink(SYSLOAD_FILENAME_PARMFILE);
+	preload.started = 0;
+}
+
+
+/**
+ * Compare the members of two boot entries which determine the loaded
+ * components and the kernel command line.
+ *
+ * \param[in] a  First boot entry.
+ * \param[in] b  Second boot entry.
+ * \return       Non-zero if the entries load the same system.
+ */
+
+static int
+preload_match(const struct cfg_bentry *a, const struct cfg_bentry *b)
+{
+	return a->action == b->action &&
+	    a->decompress == b->decompress &&
+	    !strcmp(a->root, b->root) &&
+	    !strcmp(a->kernel, b->kernel) &&
+	    !strcmp(a->initrd, b->initrd) &&
+	    !strcmp(a->parmfile, b->parmfile) &&
+	    !strcmp(a->cmdline, b->cmdline) &&
+	    !strcmp(a->kernel_sha256, b->kernel_sha256) &&
+	    !strcmp(a->initrd_sha256, b->initrd_sha256) &&
+	    !strcmp(a->parmfile_sha256, b->parmfile_sha256) &&
+	    !strcmp(a->sha256sums, b->sha256sums);
+}
+
+
+/**
+ * Start loading the default boot entry in the background if the
+ * configuration asks for it. Only regular kernel boot entries are
+ * preloaded.
+ *
+ * \param[in] config  Configuration whose default entry is preloaded.
+ */
+
+void
+preload_start(const struct cfg_toplevel *config)
+{
+	const struct cfg_bentry *boot;
+	sigset_t set, old;
+
+	if (config->preload == PRELOAD_OFF || preload.started)
+		return;
+	if (config->boot_default < 0 ||
+	    config->boot_default >= config->bentry_count)
+		return;
+	boot = &config->bentry_list[config->boot_default];
+	if (boot->action != KERNEL_BOOT)
+		return;
+
+	cfg_bentry_init(&preload.boot);
+	cfg_bentry_copy(&preload.boot, boot);
+	preload.joined = 0;
+	preload.cancelled = 0;
+	preload.kexec = config->preload == PRELOAD_KEXEC;
+	preload.loaded = 0;
+	preload.count = 0;
+
+	// the user interface waits for these signals in the main thread,
+	// the loader threads inherit the mask
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigaddset(&set, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &set, &old);
+	if (!pthread_create(&preload.thread, NULL, preload_thread, NULL))
+		preload.started = 1;
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (preload.started)
+		dg_printf(DG_VERBOSE, "preloading '%s'\n", boot->title);
+	else
+		cfg_bentry_destroy(&preload.boot);
+}
+
+
+/**
+ * Cancel the transfers of the preload as soon as the operator has
+ * chosen another entry, so that they do not compete with the loading
+ * of the chosen one. The preload is discarded by preload_claim().
+ *
+ * \param[in] boot  Chosen boot entry.
+ */
+
+void
+preload_select(const struct cfg_bentry *boot)
+{
+	if (!preload.started || preload_match(&preload.boot, boot))
+		return;
+	pthread_mutex_lock(&preload.lock);
+	preload.cancelled = 1;
+	comp_load_cancel(preload.req, preload.count);
+	pthread_mutex_unlock(&preload.lock);
+}
+
+
+/**
+ * Boot a selected entry from its preload. If the entry differs from the
+ * preloaded one, or its preload failed, the preload is discarded and
+ * the entry has to be loaded regularly. On success function does not
+ * return.
+ *
+ * \param[in]  boot  Selected boot entry.
+ * \param[out] msg   Dynamically allocated error message if the boot of
+ *                   the preloaded entry failed.
+ * \return     Non-zero if the boot was attempted, zero if the entry
+ *             has to be loaded regularly.
+ */
+
+int
+preload_claim(const struct cfg_bentry *boot, char **msg)
+{
+	if (!preload.started)
+		return 0;
+	if (!preload_match(&preload.boot, boot)) {
+		dg_printf(DG_VERBOSE, "discarding preload of '%s'\n",
+		    preload.boot.title);
+		preload_discard();
+		return 0;
+	}
+
+	preload_join(0);
+	if (preload.msg) {
+		dg_printf(DG_VERBOSE, "preload of '%s' failed: %s\n",
+		    preload.boot.title, preload.msg);
+		preload_discard();
+		return 0;
+	}
+
+	if (preload.loaded)
+		*msg = kexec_execute();
+	else
+		*msg = kexec(SYSLOAD_FILENAME_KERNEL,
+		    strlen(preload.boot.initrd) ? SYSLOAD_FILENAME_INITRD : "",
+		    preload.cmdline);
+	preload_reset();
+
+	return 1;
+}
+
+
+/**
+ * Cancel the preload and discard everything it loaded.
+ */
+
+void
+preload_discard(void)
+{
+	if (!preload.started)
+		return;
+	preload_join(1);
+	if (preload.loaded)
+		kexec_unload();
+	preload_reset();
+}
@@ -0,0 +1,24 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file preload.h
+ * \brief Speculative loading of the default boot entry
+ *
+ * $Id$
+ */
+
+#ifndef _PRELOAD_H_
+#define _PRELOAD_H_
+
+#include "config.h"
+
+void preload_start(const struct cfg_toplevel *config);
+void preload_select(const struct cfg_bentry *boot);
+int preload_claim(const struct cfg_bentry *boot, char **msg);
+void preload_discard(void);
+
+#endif /* #ifndef _PRELOAD_H_ */
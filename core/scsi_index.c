@@ -0,0 +1,391 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file scsi_index.c
+ * \brief Index of FCP attached SCSI devices
+ *
+ * Finding the SCSI device of an FCP LUN takes three sysfs reads for every
+ * SCSI device of the system. The index maps bus ID, WWPN and LUN to the
+ * SCSI device and its block device. It is built by one scan of
+ * /sys/bus/scsi/devices and then kept up to date from the uevents of
+ * SCSI and block devices, so that only devices which come or go are
+ * read. Without uevents each lookup scans again. The index is shared by
+ * the loader threads and protected by \p scsi_lock. It is exported
+ * to #SCSI_INDEX_FILE for the setup and component loader scripts, one
+ * line per device:
+ *
+ *   <bus id> <WWPN> <LUN> <H:C:T:L> <block device>|- <major>:<minor>
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include "sysload.h"
+#include "bootmap.h"
+#include "scsi_index.h"
+
+
+#define SYS_PATH_SCSI                   "/sys/bus/scsi/devices"
+
+static struct scsi_entry *scsi_index;   //!< indexed devices
+static int scsi_count;                  //!< number of indexed devices
+static int scsi_fd = -1;                //!< uevent socket
+static int scsi_stale = 1;              //!< index has to be rebuilt
+static int scsi_changed;                //!< index has to be exported
+static pthread_mutex_t scsi_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/**
+ * Open the uevent socket. Done before the index is built, so that no
+ * change is missed between the scan and the first event.
+ */
+
+static void
+scsi_index_open(void)
+{
+	struct sockaddr_nl addr;
+
+	scsi_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC |
+	    SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+	if (scsi_fd == -1)
+		return;
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = 1;
+	if (bind(scsi_fd, (struct sockaddr *) &addr, sizeof(addr))) {
+		close(scsi_fd);
+		scsi_fd = -1;
+	}
+}
+
+
+/**
+ * Find an indexed SCSI device by its host:channel:id:lun.
+ *
+ * \param[in] hctl  SCSI address.
+ * \return          Index of entry or -1.
+ */
+
+static int
+scsi_index_find(const char *hctl)
+{
+	int n;
+
+	for (n = 0; n < scsi_count; n++)
+		if (!strcmp(scsi_index[n].hctl, hctl))
+			return n;
+
+	return -1;
+}
+
+
+/**
+ * Remove a SCSI device from the index.
+ *
+ * \param[in] hctl  SCSI address.
+ */
+
+static void
+scsi_index_remove(const char *hctl)
+{
+	int n = scsi_index_find(hctl);
+
+	if (n < 0)
+		return;
+	scsi_index[n] = scsi_index[--scsi_count];
+	scsi_changed = 1;
+}
+
+
+/**
+ * Read the block device of an indexed SCSI device from sysfs. Both the
+ * old \c block:<name> link and the \c block/<name> directory are
+ * supported.
+ *
+ * \param[in,out] entry  Indexed SCSI device.
+ */
+
+static void
+scsi_index_read_block(struct scsi_entry *entry)
+{
+	char *pattern = NULL, path[PATH_MAX], value[16], *name;
+
+	entry->block[0] = '\0';
+	entry->major = entry->minor = 0;
+	cfg_strprintf(&pattern, "%s/%s/block:*", SYS_PATH_SCSI, entry->hctl);
+	if (!cfg_glob_filename(pattern, path, sizeof(path) - 4)) {
+		cfg_strprintf(&pattern, "%s/%s/block/*", SYS_PATH_SCSI,
+		    entry->hctl);
+		if (!cfg_glob_filename(pattern, path, sizeof(path) - 4)) {
+			cfg_strfree(&pattern);
+			return;
+		}
+	}
+	cfg_strfree(&pattern);
+
+	name = strrchr(path, '/') + 1;
+	if (strncmp(name, "block:", 6) == 0)
+		name += 6;
+	if (strlen(name) >= sizeof(entry->block))
+		return;
+	strcpy(entry->block, name);
+	strcat(path, "/dev");
+	if (read_file(path, value, sizeof(value)) == -1 ||
+	    sscanf(value, "%i:%i", &entry->major, &entry->minor) != 2) {
+		entry->block[0] = '\0';
+		entry->major = entry->minor = 0;
+	}
+}
+
+
+/**
+ * Add a SCSI device to the index by reading its FCP attributes from
+ * sysfs. Devices which are not attached through FCP are ignored.
+ *
+ * \param[in] hctl  SCSI address.
+ */
+
+static void
+scsi_index_add(const char *hctl)
+{
+	struct scsi_entry entry;
+	char *path = NULL;
+	int n;
+
+	memset(&entry, 0, sizeof(entry));
+	if (strlen(hctl) >= sizeof(entry.hctl))
+		return;
+	strcpy(entry.hctl, hctl);
+	cfg_strprintf(&path, "%s/%s/hba_id", SYS_PATH_SCSI, hctl);
+	if (read_file(path, entry.busid, sizeof(entry.busid)) <= 0)
+		goto out;
+	cfg_strprintf(&path, "%s/%s/wwpn", SYS_PATH_SCSI, hctl);
+	if (read_file(path, entry.wwpn, sizeof(entry.wwpn)) <= 0)
+		goto out;
+	cfg_strprintf(&path, "%s/%s/fcp_lun", SYS_PATH_SCSI, hctl);
+	if (read_file(path, entry.lun, sizeof(entry.lun)) <= 0)
+		goto out;
+	scsi_index_read_block(&entry);
+
+	n = scsi_index_find(hctl);
+	if (n < 0) {
+		// grow in steps of powers of two
+		if ((scsi_count & (scsi_count - 1)) == 0) {
+			scsi_index = realloc(scsi_index, sizeof(*scsi_index) *
+			    (scsi_count ? scsi_count * 2 : 1));
+			MEM_ASSERT(scsi_index);
+		}
+		n = scsi_count++;
+	}
+	scsi_index[n] = entry;
+	scsi_changed = 1;
+ out:
+	cfg_strfree(&path);
+}
+
+
+/**
+ * Build the index by scanning all SCSI devices.
+ */
+
+static void
+scsi_index_build(void)
+{
+	struct dirent *dirent;
+	int host, channel, scsi_id, scsi_lun;
+	DIR *dir;
+
+	scsi_count = 0;
+	scsi_changed = 1;
+	scsi_stale = 0;
+	dir = opendir(SYS_PATH_SCSI);
+	if (dir == NULL)
+		return;
+	while ((dirent = readdir(dir)) != NULL)
+		if (sscanf(dirent->d_name, "%i:%i:%i:%i", &host, &channel,
+			&scsi_id, &scsi_lun) == 4)
+			scsi_index_add(dirent->d_name);
+	closedir(dir);
+	dg_printf(DG_VERBOSE, "scsi index: %d FCP device(s)\n", scsi_count);
+}
+
+
+/**
+ * Apply one uevent to the index. Events of SCSI devices add or remove
+ * index entries, events of whole disk block devices update the block
+ * device of their SCSI device. Block devices whose SCSI device cannot be
+ * told from the event cause a rebuild.
+ *
+ * \param[in] msg  Uevent message.
+ * \param[in] len  Length of \p msg.
+ */
+
+static void
+scsi_index_event(char *msg, size_t len)
+{
+	char *key, *action = NULL, *devpath = NULL, *subsystem = NULL;
+	char *devtype = NULL, *hctl, *end;
+	int n;
+
+	for (key = msg; key < msg + len; key += strlen(key) + 1) {
+		if (strncmp(key, "ACTION=", 7) == 0)
+			action = key + 7;
+		else if (strncmp(key, "DEVPATH=", 8) == 0)
+			devpath = key + 8;
+		else if (strncmp(key, "SUBSYSTEM=", 10) == 0)
+			subsystem = key + 10;
+		else if (strncmp(key, "DEVTYPE=", 8) == 0)
+			devtype = key + 8;
+	}
+	if (!action || !devpath || !subsystem || !devtype)
+		return;
+
+	if (!strcmp(subsystem, "scsi") && !strcmp(devtype, "scsi_device")) {
+		hctl = strrchr(devpath, '/') + 1;
+		if (!strcmp(action, "add"))
+			scsi_index_add(hctl);
+		else if (!strcmp(action, "remove"))
+			scsi_index_remove(hctl);
+		return;
+	}
+	if (strcmp(subsystem, "block") || strcmp(devtype, "disk"))
+		return;
+
+	// .../<H:C:T:L>/block/<name>
+	end = strstr(devpath, "/block/");
+	if (!end) {
+		scsi_stale = 1;
+		return;
+	}
+	*end = '\0';
+	hctl = strrchr(devpath, '/') + 1;
+	n = scsi_index_find(hctl);
+	if (n < 0)
+		return;
+	if (!strcmp(action, "remove")) {
+		scsi_index[n].block[0] = '\0';
+		scsi_index[n].major = scsi_index[n].minor = 0;
+	} else
+		scsi_index_read_block(&scsi_index[n]);
+	scsi_changed = 1;
+}
+
+
+/**
+ * Write the index to #SCSI_INDEX_FILE. The file is replaced atomically,
+ * so that readers always see a complete index.
+ */
+
+static void
+scsi_index_export(void)
+{
+	FILE *file;
+	int n;
+
+	file = fopen(SCSI_INDEX_FILE ".new", "w");
+	if (!file)
+		return;
+	for (n = 0; n < scsi_count; n++)
+		fprintf(file, "%s %s %s %s %s %i:%i\n", scsi_index[n].busid,
+		    scsi_index[n].wwpn, scsi_index[n].lun, scsi_index[n].hctl,
+		    scsi_index[n].block[0] ? scsi_index[n].block : "-",
+		    scsi_index[n].major, scsi_index[n].minor);
+	if (fclose(file) || rename(SCSI_INDEX_FILE ".new", SCSI_INDEX_FILE))
+		unlink(SCSI_INDEX_FILE ".new");
+	else
+		scsi_changed = 0;
+}
+
+
+/**
+ * Bring the index up to date: build it on first use, apply pending
+ * uevents and export it if it changed. Without uevents, or if events
+ * were lost, the index is built again. Must be called with \p scsi_lock
+ * held.
+ */
+
+static void
+scsi_index_update(void)
+{
+	char buffer[8192];
+	ssize_t len;
+
+	if (scsi_fd == -1) {
+		scsi_index_open();
+		scsi_stale = 1;
+	}
+	while (scsi_fd != -1 && !scsi_stale) {
+		len = recv(scsi_fd, buffer, sizeof(buffer) - 1, 0);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1 && errno == ENOBUFS) {
+			scsi_stale = 1;
+			break;
+		}
+		if (len <= 0)
+			break;
+		buffer[len] = '\0';
+		scsi_index_event(buffer, len);
+	}
+	if (scsi_stale || scsi_fd == -1)
+		scsi_index_build();
+	if (scsi_changed)
+		scsi_index_export();
+}
+
+
+/**
+ * Bring the index up to date, see scsi_index_update().
+ */
+
+void
+scsi_index_refresh(void)
+{
+	pthread_mutex_lock(&scsi_lock);
+	scsi_index_update();
+	pthread_mutex_unlock(&scsi_lock);
+}
+
+
+/**
+ * Look up the SCSI device of an FCP LUN.
+ *
+ * \param[in]  busid  Bus ID of FCP channel.
+ * \param[in]  wwpn   WWPN of target port.
+ * \param[in]  lun    FCP LUN.
+ * \param[out] entry  Indexed SCSI device.
+ * \return     Zero if the device was found, -1 otherwise.
+ */
+
+int
+scsi_index_lookup(const char *busid, const char *wwpn, const char *lun,
+    struct scsi_entry *entry)
+{
+	int n, ret = -1;
+
+	pthread_mutex_lock(&scsi_lock);
+	scsi_index_update();
+	for (n = 0; n < scsi_count && ret; n++)
+		if (!strcmp(scsi_index[n].busid, busid) &&
+		    !strcmp(scsi_index[n].wwpn, wwpn) &&
+		    !strcmp(scsi_index[n].lun, lun)) {
+			*entry = scsi_index[n];
+			ret = 0;
+		}
+	pthread_mutex_unlock(&scsi_lock);
+
+	return ret;
+}
@@ -0,0 +1,38 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file scsi_index.h
+ * \brief Index of FCP attached SCSI devices
+ *
+ * $Id$
+ */
+
+#ifndef _SCSI_INDEX_H_
+#define _SCSI_INDEX_H_
+
+//! index exported for the setup and component loader scripts
+#define SCSI_INDEX_FILE "/tmp/scsi_devices"
+
+/**
+ * FCP attached SCSI device and its block device.
+ */
+
+struct scsi_entry {
+	char busid[16];         //!< bus ID of FCP channel
+	char wwpn[20];          //!< WWPN of target port
+	char lun[20];           //!< FCP LUN
+	char hctl[32];          //!< host:channel:id:lun of SCSI device
+	char block[32];         //!< name of block device, empty if none
+	int major;              //!< major number of block device
+	int minor;              //!< minor number of block device
+};
+
+int scsi_index_lookup(const char *busid, const char *wwpn, const char *lun,
+    struct scsi_entry *entry);
+void scsi_index_refresh(void);
+
+#endif /* #ifndef _SCSI_INDEX_H_ */
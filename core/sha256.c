@@ -0,0 +1,359 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file sha256.c
+ * \brief Incremental SHA-256 digests
+ *
+ * Digests are computed by the kernel crypto API through an \c AF_ALG
+ * socket. The kernel selects the fastest implementation available, on
+ * System z the CPACF instructions of the CPU. If the kernel does not
+ * offer the interface, the digest is computed in software (FIPS 180-4).
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/if_alg.h>
+#include "sha256.h"
+#include "config.h"
+#include "debug.h"
+
+#ifndef AF_ALG
+#define AF_ALG 38
+#endif
+
+#define SHA256_FILE_BUFFER 65536    //!< read size of sha256_file()
+
+
+static int sha256_tfm = -1;         //!< bound kernel transform socket
+static pthread_once_t sha256_once = PTHREAD_ONCE_INIT;
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+
+/**
+ * Bind the kernel transform socket once per process.
+ */
+
+static void
+sha256_setup(void)
+{
+	struct sockaddr_alg sa;
+	int fd;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.salg_family = AF_ALG;
+	strcpy((char *) sa.salg_type, "hash");
+	strcpy((char *) sa.salg_name, "sha256");
+
+	fd = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		dg_printf(DG_VERBOSE, "sha256: kernel crypto API not "
+		    "available, hashing in software\n");
+		return;
+	}
+	if (bind(fd, (struct sockaddr *) &sa, sizeof(sa))) {
+		dg_printf(DG_VERBOSE, "sha256: kernel has no sha256, "
+		    "hashing in software\n");
+		close(fd);
+		return;
+	}
+	sha256_tfm = fd;
+}
+
+
+/**
+ * Process one 64 byte block in software.
+ *
+ * \param[in,out] state  Hash state.
+ * \param[in]     block  Block of data.
+ */
+
+static void
+sha256_block(uint32_t *state, const unsigned char *block)
+{
+	uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+	for (i = 0; i < 16; i++)
+		w[i] = (uint32_t) block[4*i] << 24 |
+		    (uint32_t) block[4*i+1] << 16 |
+		    (uint32_t) block[4*i+2] << 8 | block[4*i+3];
+	for (i = 16; i < 64; i++)
+		w[i] = w[i-16] + w[i-7] +
+		    (ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3)) +
+		    (ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10));
+
+	a = state[0]; b = state[1]; c = state[2]; d = state[3];
+	e = state[4]; f = state[5]; g = state[6]; h = state[7];
+	for (i = 0; i < 64; i++) {
+		t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+		    ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+		    ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+	state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+#undef ROR
+}
+
+
+/**
+ * Start a new digest computation. Must be finished with sha256_final()
+ * or sha256_release().
+ *
+ * \param[out] ctx  Digest state.
+ */
+
+void
+sha256_init(struct sha256 *ctx)
+{
+	static const uint32_t init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+
+	memset(ctx, 0, sizeof(*ctx));
+	memcpy(ctx->state, init, sizeof(init));
+	ctx->fd = -1;
+
+	pthread_once(&sha256_once, sha256_setup);
+	if (sha256_tfm >= 0)
+		ctx->fd = accept(sha256_tfm, NULL, 0);
+}
+
+
+/**
+ * Add data to a digest.
+ *
+ * \param[in,out] ctx   Digest state.
+ * \param[in]     data  Data to hash.
+ * \param[in]     len   Number of bytes in \p data.
+ * \return        Zero on success, non-zero on error.
+ */
+
+int
+sha256_update(struct sha256 *ctx, const void *data, size_t len)
+{
+	const unsigned char *ptr = data;
+	size_t fill, count;
+	ssize_t ret;
+
+	if (ctx->fd >= 0) {
+		while (len > 0 && !ctx->failed) {
+			ret = send(ctx->fd, ptr, len, MSG_MORE);
+			if (ret < 0 && errno == EINTR)
+				continue;
+			if (ret <= 0)
+				ctx->failed = 1;
+			else {
+				ptr += ret;
+				len -= ret;
+			}
+		}
+		return ctx->failed;
+	}
+
+	fill = ctx->length % SHA256_BLOCK;
+	ctx->length += len;
+	if (fill) {
+		count = SHA256_BLOCK - fill;
+		if (count > len)
+			count = len;
+		memcpy(ctx->block + fill, ptr, count);
+		ptr += count;
+		len -= count;
+		if (fill + count < SHA256_BLOCK)
+			return 0;
+		sha256_block(ctx->state, ctx->block);
+	}
+	for (; len >= SHA256_BLOCK; ptr += SHA256_BLOCK, len -= SHA256_BLOCK)
+		sha256_block(ctx->state, ptr);
+	memcpy(ctx->block, ptr, len);
+
+	return 0;
+}
+
+
+/**
+ * Finish a digest computation and release its resources.
+ *
+ * \param[in,out] ctx     Digest state.
+ * \param[out]    digest  #SHA256_SIZE bytes of digest.
+ * \return        Zero on success, non-zero on error.
+ */
+
+int
+sha256_final(struct sha256 *ctx, unsigned char *digest)
+{
+	unsigned char pad[2 * SHA256_BLOCK];
+	uint64_t bits = ctx->length * 8;
+	size_t fill, len;
+	ssize_t ret;
+	int i;
+
+	if (ctx->fd >= 0) {
+		if (!ctx->failed && send(ctx->fd, NULL, 0, 0) < 0)
+			ctx->failed = 1;
+		while (!ctx->failed &&
+		    (ret = read(ctx->fd, digest, SHA256_SIZE)) != SHA256_SIZE)
+			if (ret >= 0 || errno != EINTR)
+				ctx->failed = 1;
+		ret = ctx->failed;
+		sha256_release(ctx);
+		return ret;
+	}
+
+	// 0x80, zeros up to 8 bytes before a block boundary, bit length
+	fill = ctx->length % SHA256_BLOCK;
+	len = fill < SHA256_BLOCK - 8 ? SHA256_BLOCK - fill :
+	    2 * SHA256_BLOCK - fill;
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for (i = 0; i < 8; i++)
+		pad[len - 1 - i] = bits >> (8 * i);
+	sha256_update(ctx, pad, len);
+
+	for (i = 0; i < 8; i++) {
+		digest[4*i] = ctx->state[i] >> 24;
+		digest[4*i+1] = ctx->state[i] >> 16;
+		digest[4*i+2] = ctx->state[i] >> 8;
+		digest[4*i+3] = ctx->state[i];
+	}
+
+	return 0;
+}
+
+
+/**
+ * Release resources of a digest computation without finishing it.
+ *
+ * \param[in,out] ctx  Digest state.
+ */
+
+void
+sha256_release(struct sha256 *ctx)
+{
+	if (ctx->fd >= 0)
+		close(ctx->fd);
+	ctx->fd = -1;
+}
+
+
+/**
+ * Compute the digest of a file.
+ *
+ * \param[in]  path    Pathname of file.
+ * \param[out] digest  #SHA256_SIZE bytes of digest.
+ * \return     Zero on success, non-zero on error.
+ */
+
+int
+sha256_file(const char *path, unsigned char *digest)
+{
+	struct sha256 ctx;
+	char *buffer;
+	ssize_t count;
+	int fd, ret = -1;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	buffer = malloc(SHA256_FILE_BUFFER);
+	MEM_ASSERT(buffer);
+
+	sha256_init(&ctx);
+	while ((count = read(fd, buffer, SHA256_FILE_BUFFER)) != 0) {
+		if (count < 0 && errno == EINTR)
+			continue;
+		if (count < 0 || sha256_update(&ctx, buffer, count))
+			break;
+	}
+	if (count == 0)
+		ret = sha256_final(&ctx, digest);
+	else
+		sha256_release(&ctx);
+
+	free(buffer);
+	close(fd);
+
+	return ret;
+}
+
+
+/**
+ * Convert a digest in hexadecimal notation to binary. The digits may be
+ * followed by white space.
+ *
+ * \param[in]  str     Digest with #SHA256_HEX_SIZE - 1 hex digits.
+ * \param[out] digest  #SHA256_SIZE bytes of digest.
+ * \return     Zero on success, non-zero if \p str is no digest.
+ */
+
+int
+sha256_parse(const char *str, unsigned char *digest)
+{
+	unsigned int byte;
+	int i;
+
+	for (i = 0; i < 2 * SHA256_SIZE; i++)
+		if (!strchr("0123456789abcdefABCDEF", str[i]) || !str[i])
+			return -1;
+	if (str[i] && !strchr(" \t\r\n", str[i]))
+		return -1;
+	for (i = 0; i < SHA256_SIZE; i++) {
+		sscanf(str + 2 * i, "%2x", &byte);
+		digest[i] = byte;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Convert a digest to hexadecimal notation.
+ *
+ * \param[in]  digest  #SHA256_SIZE bytes of digest.
+ * \param[out] str     Buffer of #SHA256_HEX_SIZE bytes.
+ */
+
+void
+sha256_format(const unsigned char *digest, char *str)
+{
+	int i;
+
+	for (i = 0; i < SHA256_SIZE; i++)
+		sprintf(str + 2 * i, "%02x", digest[i]);
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file sha256.h
+ * \brief Incremental SHA-256 digests
+ *
+ * $Id$
+ */
+
+
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#define SHA256_SIZE      32     //!< bytes in a digest
+#define SHA256_HEX_SIZE  65     //!< hex digits in a digest plus NUL
+#define SHA256_BLOCK     64     //!< bytes per compression block
+
+
+/**
+ * State of a digest computation. Data is hashed by the kernel crypto API
+ * where available, which uses CPU instructions like CPACF on System z,
+ * and in software otherwise.
+ */
+
+struct sha256 {
+	int fd;                         //!< kernel operation socket or -1
+	int failed;                     //!< kernel hashing failed
+	uint32_t state[8];              //!< software hash state
+	uint64_t length;                //!< bytes hashed in software
+	unsigned char block[SHA256_BLOCK]; //!< partial software block
+};
+
+void sha256_init(struct sha256 *ctx);
+int sha256_update(struct sha256 *ctx, const void *data, size_t len);
+int sha256_final(struct sha256 *ctx, unsigned char *digest);
+void sha256_release(struct sha256 *ctx);
+int sha256_file(const char *path, unsigned char *digest);
+int sha256_parse(const char *str, unsigned char *digest);
+void sha256_format(const unsigned char *digest, char *str);
+
+#endif /* #ifndef _SHA256_H_ */
@@ -0,0 +1,171 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file sha256_bench.c
+ * \brief Benchmark of digest verification against plain transfer
+ *
+ * Copies a file of the given size as the transfer loop of comp_load.c
+ * does, once plain, once hashing each chunk on the way and once hashing
+ * the local copy in a separate pass afterwards, which is what loader
+ * module executables cost. Built with "make bench", not installed.
+ *
+ * Usage: sha256_bench [<megabytes> [<directory>]]
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "config.h"
+#include "sha256.h"
+
+#define BENCH_CHUNK (1024 * 1024)       //!< bytes per read and write
+
+char *arg0; //!< global variable with pointer to argv[0]
+
+
+/**
+ * Read the monotonic clock.
+ *
+ * \return  Time in seconds.
+ */
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Copy a file in chunks, optionally hashing each chunk.
+ *
+ * \param[in]  src     Source file.
+ * \param[in]  dest    Local copy, replaced.
+ * \param[in]  buffer  Buffer of #BENCH_CHUNK bytes.
+ * \param[out] ctx     Digest state or \c NULL for a plain copy.
+ * \return     Zero on success, -1 on error.
+ */
+
+static int
+bench_copy(const char *src, const char *dest, char *buffer,
+    struct sha256 *ctx)
+{
+	int in, out, ret = 0;
+	ssize_t count;
+
+	in = open(src, O_RDONLY);
+	out = open(dest, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (in < 0 || out < 0)
+		ret = -1;
+	while (!ret && (count = read(in, buffer, BENCH_CHUNK)) > 0)
+		if (write(out, buffer, count) != count ||
+		    (ctx && sha256_update(ctx, buffer, count)))
+			ret = -1;
+	if (in >= 0)
+		close(in);
+	if (out >= 0 && close(out))
+		ret = -1;
+
+	return ret;
+}
+
+
+int
+main(int argc, char **argv)
+{
+	long megabytes = argc > 1 ? atol(argv[1]) : 256;
+	const char *dir = argc > 2 ? argv[2] : "/tmp";
+	unsigned char digest[SHA256_SIZE], check[SHA256_SIZE];
+	char *src = NULL, *dest = NULL, *buffer;
+	double start, plain, inline_hash, second_pass;
+	struct sha256 ctx;
+	int fd, ret = 1;
+	long n;
+
+	arg0 = argv[0];                          // make MEM_ASSERT happy
+	if (megabytes <= 0) {
+		fprintf(stderr, "Usage: %s [<megabytes> [<directory>]]\n",
+		    argv[0]);
+		return 1;
+	}
+	buffer = malloc(BENCH_CHUNK);
+	MEM_ASSERT(buffer);
+	cfg_strinit(&src);
+	cfg_strprintf(&src, "%s/sha256_bench.%d.src", dir, getpid());
+	cfg_strinit(&dest);
+	cfg_strprintf(&dest, "%s/sha256_bench.%d.dest", dir, getpid());
+
+	// source data, not all zeros in case a layer below compresses
+	fd = open(src, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot create '%s'.\n", src);
+		goto out;
+	}
+	for (n = 0; n < BENCH_CHUNK; n++)
+		buffer[n] = (char) (n * 2654435761UL >> 13);
+	for (n = 0; n < megabytes; n++)
+		if (write(fd, buffer, BENCH_CHUNK) != BENCH_CHUNK) {
+			fprintf(stderr, "Cannot write '%s'.\n", src);
+			close(fd);
+			goto out;
+		}
+	close(fd);
+
+	start = bench_now();
+	if (bench_copy(src, dest, buffer, NULL))
+		goto failed;
+	plain = bench_now() - start;
+
+	start = bench_now();
+	sha256_init(&ctx);
+	if (bench_copy(src, dest, buffer, &ctx)) {
+		sha256_release(&ctx);
+		goto failed;
+	}
+	printf("hashing with:        %s\n", ctx.fd >= 0 && !ctx.failed ?
+	    "kernel crypto API" : "software");
+	if (sha256_final(&ctx, digest))
+		goto failed;
+	inline_hash = bench_now() - start;
+
+	start = bench_now();
+	if (bench_copy(src, dest, buffer, NULL) || sha256_file(dest, check))
+		goto failed;
+	second_pass = bench_now() - start;
+	if (memcmp(digest, check, SHA256_SIZE)) {
+		fprintf(stderr, "Digests differ.\n");
+		goto out;
+	}
+
+	printf("plain transfer:      %8.1f MB/s\n", megabytes / plain);
+	printf("hashed in transfer:  %8.1f MB/s  %+6.1f%%\n",
+	    megabytes / inline_hash, (inline_hash / plain - 1) * 100);
+	printf("hashed afterwards:   %8.1f MB/s  %+6.1f%%\n",
+	    megabytes / second_pass, (second_pass / plain - 1) * 100);
+	ret = 0;
+	goto out;
+
+ failed:
+	fprintf(stderr, "Copying '%s' failed.\n", src);
+ out:
+	unlink(src);
+	unlink(dest);
+	cfg_strfree(&src);
+	cfg_strfree(&dest);
+	free(buffer);
+
+	return ret;
+}
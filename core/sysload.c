@@ -24,6 +24,8 @@
 #include <fcntl.h>
 #include <errno.h>
 #include "sysload.h"
+#include "comp_mount.h"
+#include "preload.h"
 
 
 char *arg0; //<! global variable pointing to argv[0] (used in MEM_ASSERT)
@@ -110,6 +112,7 @@ main(int argc, char **argv)
         openlog(basename(argv[0]), LOG_PID | LOG_CONS, LOG_USER);
 
         dg_init();
+	cm_init();
 
 	pa_return = parse_arguments(&sysload_args, argc, argv);
 	dg_printf(DG_VERBOSE, "%s:parse_arguments done.\n", __FUNCTION__);
@@ -162,10 +165,16 @@ main(int argc, char **argv)
 			free(errmsg);
 			cfg_init(&config);
 		}
+		// connections used for includes are not kept during the menu
+		comp_load_release();
 
 		while (WORLD_EXISTS) {
+			// load default entry while the menu is shown
+			preload_start(&config);
+
 			// launch user interface modules
 			if (userinterface(startup_msg, &config, &boot)) {
+				preload_discard();
 				syslog(LOG_ERR,
 				    "unable to find boot configuration\n"
 				    "sysload is exiting - goodbye!");
@@ -176,6 +185,7 @@ main(int argc, char **argv)
 
 			// start new kernel
 			errmsg = loader(&boot);
+			comp_load_release();
 			if (errmsg) {
 				cfg_strprintf(&startup_msg,
 				    "Unable to start selected configuration:\n"
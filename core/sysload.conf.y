@@ -17,6 +17,7 @@
 #include "debug.h"
 #include "parser.h"
 #include "sysload.h"
+#include "devwait.h"
 
 	int yylex(void);
 	void yyerror(char const *msg);
@@ -28,6 +29,8 @@
 
 %token T_DEFAULT
 %token T_TIMEOUT
+%token T_PRELOAD
+%token T_DEVICE_TIMEOUT
 %token T_PASSWORD
 %token T_INCLUDE
 %token T_EXEC
@@ -52,6 +55,20 @@
 %token T_BOOTMAP
 %token T_LOCK
 %token T_PAUSE
+%token T_SEGMENTS
+%token T_SEGMENT_SIZE
+%token T_DECOMPRESS
+%token T_CONNECT_TIMEOUT
+%token T_STALL_TIMEOUT
+%token T_LOAD_TIMEOUT
+%token T_TIMEOUTS
+%token T_SCHEME
+%token T_KERNEL_SHA256
+%token T_INITRD_SHA256
+%token T_PARMFILE_SHA256
+%token T_INSFILE_SHA256
+%token T_SHA256SUMS
+%token T_MANIFEST
 %token T_HALT
 %token T_SHELL
 %token T_EXIT
@@ -69,6 +86,11 @@
 %token T_LUN
 %token T_QETH
 %token T_NETWORK
+%token T_CACHE
+%token T_MEMORY
+%token T_DISK
+%token T_FSTYPE
+%token T_SIZE
 %token T_KNET
 %token T_DHCP
 %token T_STATIC
@@ -287,6 +309,44 @@ globaldef:
 	    }
 	    cfg_strfree(&$2);
     }
+  | T_PRELOAD T_STRING
+    {
+	    int preload;
+
+	    if (strcmp($2,"off")==0)
+		    preload = PRELOAD_OFF;
+	    else if (strcmp($2,"components")==0)
+		    preload = PRELOAD_COMPONENTS;
+	    else if (strcmp($2,"kexec")==0)
+		    preload = PRELOAD_KEXEC;
+	    else {
+		    cfg_strfree(&$2);
+		    yyerror("preload must be off, components or kexec");
+		    YYERROR;
+	    }
+	    if ((parser_uimode()!=NULL) ||
+		(parser_active_system() != PA_ACTIVE)) {
+		    dg_printf(DG_VERBOSE,"%s:ignoring preload\n",
+			__FUNCTION__);
+	    }
+	    else
+		    parser_global_context->toplevel->preload = preload;
+	    cfg_strfree(&$2);
+    }
+  | T_DEVICE_TIMEOUT T_NUMBER
+    {
+	    if ((parser_uimode()!=NULL) ||
+		(parser_active_system() != PA_ACTIVE)) {
+		    dg_printf(DG_VERBOSE,"%s:ignoring device_timeout\n",
+			__FUNCTION__);
+	    }
+	    else {
+		    devwait_set_timeout(atoi($2));
+		    dg_printf(DG_VERBOSE,"%s:device timeout set to %d\n",
+			__FUNCTION__, devwait_get_timeout());
+	    }
+	    cfg_strfree(&$2);
+    }
   | T_PASSWORD T_STRING
     {
 	    if (parser_active_system() == PA_ACTIVE) {
@@ -312,6 +372,8 @@ setup:
   | setup_dasd
   | setup_qeth
   | setup_zfcp
+  | setup_cache
+  | setup_timeouts
 ;
 
 setup_module:
@@ -426,6 +488,143 @@ setup_zfcp:
     } ;
 
 
+/*
+ * the component cache keeps loaded boot components in memory so that
+ * retries are served locally. a persistent copy can be kept on a local
+ * disk. sizes are given in megabytes.
+ */
+
+setup_cache:
+
+  T_SETUP T_CACHE '{' cacheparamlist '}'
+    {
+	    if ((parser_uimode() == NULL) &&
+		(parser_active_system() == PA_ACTIVE)) {
+		    cc_conf_enable(parser_global_context->cacheconf);
+	    }
+	    else {
+		    dg_printf(DG_VERBOSE,"%s:ignoring setup cache\n",
+			__FUNCTION__);
+	    }
+	    /* reset for the next cacheconf */
+	    cc_conf_reset(parser_global_context->cacheconf);
+    }
+;
+
+cacheparamlist:
+
+    cacheparam
+  | cacheparamlist cacheparam
+;
+
+cacheparam:
+
+    T_MEMORY T_NUMBER
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->cacheconf->memory =
+			strtoll($2, NULL, 10) * 1024 * 1024;
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_DISK T_STRING
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->cacheconf->disk, $2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_FSTYPE T_IDENT
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->cacheconf->fstype, $2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_SIZE T_NUMBER
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->cacheconf->size =
+			strtoll($2, NULL, 10) * 1024 * 1024;
+	    }
+	    cfg_strfree(&$2);
+    }
+  | system '{' cacheparamlist '}'
+    {
+	    parser_exit_system();
+    }
+;
+
+
+/*
+ * deadlines for loading boot components, in seconds. without scheme
+ * they apply to all URI schemes.
+ */
+
+setup_timeouts:
+
+  T_SETUP T_TIMEOUTS '{' timeoutparamlist '}'
+    {
+	    if ((parser_uimode() == NULL) &&
+		(parser_active_system() == PA_ACTIVE)) {
+		    comp_load_set_timeouts(
+			parser_global_context->timeout_scheme,
+			&parser_global_context->timeouts);
+	    }
+	    else {
+		    dg_printf(DG_VERBOSE,"%s:ignoring setup timeouts\n",
+			__FUNCTION__);
+	    }
+	    /* reset for the next setup timeouts */
+	    cfg_strcpy(&parser_global_context->timeout_scheme, "");
+	    memset(&parser_global_context->timeouts, 0,
+		sizeof(parser_global_context->timeouts));
+    }
+;
+
+timeoutparamlist:
+
+    timeoutparam
+  | timeoutparamlist timeoutparam
+;
+
+timeoutparam:
+
+    T_SCHEME T_IDENT
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->timeout_scheme, $2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_CONNECT_TIMEOUT T_NUMBER
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->timeouts.connect = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_STALL_TIMEOUT T_NUMBER
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->timeouts.stall = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_LOAD_TIMEOUT T_NUMBER
+    {
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->timeouts.total = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | system '{' timeoutparamlist '}'
+    {
+	    parser_exit_system();
+    }
+;
+
+
 /*
  * network setup can be specified with a variety of parameters.
  * parameters can be dependent from a system statement.
@@ -673,6 +872,108 @@ option:
 	    }
 	    cfg_strfree(&$2);
     }  
+  | T_SEGMENTS T_NUMBER
+    {
+	    dg_printf( DG_MAXIMAL, "p:segments <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->segments = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_SEGMENT_SIZE T_NUMBER
+    {
+	    dg_printf( DG_MAXIMAL, "p:segment_size <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->segment_size = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_DECOMPRESS
+    {
+	    char *msg = NULL;
+
+	    if (parser_active_system() == PA_ACTIVE) {
+		    // fail here instead of during the transfer
+		    if (comp_load_check_decoders(NULL, &msg)) {
+			    yyerror(msg);
+			    cfg_strfree(&msg);
+			    YYERROR;
+		    }
+		    parser_global_context->bentry->decompress = 1;
+	    }
+    }  
+  | T_CONNECT_TIMEOUT T_NUMBER
+    {
+	    dg_printf( DG_MAXIMAL, "p:connect_timeout <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->connect_timeout = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_STALL_TIMEOUT T_NUMBER
+    {
+	    dg_printf( DG_MAXIMAL, "p:stall_timeout <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->stall_timeout = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_LOAD_TIMEOUT T_NUMBER
+    {
+	    dg_printf( DG_MAXIMAL, "p:load_timeout <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->load_timeout = atoi($2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_KERNEL_SHA256 T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:kernel_sha256 <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->kernel_sha256, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_INITRD_SHA256 T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:initrd_sha256 <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->initrd_sha256, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_PARMFILE_SHA256 T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:parmfile_sha256 <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->parmfile_sha256, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_INSFILE_SHA256 T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:insfile_sha256 <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->insfile_sha256, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_SHA256SUMS T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:sha256sums <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->sha256sums, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
+  | T_SHA256SUMS uri
+    {
+	    dg_printf( DG_MAXIMAL, "p:sha256sums uri <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    cfg_strcpy(&parser_global_context->bentry->sha256sums, $2);
+	    }
+	    cfg_strfree(&$2);
+    }  
   | T_KERNEL T_STRING
     {
 	    dg_printf( DG_MAXIMAL, "p:kernel <%s>\n", $2);
@@ -765,6 +1066,24 @@ option:
 	    }
 	    cfg_strfree(&$2);
     }  
+  | T_MANIFEST T_STRING
+    {
+	    dg_printf( DG_MAXIMAL, "p:manifest <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->action = MANIFEST_BOOT;
+		    cfg_strcpy(&parser_global_context->bentry->manifest, $2);
+	    }
+	    cfg_strfree(&$2);
+    }
+  | T_MANIFEST uri
+    {
+	    dg_printf( DG_MAXIMAL, "p:manifest uri <%s>\n", $2);
+	    if (parser_active_system() == PA_ACTIVE) {
+		    parser_global_context->bentry->action = MANIFEST_BOOT;
+		    cfg_strcpy(&parser_global_context->bentry->manifest, $2);
+	    }
+	    cfg_strfree(&$2);
+    }
   | T_REBOOT
     {
 	    if (parser_active_system() == PA_ACTIVE) {
@@ -28,6 +28,7 @@
 #include "debug.h"
 #include "parser.h"
 #include "loader.h"
+#include "comp_load.h"
 
 
 void print_help(const char *arg0);
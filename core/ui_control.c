@@ -29,6 +29,7 @@
 #include "ui_control.h"
 #include "parser.h"
 #include "debug.h"
+#include "preload.h"
 
 static int rcvd_sig = 0;
 
@@ -80,7 +81,9 @@ void build_waitset(fd_set *wset, struct ui_info *c, int count)
 
 
 /**
- * Remove all clients that have been terminated up to now.
+ * Remove all clients that have been terminated up to now. Only the
+ * client processes are reaped, children of a preload running in the
+ * background are left to their parent thread.
  *
  * \param[in]  c     the current client info array
  * \param[in]  count the number of clients in the client info array
@@ -88,27 +91,23 @@ void build_waitset(fd_set *wset, struct ui_info *c, int count)
 
 void remove_terminated_clients(struct ui_info *c, int count)
 {
-	pid_t return_pid;         /* pid returned from exiting ui */
 	int status = 0;           /* status from returning processes */
 	int cnr = 0;
 
-	do {
+	for (cnr = 0; cnr < count; cnr++) {
+		if (c[cnr].status != UI_RUNNING || c[cnr].pid <= 0)
+			continue;
+
 		/* wait nonblocking to remove zombies */
-		return_pid = waitpid (WAIT_ANY, &status, WNOHANG);
-
-		/* search for the process and mark as finished */
-		for (cnr = 0; cnr < count; cnr++) {
-			if (c[cnr].pid == return_pid) {
-				if (WIFEXITED(status) && (WEXITSTATUS(status)
-					== 0))
-					c[cnr].status = UI_CLEAN_EXIT;
-				else
-					c[cnr].status = UI_PROBLEM_EXIT;
-	
-				continue;
-			}
-		}
-	} while (return_pid > 0); // until no more terminated clients left
+		if (waitpid(c[cnr].pid, &status, WNOHANG) != c[cnr].pid)
+			continue;
+
+		/* mark the process as finished */
+		if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+			c[cnr].status = UI_CLEAN_EXIT;
+		else
+			c[cnr].status = UI_PROBLEM_EXIT;
+	}
 }
 
 void default_sig_hdlr(int sig_no)
@@ -409,6 +408,8 @@ int userinterface(const char *startup_msg, struct cfg_toplevel *config,
 					if (check_input_from_client(boot, fd,
 						u, config->ui_count) == 
 					    CFG_RETURN_OK) {
+						// stop preloading another entry
+						preload_select(boot);
 						retval = CFG_RETURN_OK;
 						goto cleanup_and_return;
 
@@ -263,6 +263,8 @@ void print_selection(struct cfg_bentry* bentry)
         fprintf(c_out, "%-9s %s\n","insfile",bentry->insfile);
     if(bentry->bootmap  && strlen(bentry->bootmap))
         fprintf(c_out, "%-9s %s\n","bootmap",bentry->bootmap);
+    if(bentry->manifest && strlen(bentry->manifest))
+        fprintf(c_out, "%-9s %s\n","manifest",bentry->manifest);
     if(bentry->pause    && strlen(bentry->pause))
         fprintf(c_out, "%-9s %s\n","pause",bentry->pause);
 
@@ -277,6 +279,9 @@ void print_selection(struct cfg_bentry* bentry)
     case BOOTMAP_BOOT:
         fprintf(c_out, "%-9s %s\n","action","BOOTMAP_BOOT\n");
         break;
+    case MANIFEST_BOOT:
+        fprintf(c_out, "%-9s %s\n","action","MANIFEST_BOOT\n");
+        break;
     case REBOOT:
         fprintf(c_out, "%-9s %s\n","action","REBOOT\n");
         break;
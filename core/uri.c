@@ -0,0 +1,454 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file uri.c
+ * \brief URI parser shared by core and loader modules
+ *
+ * The URI is split into its generic components according to RFC 3986.
+ * The authority of device URIs is enclosed in parentheses and may hold
+ * slashes, e.g. block://(/dev/sda1,ext3)/boot/image; its fields are
+ * split at commas and assigned to named fields depending on the scheme.
+ * Loader module executables receive the result in environment variables
+ * so that they do not have to parse the URI themselves.
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "config.h"
+#include "debug.h"
+#include "uri.h"
+
+
+/**
+ * Determine the length of the URI scheme at the start of a string.
+ *
+ * \param[in] str  String to examine.
+ * \return         Length of the scheme or zero if \p str does not start
+ *                 with a valid scheme followed by ':'.
+ */
+
+size_t uri_scheme_length(const char *str)
+{
+	const char *ptr;
+
+	// valid URIs must start with a alphabetic character, all remaining
+	// characters before ':' must be either alphabetic characters or
+	// digits or '+' or '-' or '.'
+	if (!isalpha((unsigned char) str[0]))
+		return 0;
+	for (ptr = str+1; *ptr != ':'; ptr++)
+		if (!isalnum((unsigned char) *ptr) &&
+		    *ptr != '+' && *ptr != '-' && *ptr != '.')
+			return 0;
+
+	return ptr - str;
+}
+
+
+/**
+ * Copy part of a string into the buffer of a parsed URI.
+ *
+ * \param[in,out] out  Next free position in buffer, advanced.
+ * \param[in]     src  Start of part.
+ * \param[in]     len  Length of part.
+ * \return             Terminated copy of part.
+ */
+
+static char *uri_copy(char **out, const char *src, size_t len)
+{
+	char *ret = *out;
+
+	memcpy(ret, src, len);
+	ret[len] = '\0';
+	*out += len + 1;
+
+	return ret;
+}
+
+
+/**
+ * Convert string to lower case in place, as done for device addresses
+ * in URIs, which are compared with the lower case values in sysfs.
+ *
+ * \param[in,out] str  String to convert or \c NULL.
+ */
+
+void uri_lower(char *str)
+{
+	for (; str && *str; str++)
+		*str = tolower((unsigned char) *str);
+}
+
+
+/**
+ * Split parenthesized device authority into its fields and assign them
+ * to the named fields of the scheme.
+ *
+ * \param[in,out] uri  URI with \c authority set.
+ * \param[in,out] out  Next free position in buffer, advanced.
+ * \return             Zero on success, non-zero if there are too many
+ *                     fields.
+ */
+
+static int uri_parse_device(struct uri *uri, char **out)
+{
+	char *ptr;
+
+	ptr = uri_copy(out, uri->authority + 1, strlen(uri->authority) - 2);
+	for (uri->args = 0; ptr; uri->args++) {
+		if (uri->args == URI_MAX_ARGS)
+			return -1;
+		uri->arg[uri->args] = ptr;
+		ptr = strchr(ptr, ',');
+		if (ptr)
+			*ptr++ = '\0';
+	}
+
+	if (!strcmp(uri->scheme, "dasd")) {
+		uri->busid = uri->arg[0];
+		uri->partition = uri->arg[1];
+		uri->fstype = uri->arg[2];
+	} else if (!strcmp(uri->scheme, "zfcp")) {
+		uri->busid = uri->arg[0];
+		uri->wwpn = uri->arg[1];
+		uri->lun = uri->arg[2];
+		uri->partition = uri->arg[3];
+		uri->fstype = uri->arg[4];
+	} else if (!strcmp(uri->scheme, "block")) {
+		uri->device = uri->arg[0];
+		uri->fstype = uri->arg[1];
+	}
+	uri_lower(uri->busid);
+	uri_lower(uri->wwpn);
+	uri_lower(uri->lun);
+
+	return 0;
+}
+
+
+/**
+ * Split server authority into user information, host and port.
+ *
+ * \param[in,out] uri  URI with \c authority set.
+ * \param[in,out] out  Next free position in buffer, advanced.
+ * \return             Zero on success, non-zero for an unterminated IPv6
+ *                     address.
+ */
+
+static int uri_parse_server(struct uri *uri, char **out)
+{
+	const char *ptr = uri->authority, *at, *end;
+
+	at = strrchr(ptr, '@');
+	if (at) {
+		uri->userinfo = uri_copy(out, ptr, at - ptr);
+		ptr = at + 1;
+	}
+	if (*ptr == '[') {
+		end = strchr(ptr, ']');
+		if (!end)
+			return -1;
+		uri->host = uri_copy(out, ptr + 1, end - ptr - 1);
+		ptr = end + 1;
+	} else {
+		end = ptr + strcspn(ptr, ":");
+		uri->host = uri_copy(out, ptr, end - ptr);
+		ptr = end;
+	}
+	if (*ptr == ':')
+		uri->port = uri_copy(out, ptr + 1, strlen(ptr + 1));
+
+	return 0;
+}
+
+
+/**
+ * Parse URI. A single buffer is allocated for all components, it is
+ * released with uri_free().
+ *
+ * \param[out] uri  Parsed URI.
+ * \param[in]  str  URI to parse.
+ * \return          Zero on success, non-zero if \p str is not a valid
+ *                  URI (nothing allocated then).
+ */
+
+int uri_parse(struct uri *uri, const char *str)
+{
+	const char *ptr, *end;
+	size_t len;
+	char *out;
+
+	memset(uri, 0, sizeof(*uri));
+	len = uri_scheme_length(str);
+	if (!len)
+		return -1;
+
+	// every component is copied at most twice
+	uri->buffer = malloc(2 * strlen(str) + 16);
+	MEM_ASSERT(uri->buffer);
+	out = uri->buffer;
+
+	uri->scheme = uri_copy(&out, str, len);
+	ptr = str + len + 1;
+
+	if (!strncmp(ptr, "//", 2)) {
+		ptr += 2;
+		if (*ptr == '(') {
+			end = strchr(ptr, ')');
+			if (!end)
+				goto out_invalid;
+			end++;
+		} else
+			end = ptr + strcspn(ptr, "/?#");
+		uri->authority = uri_copy(&out, ptr, end - ptr);
+		ptr = end;
+	}
+
+	len = strcspn(ptr, "?#");
+	uri->path = uri_copy(&out, ptr, len);
+	ptr += len;
+	if (*ptr == '?') {
+		len = strcspn(++ptr, "#");
+		uri->query = uri_copy(&out, ptr, len);
+		ptr += len;
+	}
+	if (*ptr == '#')
+		uri->fragment = uri_copy(&out, ptr + 1, strlen(ptr + 1));
+
+	if (uri->authority && uri->authority[0] == '(') {
+		if (uri_parse_device(uri, &out))
+			goto out_invalid;
+	} else if (uri->authority && uri_parse_server(uri, &out))
+		goto out_invalid;
+
+	return 0;
+
+ out_invalid:
+	uri_free(uri);
+	return -1;
+}
+
+
+/**
+ * Release buffer of a parsed URI.
+ *
+ * \param[in,out] uri  Parsed URI.
+ */
+
+void uri_free(struct uri *uri)
+{
+	free(uri->buffer);
+	memset(uri, 0, sizeof(*uri));
+}
+
+
+/**
+ * Check bus ID of a channel device, e.g. 0.0.5e89.
+ *
+ * \param[in] str  String to check or \c NULL.
+ * \return         Non-zero if \p str is a valid bus ID.
+ */
+
+int uri_is_busid(const char *str)
+{
+	int n;
+
+	if (!str || strlen(str) != 8 || str[1] != '.' || str[3] != '.')
+		return 0;
+	for (n = 0; n < 8; n++)
+		if (n != 1 && n != 3 && !isxdigit((unsigned char) str[n]))
+			return 0;
+
+	return 1;
+}
+
+
+/**
+ * Check WWPN or LUN of an FCP disk, e.g. 0x500507630e01fca2.
+ *
+ * \param[in] str  String to check or \c NULL.
+ * \return         Non-zero if \p str is a valid address.
+ */
+
+int uri_is_fcp_address(const char *str)
+{
+	int n;
+
+	if (!str || strlen(str) != 18 || strncmp(str, "0x", 2))
+		return 0;
+	for (n = 2; n < 18; n++)
+		if (!isxdigit((unsigned char) str[n]))
+			return 0;
+
+	return 1;
+}
+
+
+/**
+ * Check whether a string consists of digits only.
+ *
+ * \param[in] str  String to check or \c NULL.
+ * \param[in] max  Maximum number of digits.
+ * \return         Non-zero if \p str is missing, empty or a number of at
+ *                 most \p max digits.
+ */
+
+int uri_is_number(const char *str, size_t max)
+{
+	if (!str)
+		return 1;
+	if (strlen(str) > max)
+		return 0;
+	for (; *str; str++)
+		if (!isdigit((unsigned char) *str))
+			return 0;
+
+	return 1;
+}
+
+
+/**
+ * Check device fields of dasd, zfcp and block URIs used to load
+ * components. Other schemes are not checked.
+ *
+ * \param[in] uri  Parsed URI.
+ * \return         \c NULL if the URI is valid, otherwise a static error
+ *                 message.
+ */
+
+const char *uri_check_device(const struct uri *uri)
+{
+	if (strcmp(uri->scheme, "dasd") && strcmp(uri->scheme, "zfcp") &&
+	    strcmp(uri->scheme, "block"))
+		return NULL;
+
+	if (uri->query || uri->fragment || !uri->args)
+		return "Invalid URI.";
+
+	if (!strcmp(uri->scheme, "dasd")) {
+		if (uri->args > 3 || !uri_is_busid(uri->busid) ||
+		    !uri_is_number(uri->partition, 1) ||
+		    (uri->partition && uri->partition[0] > '3'))
+			return "Invalid DASD address.";
+	} else if (!strcmp(uri->scheme, "zfcp")) {
+		if (uri->args < 3 || uri->args > 5 ||
+		    !uri_is_busid(uri->busid) ||
+		    !uri_is_fcp_address(uri->wwpn) ||
+		    !uri_is_fcp_address(uri->lun) ||
+		    !uri_is_number(uri->partition, 3))
+			return "Invalid FCP device address.";
+	} else {
+		if (uri->args > 2 || uri->device[0] != '/')
+			return "Invalid URI.";
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Check whether an environment entry is one of the URI variables.
+ *
+ * \param[in] entry  Environment entry "name=value".
+ * \return           Non-zero for URI variables.
+ */
+
+static int uri_is_variable(const char *entry)
+{
+	size_t len = strlen(URI_ENV_PREFIX);
+
+	return !strncmp(entry, URI_ENV_PREFIX, len) &&
+	    (entry[len] == '=' || entry[len] == '_');
+}
+
+
+/**
+ * Add one variable to an environment under construction.
+ *
+ * \param[in,out] env    Environment.
+ * \param[in,out] count  Number of entries in \p env.
+ * \param[in]     name   Variable name without #URI_ENV_PREFIX.
+ * \param[in]     value  Value or \c NULL to skip the variable.
+ */
+
+static void uri_setenv(char **env, int *count, const char *name,
+    const char *value)
+{
+	if (!value)
+		return;
+	cfg_strinit(&env[*count]);
+	cfg_strprintf(&env[(*count)++], "%s%s=%s", URI_ENV_PREFIX, name,
+	    value);
+}
+
+
+/**
+ * Build environment for a loader module executable. It consists of the
+ * current environment and one variable per URI component, e.g.
+ * \c SYSLOAD_URI_PATH. \c SYSLOAD_URI holds the URI itself, so the
+ * module can tell that the variables belong to its argument. Variables
+ * of absent components are not set.
+ *
+ * \param[in]  uri  Parsed URI.
+ * \param[in]  str  URI as passed to the module.
+ * \param[out] env  Dynamically allocated environment, to be released
+ *                  with uri_export_free().
+ */
+
+void uri_export(const struct uri *uri, const char *str, char ***env)
+{
+	extern char **environ;
+	int count = 0, n;
+
+	for (n = 0; environ[n]; n++);
+	*env = malloc((n + 16) * sizeof(**env));
+	MEM_ASSERT(*env);
+
+	// own variables first, uri_export_free() relies on it
+	uri_setenv(*env, &count, "", str);
+	uri_setenv(*env, &count, "_SCHEME", uri->scheme);
+	uri_setenv(*env, &count, "_AUTHORITY", uri->authority);
+	uri_setenv(*env, &count, "_USERINFO", uri->userinfo);
+	uri_setenv(*env, &count, "_HOST", uri->host);
+	uri_setenv(*env, &count, "_PORT", uri->port);
+	uri_setenv(*env, &count, "_PATH", uri->path);
+	uri_setenv(*env, &count, "_QUERY", uri->query);
+	uri_setenv(*env, &count, "_FRAGMENT", uri->fragment);
+	uri_setenv(*env, &count, "_BUSID", uri->busid);
+	uri_setenv(*env, &count, "_WWPN", uri->wwpn);
+	uri_setenv(*env, &count, "_LUN", uri->lun);
+	uri_setenv(*env, &count, "_DEVICE", uri->device);
+	uri_setenv(*env, &count, "_PARTITION", uri->partition);
+	uri_setenv(*env, &count, "_FSTYPE", uri->fstype);
+
+	// drop stale variables inherited from our own environment
+	for (n = 0; environ[n]; n++)
+		if (!uri_is_variable(environ[n]))
+			(*env)[count++] = environ[n];
+	(*env)[count] = NULL;
+}
+
+
+/**
+ * Release environment built by uri_export().
+ *
+ * \param[in] env  Environment.
+ */
+
+void uri_export_free(char **env)
+{
+	int n;
+
+	for (n = 0; env[n] && uri_is_variable(env[n]); n++)
+		free(env[n]);
+	free(env);
+}
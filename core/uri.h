@@ -0,0 +1,65 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file uri.h
+ * \brief URI parser shared by core and loader modules
+ *
+ * $Id$
+ */
+
+
+#ifndef _URI_H_
+#define _URI_H_
+
+#define URI_MAX_ARGS 8         //!< maximum number of device fields
+#define URI_ENV_PREFIX "SYSLOAD_URI" //!< prefix of exported variables
+
+
+/**
+ * This structure describes a parsed URI. All strings point into a single
+ * buffer owned by the structure, components not present in the URI are
+ * \c NULL. Device URIs (dasd, zfcp, block) carry a parenthesized list of
+ * comma separated fields instead of a server authority, e.g.
+ * \c dasd://(0.0.5e89,1,ext3)/boot/image.
+ */
+
+struct uri {
+	char *buffer;               //!< storage for all components
+	char *scheme;               //!< URI scheme
+	char *authority;            //!< authority without leading "//"
+	char *path;                 //!< path, possibly empty
+	char *query;                //!< query without leading '?'
+	char *fragment;             //!< fragment without leading '#'
+
+	// server authority
+	char *userinfo;             //!< user and password
+	char *host;                 //!< host, IPv6 address without brackets
+	char *port;                 //!< port
+
+	// device authority
+	char *arg[URI_MAX_ARGS];    //!< comma separated device fields
+	int args;                   //!< number of device fields
+	char *busid;                //!< bus ID of channel device, lower case
+	char *wwpn;                 //!< WWPN of FCP disk, lower case
+	char *lun;                  //!< LUN of FCP disk, lower case
+	char *device;               //!< device node of block URIs
+	char *partition;            //!< partition number
+	char *fstype;               //!< filesystem type
+};
+
+size_t uri_scheme_length(const char *str);
+int uri_parse(struct uri *uri, const char *str);
+void uri_free(struct uri *uri);
+int uri_is_busid(const char *str);
+int uri_is_fcp_address(const char *str);
+int uri_is_number(const char *str, size_t max);
+void uri_lower(char *str);
+const char *uri_check_device(const struct uri *uri);
+void uri_export(const struct uri *uri, const char *str, char ***env);
+void uri_export_free(char **env);
+
+#endif /* #ifndef _URI_H_ */
@@ -0,0 +1,132 @@
+/**
+ * Copyright IBM Corp. 2005, 2008
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License (version 2 only)
+ * as published by the Free Software Foundation.
+ *
+ * \file uri_bench.c
+ * \brief Micro-benchmark of the URI parser
+ *
+ * Measures the time to parse, check and export URIs of all supported
+ * schemes as done for every component loaded, and compares it with the
+ * awk pipeline the loader module scripts use when they are run by hand.
+ * Built with "make bench", not installed.
+ *
+ * Usage: uri_bench [<iterations> [<shell iterations>]]
+ *
+ * $Id$
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "config.h"
+#include "uri.h"
+
+
+static const char *bench_uris[] = {
+	"dasd://(0.0.5e89,1,ext3)/boot/image",
+	"zfcp://(0.0.04ae,0x500507630e01fca2,0x4010404500000000,1,ext3)"
+	    "/boot/initrd",
+	"block://(/dev/sda1,ext3)/boot/parmfile",
+	"file:///mnt/boot/image",
+	"http://user:secret@[fe80::1]:8080/boot/image?arch=s390x",
+	"scp://root@server.example.com/srv/boot/initrd",
+};
+
+#define BENCH_URIS (sizeof(bench_uris) / sizeof(bench_uris[0]))
+
+char *arg0; //!< global variable with pointer to argv[0]
+
+// generic URI split as done by cl_zfcp without SYSLOAD_URI variables
+static const char bench_script[] =
+	"extract() { echo \"$2\" | awk -v \"RE=$1\" "
+	"'{ match($0, RE); print substr($0, RSTART, RLENGTH) }'; }\n"
+	"remains() { echo \"$2\" | awk -v \"RE=$1\" "
+	"'{ match($0, RE); print substr($0, RSTART+RLENGTH) }'; }\n"
+	"URI=\"$1\"\n"
+	"S=$( extract '^(([^:/?#]+):)?' \"$URI\" )\n"
+	"R=$( remains '^(([^:/?#]+):)?' \"$URI\" )\n"
+	"A=$( extract '^(//([^/?#]*))?' \"$R\" | cut -c 3- )\n"
+	"R=$( remains '^(//([^/?#]*))?' \"$R\" )\n"
+	"P=$( extract '^([^?#]*)' \"$R\" )\n"
+	"R=$( remains '^([^?#]*)' \"$R\" )\n"
+	"Q=$( extract '^(\\?([^#]*))?' \"$R\" )\n"
+	"R=$( remains '^(\\?([^#]*))?' \"$R\" )\n"
+	"F=$( extract '^(#(.*))' \"$R\" )\n";
+
+
+/**
+ * Read the monotonic clock.
+ *
+ * \return  Time in nanoseconds.
+ */
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+int
+main(int argc, char **argv)
+{
+	long iterations = argc > 1 ? atol(argv[1]) : 100000;
+	long shell = argc > 2 ? atol(argv[2]) : 5;
+	double start, native, script;
+	char *cmd = NULL, **env;
+	struct uri uri;
+	long n;
+	int i;
+
+	arg0 = argv[0];                          // make MEM_ASSERT happy
+	if (iterations <= 0 || shell < 0) {
+		fprintf(stderr, "Usage: %s [<iterations> [<shell iterations>]]\n",
+		    argv[0]);
+		return 1;
+	}
+
+	// parse and export as comp_load_exec() does for each component
+	start = bench_now();
+	for (n = 0; n < iterations; n++)
+		for (i = 0; i < BENCH_URIS; i++) {
+			if (uri_parse(&uri, bench_uris[i])) {
+				fprintf(stderr, "Cannot parse '%s'.\n",
+				    bench_uris[i]);
+				return 1;
+			}
+			uri_check_device(&uri);
+			uri_export(&uri, bench_uris[i], &env);
+			uri_export_free(env);
+			uri_free(&uri);
+		}
+	native = (bench_now() - start) / (iterations * BENCH_URIS);
+	printf("uri_parse + uri_export:  %10.3f us per URI\n", native / 1e3);
+
+	if (shell == 0)
+		return 0;
+	setenv("BENCH_SCRIPT", bench_script, 1);
+	start = bench_now();
+	for (n = 0; n < shell; n++)
+		for (i = 0; i < BENCH_URIS; i++) {
+			cfg_strinit(&cmd);
+			cfg_strprintf(&cmd, "sh -c '%s' bench '%s' >/dev/null",
+			    "eval \"$BENCH_SCRIPT\"", bench_uris[i]);
+			if (system(cmd)) {
+				fprintf(stderr, "Shell pipeline failed.\n");
+				return 1;
+			}
+		}
+	cfg_strfree(&cmd);
+	script = (bench_now() - start) / (shell * BENCH_URIS);
+	printf("awk pipeline (scripts):  %10.3f us per URI\n", script / 1e3);
+	printf("speedup:                 %10.0fx\n", script / native);
+
+	return 0;
+}
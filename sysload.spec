@@ -30,11 +30,13 @@ rm -rf $RPM_BUILD_ROOT
 %attr(0755, root, root) %dir 	/usr/lib/sysload
 %attr(0755, root, root) %dir 	/usr/lib/sysload/cl
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_file
+%attr(0755, root, root)      	/usr/lib/sysload/cl/cl_file.so
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_dasd
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_zfcp
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_block
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_ftp
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_http
+%attr(0755, root, root)      	/usr/lib/sysload/cl/cl_http.so
 %attr(0755, root, root)      	/usr/lib/sysload/cl/cl_scp
 %attr(0644, root, root)      	/usr/lib/sysload/config/hosts
 %attr(0644, root, root)      	/usr/lib/sysload/config/passwd